@@ -13,5 +13,25 @@ namespace General
 			AssimpModelImporter importer(*params);
 			return importer.Import();
 		};
+
+		ImportTask* load_model_from_assimp_async(const ImportParams* params, const ImportProgressCallback callback, void* userData)
+		{
+			CHECK(params && params->filename && strlen(params->filename), nullptr);
+
+			return start_import_task(new AssimpModelImporter(*params), callback, userData);
+		}
+
+		int load_models_from_assimp(const ImportParams* params, const int count, const size_t memoryBudget, const int jobLimit, BatchImportResult* results)
+		{
+			CHECK(params && count >= 0 && results, 0);
+
+			// every importer reads its file with its own Assimp::Importer
+			std::vector<Importer*> importers(count);
+			for (int i = 0; i < count; ++i)
+			{
+				importers[i] = params[i].filename && strlen(params[i].filename) ? new AssimpModelImporter(params[i]) : nullptr;
+			}
+			return import_batch(importers.data(), count, memoryBudget, jobLimit, results);
+		}
 	}
 }
\ No newline at end of file
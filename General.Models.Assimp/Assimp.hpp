@@ -7,8 +7,12 @@ namespace General
 	{
 		struct Model;
 		struct ImportParams;
+		struct ImportTask;
+		struct BatchImportResult;
 
 		EXPORT const Model* load_model_from_assimp(const ImportParams* params);
+		EXPORT ImportTask* load_model_from_assimp_async(const ImportParams* params, const ImportProgressCallback callback, void* userData); // see start_import_task
+		EXPORT int load_models_from_assimp(const ImportParams* params, const int count, const size_t memoryBudget, const int jobLimit, BatchImportResult* results); // see import_batch
 	}
 }
 
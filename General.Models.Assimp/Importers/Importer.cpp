@@ -63,19 +63,49 @@ namespace General
 			return m;
 		}
 
-		Node* create_node_from_ai(const aiNode* assimpNode)
+		Node* create_node_from_ai(const aiNode* assimpNode, const bool keepMatrix)
 		{
-			aiVector3D translation, rotation, scaling;
-			assimpNode->mTransformation.Decompose(scaling, rotation, translation);
+			// decomposed once, the euler angles are derived from the quaternion so both rotations always agree
+			aiVector3D translation, scaling;
+			aiQuaternion quaternion;
+			assimpNode->mTransformation.Decompose(scaling, quaternion, translation);
 
 			Node* node = create_node(assimpNode->mName.C_Str());
 			node->localPosition = vector3_from_ai(translation);
-			node->localRotation = vector3_scale(vector3_from_ai(rotation), static_cast<float>(180.0 / M_PI));
+			node_set_quaternion(node, vector4_from_ai_quaternion(quaternion));
 			node->localScaling = vector3_from_ai(scaling);
+			if (keepMatrix)
+			{
+				node_set_local_matrix(node, matrix_from_ai(assimpNode->mTransformation));
+			}
 			return node;
 		}
 
-		AssimpModelImporter::AssimpModelImporter(const ImportParams& params) : Importer(params) { }
+		class AssimpModelImporter::ProgressHandler : public Assimp::ProgressHandler
+		{
+		private:
+			AssimpModelImporter* mImporter;
+		public:
+			ProgressHandler(AssimpModelImporter* importer) : mImporter(importer) { }
+
+			virtual bool Update(float percentage) override
+			{
+				// returning false makes Assimp abort the read
+				return mImporter->reportProgress(IMPORT_PHASE_PARSE, percentage < 0.0f ? 0.0f : percentage);
+			}
+		};
+
+		static unsigned int count_ai_nodes(const aiNode* assimpNode)
+		{
+			unsigned int count = 1;
+			for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
+			{
+				count += count_ai_nodes(assimpNode->mChildren[i]);
+			}
+			return count;
+		}
+
+		AssimpModelImporter::AssimpModelImporter(const ImportParams& params) : Importer(params), mNodeCount(), mCheckedNodeCount() { }
 
 		AssimpModelImporter::~AssimpModelImporter() { }
 
@@ -84,50 +114,111 @@ namespace General
 			Assimp::Importer importer;
 			importer.SetPropertyBool(AI_CONFIG_FBX_CONVERT_TO_M, true);
 			importer.SetPropertyBool(AI_CONFIG_IMPORT_FBX_PRESERVE_PIVOTS, false);
+			importer.SetProgressHandler(new ProgressHandler(this)); // owned by the Assimp importer
 			const aiScene* assimpScene = importer.ReadFile(this->GetFilename(), aiProcess_MakeLeftHanded | aiProcess_LimitBoneWeights | aiProcess_PopulateArmatureData | aiProcess_GlobalScale);
 			if (!assimpScene)
 			{
+				this->setError(importer.GetErrorString());
 				return false;
 			}
 
-			this->checkNode(assimpScene, assimpScene->mRootNode, model->root = create_node_from_ai(assimpScene->mRootNode));
+			size_t curveNodeCount = 0;
+			for (uint32_t animationIndex = 0; animationIndex < assimpScene->mNumAnimations; ++animationIndex)
+			{
+				curveNodeCount += assimpScene->mAnimations[animationIndex]->mNumChannels * 3llu;
+			}
+			size_t boneCount = 0;
+			for (uint32_t meshIndex = 0; meshIndex < assimpScene->mNumMeshes; ++meshIndex)
+			{
+				boneCount += assimpScene->mMeshes[meshIndex]->mNumBones;
+			}
+			mBuilder->ReserveMeshes(assimpScene->mNumMeshes);
+			mBuilder->ReserveWeightCollections(boneCount);
+			mBuilder->ReserveMaterials(assimpScene->mNumMaterials);
+			mBuilder->ReserveCurveNodes(curveNodeCount);
+
+			mNodeCount = count_ai_nodes(assimpScene->mRootNode);
+			mCheckedNodeCount = 0;
+			if (!this->checkNode(assimpScene, assimpScene->mRootNode, model->root = create_node_from_ai(assimpScene->mRootNode, this->GetParams().localMatrices)))
+			{
+				return false;
+			}
+			this->checkSkeleton(assimpScene); // the bone weights belong to the nodes phase, see ImportPhase
 
 			for (uint32_t animationIndex = 0; animationIndex < assimpScene->mNumAnimations; ++animationIndex)
 			{
+				if (!this->reportProgress(IMPORT_PHASE_ANIMATIONS, static_cast<float>(animationIndex) / assimpScene->mNumAnimations))
+				{
+					return false;
+				}
 				this->checkAnimation(assimpScene, assimpScene->mAnimations[animationIndex]);
 			}
 
-			this->checkSkeleton(assimpScene);
+			if (!this->reportProgress(IMPORT_PHASE_ANIMATIONS, 1.0f))
+			{
+				return false;
+			}
 
-			g_set_string(&model->root->name, std::filesystem::path(this->GetFilename()).replace_extension().filename().string().c_str());
+			models_set_string(&model->root->name, std::filesystem::path(this->GetFilename()).replace_extension().filename().string().c_str());
 
 			return true;
 		}
 
-		void AssimpModelImporter::checkNode(const aiScene* assimpScene, const aiNode* assimpNode, Node* node)
+		std::string AssimpModelImporter::getVersion() const
 		{
+			char version[64];
+			snprintf(version, sizeof(version), "Assimp %u.%u %x", aiGetVersionMajor(), aiGetVersionMinor(), aiGetVersionRevision());
+			return version;
+		}
+
+		Importer* AssimpModelImporter::createImporter(const ImportParams& params) const
+		{
+			return new AssimpModelImporter(params);
+		}
+
+		bool AssimpModelImporter::checkNode(const aiScene* assimpScene, const aiNode* assimpNode, Node* node)
+		{
+			// meshes are converted with the first node referencing them, so this also stops between meshes
+			if (!this->reportProgress(IMPORT_PHASE_NODES, static_cast<float>(mCheckedNodeCount++) / mNodeCount))
+			{
+				return false;
+			}
+
 			assert(assimpNode->mNumMeshes <= 1 && "should optimize mesh collection");
 			for (unsigned int i = 0; i < assimpNode->mNumMeshes; ++i)
 			{
 				const aiMesh* assimpMesh = assimpScene->mMeshes[assimpNode->mMeshes[i]];
+				auto meshFinder = mAssimp2MeshMap.find(assimpMesh);
+				if (mAssimp2MeshMap.end() != meshFinder)
+				{
+					// instanced by another node, convert each source mesh only once
+					node->mesh = mesh_retain(meshFinder->second);
+					continue;
+				}
+
 				Mesh* mesh = create_mesh(assimpMesh->mName.C_Str());
 				this->checkMesh(assimpScene, assimpMesh, mesh);
 				mAssimp2MeshMap[assimpMesh] = mesh;
-				model_add_mesh(mModel, mesh);
+				mBuilder->AddMesh(mesh);
 				node->mesh = mesh;
 			}
 
 			for (unsigned int i = 0; i < assimpNode->mNumChildren; ++i)
 			{
 				const aiNode* aiChild = assimpNode->mChildren[i];
-				Node* child = create_node_from_ai(aiChild);
-				this->checkNode(assimpScene, aiChild, child);
-				node_add_child(node, child);
+				Node* child = create_node_from_ai(aiChild, this->GetParams().localMatrices);
+				const bool checked = this->checkNode(assimpScene, aiChild, child);
+				mBuilder->AddChild(node, child);
+				if (!checked)
+				{
+					return false;
+				}
 			}
 
 			node->visible = true;
 			mAssimp2NodeMap[assimpNode] = node;
 			this->registerNode(node);
+			return true;
 		}
 
 		static std::vector<aiTextureType> check_material_texture_type(const aiMaterial* aiMaterial)
@@ -147,14 +238,33 @@ namespace General
 		void AssimpModelImporter::checkMesh(const aiScene* assimpScene, const aiMesh* assimpMesh, Mesh* mesh)
 		{
 			const uint32_t vertexCount = assimpMesh->mNumVertices;
-			mesh_set_vertex_count(mesh, static_cast<int>(vertexCount));
+			const uint32_t& uvSetCount = assimpMesh->GetNumUVChannels();
+			unsigned int streamFlags = VERTEX_STREAM_POSITION;
+			if (assimpMesh->HasNormals())
+			{
+				streamFlags |= VERTEX_STREAM_NORMAL;
+			}
+			for (uint32_t uvSetIndex = 0; uvSetIndex < uvSetCount && uvSetIndex < 4; ++uvSetIndex)
+			{
+				streamFlags |= VERTEX_STREAM_UV(uvSetIndex);
+			}
+			mesh_set_vertex_streams(mesh, static_cast<int>(vertexCount), streamFlags);
+
 			const aiVector3D* assimpVertex = assimpMesh->mVertices;
-			const aiVector3D* assimpNormal = assimpMesh->mNormals;
-			Vertex* vertex = mesh->vertices;
-			for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++vertex, ++assimpVertex, ++assimpNormal)
+			Vector3* position = mesh->positions;
+			for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++position, ++assimpVertex)
 			{
-				vertex->position = vector3_from_ai(*assimpVertex);
-				vertex->normal = vector3_from_ai(*assimpNormal);
+				*position = vector3_from_ai(*assimpVertex);
+			}
+
+			if (mesh->normals)
+			{
+				const aiVector3D* assimpNormal = assimpMesh->mNormals;
+				Vector3* normal = mesh->normals;
+				for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++normal, ++assimpNormal)
+				{
+					*normal = vector3_from_ai(*assimpNormal);
+				}
 			}
 
 			const aiFace* assimpFace = assimpMesh->mFaces;
@@ -188,15 +298,14 @@ namespace General
 			}
 			mesh_set_triangles(mesh, static_cast<int>(triangles.size()), triangles.data());
 
-			const uint32_t& uvSetCount = assimpMesh->GetNumUVChannels();
 			for (uint32_t uvSetIndex = 0; uvSetIndex < uvSetCount && uvSetIndex < 4; ++uvSetIndex)
 			{
-				vertex = mesh->vertices;
+				Vector2* uv = mesh->uvs[uvSetIndex];
 				const aiVector3D* aiUV = assimpMesh->mTextureCoords[uvSetIndex];
-				for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++vertex, ++aiUV)
+				for (uint32_t vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++uv, ++aiUV)
 				{
-					vertex->uv[uvSetIndex].x = aiUV->x;
-					vertex->uv[uvSetIndex].y = aiUV->y;
+					uv->x = aiUV->x;
+					uv->y = aiUV->y;
 				}
 			}
 
@@ -218,8 +327,8 @@ namespace General
 							material_set_diffuse(material, filename.c_str(), nullptr);
 						}
 					}
-					mesh_add_material(mesh, material);
-					model_add_material(mModel, material);
+					mBuilder->AddMeshMaterial(mesh, material);
+					mBuilder->AddMaterial(material);
 				}
 			}
 
@@ -267,21 +376,21 @@ namespace General
 				if (assimpNodeAnimation->mNumPositionKeys > 0)
 				{
 					AnimationCurveNode* curveNode = animation_curve_from_ai(assimpScene, assimpNodeAnimation->mNumPositionKeys, assimpNodeAnimation->mPositionKeys, tickDuration, vector3_from_ai, node, AnimationCurveNodeTranslation);
-					animation_curve_add_node(animationCurve, curveNode);
+					mBuilder->AddCurveNode(animationCurve, curveNode);
 				}
 				if (assimpNodeAnimation->mNumRotationKeys > 0)
 				{
 					AnimationCurveNode* curveNode = animation_curve_from_ai(assimpScene, assimpNodeAnimation->mNumRotationKeys, assimpNodeAnimation->mRotationKeys, tickDuration, vector4_from_ai_quaternion, node, AnimationCurveNodeRotation);
-					animation_curve_add_node(animationCurve, curveNode);
+					mBuilder->AddCurveNode(animationCurve, curveNode);
 				}
 				if (assimpNodeAnimation->mNumScalingKeys > 0)
 				{
 					AnimationCurveNode* curveNode = animation_curve_from_ai(assimpScene, assimpNodeAnimation->mNumScalingKeys, assimpNodeAnimation->mScalingKeys, tickDuration, vector3_from_ai, node, AnimationCurveNodeScaling);
-					animation_curve_add_node(animationCurve, curveNode);
+					mBuilder->AddCurveNode(animationCurve, curveNode);
 				}
 			}
 
-			model_add_animation(mModel, animation);
+			mBuilder->AddAnimation(animation);
 		}
 
 		void AssimpModelImporter::checkSkeleton(const aiScene* assimpScene)
@@ -338,7 +447,7 @@ namespace General
 				weight->index = static_cast<int>(assimpWeight->mVertexId);
 				weight->weight = static_cast<float>(assimpWeight->mWeight);
 			}
-			mesh_add_weight_collection(mesh, weightCollection);
+			mBuilder->AddMeshWeightCollection(mesh, weightCollection);
 		}
 	}
 }
\ No newline at end of file
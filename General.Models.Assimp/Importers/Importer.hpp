@@ -18,6 +18,10 @@ namespace General
 		class AssimpModelImporter : public Importer
 		{
 		private:
+			class ProgressHandler;
+
+			unsigned int mNodeCount;
+			unsigned int mCheckedNodeCount;
 			std::unordered_map<const aiNode*, Node*> mAssimp2NodeMap;
 			std::unordered_map<const aiMesh*, Mesh*> mAssimp2MeshMap;
 			std::unordered_map<Mesh*, std::vector<aiBone*>> mMeshBones;
@@ -26,8 +30,11 @@ namespace General
 			~AssimpModelImporter();
 		protected:
 			virtual bool internalImport(Model* model) override;
+			virtual std::string getVersion() const override;
+		public:
+			virtual Importer* createImporter(const ImportParams& params) const override;
 		private:
-			void checkNode(const aiScene* assimpScene, const aiNode* assimpNode, Node* node);
+			bool checkNode(const aiScene* assimpScene, const aiNode* assimpNode, Node* node); // false if cancelled
 			void checkMesh(const aiScene* assimpScene, const aiMesh* assimpMesh, Mesh* mesh);
 
 			void checkAnimation(const aiScene* assimpScene, const aiAnimation* assimpAnimation);
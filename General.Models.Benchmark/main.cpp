@@ -0,0 +1,214 @@
+﻿// General.Models.Benchmark.cpp : measures the bvh on a large synthetic mesh, pass the grid resolution to change its size
+// "batch [file count] [resolution]" measures batch imports of synthetic obj files through assimp instead
+//
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <General.Cpp/General.hpp>
+#include <General.Models.Common/Common.hpp>
+#include <General.Models.Assimp/Assimp.hpp>
+#include <chrono>
+#include <filesystem>
+#include <math.h>
+#include <random>
+#include <stdlib.h>
+#include <string>
+#include <string.h>
+#include <vector>
+using namespace General::Models;
+
+static double seconds_since(const std::chrono::steady_clock::time_point& start)
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a rolling height field of resolution * resolution cells, two triangles each
+static Mesh* create_terrain(const int resolution)
+{
+	Mesh* mesh = create_mesh("terrain");
+	const int side = resolution + 1;
+	mesh_set_vertex_count(mesh, side * side);
+	for (int z = 0; z < side; ++z)
+	{
+		for (int x = 0; x < side; ++x)
+		{
+			const float u = static_cast<float>(x) / resolution, v = static_cast<float>(z) / resolution;
+			const float height = .05f * sinf(u * 37.0f) * cosf(v * 23.0f) + .02f * sinf((u + v) * 131.0f);
+			mesh->vertices[z * side + x].position = { u * 2.0f - 1.0f, height, v * 2.0f - 1.0f };
+		}
+	}
+
+	std::vector<int> indices;
+	indices.reserve(static_cast<size_t>(resolution) * resolution * 6);
+	for (int z = 0; z < resolution; ++z)
+	{
+		for (int x = 0; x < resolution; ++x)
+		{
+			const int a = z * side + x, b = a + 1, c = a + side, d = c + 1;
+			const int quad[6] = { a, c, b, b, c, d };
+			indices.insert(indices.end(), quad, quad + 6);
+		}
+	}
+	mesh_set_indices(mesh, static_cast<int>(indices.size()), indices.data());
+	return mesh;
+}
+
+static void measure_rays(const char* label, const Bvh* bvh, const std::vector<BvhRay>& rays)
+{
+	std::vector<BvhHit> hits(rays.size());
+	const int count = static_cast<int>(rays.size());
+	double best = 1e30;
+	for (int round = 0; round < 5; ++round)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		bvh_intersect_rays(bvh, rays.data(), hits.data(), count);
+		best = std::min(best, seconds_since(start));
+	}
+
+	int hitCount = 0;
+	for (const BvhHit& hit : hits)
+	{
+		if (hit.triangle >= 0) ++hitCount;
+	}
+	printf("%-10s %9d rays, %8.2f Mrays/s, %5.1f%% hit\n", label, count, count / best * 1e-6, 100.0 * hitCount / count);
+}
+
+// the terrain again as text, so assimp has real parsing to do
+static bool write_terrain_obj(const std::filesystem::path& filename, const int resolution, const int seed)
+{
+	FILE* file = fopen(filename.string().c_str(), "w");
+	if (!file)
+	{
+		return false;
+	}
+
+	const int side = resolution + 1;
+	for (int z = 0; z < side; ++z)
+	{
+		for (int x = 0; x < side; ++x)
+		{
+			const float u = static_cast<float>(x) / resolution, v = static_cast<float>(z) / resolution;
+			const float height = .05f * sinf(u * (37.0f + seed)) * cosf(v * 23.0f);
+			fprintf(file, "v %f %f %f\nvn 0 1 0\nvt %f %f\n", u * 2.0f - 1.0f, height, v * 2.0f - 1.0f, u, v);
+		}
+	}
+	for (int z = 0; z < resolution; ++z)
+	{
+		for (int x = 0; x < resolution; ++x)
+		{
+			const int a = z * side + x + 1, b = a + 1, c = a + side, d = c + 1;
+			fprintf(file, "f %d/%d/%d %d/%d/%d %d/%d/%d\nf %d/%d/%d %d/%d/%d %d/%d/%d\n", a, a, a, c, c, c, b, b, b, b, b, b, c, c, c, d, d, d);
+		}
+	}
+	return 0 == fclose(file);
+}
+
+static int measure_batch(const int fileCount, const int resolution)
+{
+	const std::filesystem::path directory = std::filesystem::temp_directory_path() / "General.Models.Benchmark";
+	std::filesystem::create_directories(directory);
+	std::vector<std::string> filenames(fileCount);
+	uintmax_t totalSize = 0;
+	for (int i = 0; i < fileCount; ++i)
+	{
+		const std::filesystem::path filename = directory / ("terrain" + std::to_string(i) + ".obj");
+		if (!write_terrain_obj(filename, resolution, i))
+		{
+			printf("failed to write %s\n", filename.string().c_str());
+			return 1;
+		}
+		filenames[i] = filename.string();
+		totalSize += std::filesystem::file_size(filename);
+	}
+	printf("batch: %d files, %.1f MB, %d threads\n", fileCount, totalSize / 1048576.0, parallel_thread_count());
+
+	std::vector<ImportParams> params(fileCount);
+	for (int i = 0; i < fileCount; ++i)
+	{
+		params[i] = { };
+		params[i].unitLevel = UNIT_LEVEL_METER;
+		params[i].filename = filenames[i].c_str();
+	}
+
+	// 1, 2, 4 .. jobs and then every core
+	std::vector<BatchImportResult> results(fileCount);
+	double single = 0.0;
+	for (int jobs = 1; ; jobs = std::min(jobs * 2, parallel_thread_count()))
+	{
+		const auto start = std::chrono::steady_clock::now();
+		const int importedCount = load_models_from_assimp(params.data(), fileCount, 0, jobs, results.data());
+		const double seconds = seconds_since(start);
+		if (1 == jobs) single = seconds;
+		printf("%3d jobs %8.2f files/s, %5.2fx, %d failed\n", jobs, fileCount / seconds, single / seconds, fileCount - importedCount);
+
+		for (BatchImportResult& result : results)
+		{
+			if (result.model) destroy_model(const_cast<Model*>(result.model));
+		}
+		if (jobs >= parallel_thread_count())
+		{
+			break;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::remove_all(directory, error);
+	return 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && 0 == strcmp(argv[1], "batch"))
+	{
+		return measure_batch(argc > 2 ? atoi(argv[2]) : 64, argc > 3 ? atoi(argv[3]) : 128);
+	}
+
+	const int resolution = argc > 1 ? atoi(argv[1]) : 708;
+	Model* model = create_model();
+	model_bind(model);
+	Mesh* mesh = create_terrain(resolution);
+	model_add_mesh(model, mesh);
+	printf("mesh: %d triangles, %d threads\n", mesh->triangleCount, parallel_thread_count());
+
+	auto start = std::chrono::steady_clock::now();
+	Bvh* bvh = create_mesh_bvh(mesh);
+	printf("build: %.1f ms, %d nodes\n", seconds_since(start) * 1e3, bvh->nodeCount);
+
+	// primary rays of a camera aimed over the whole terrain, neighbouring rays walk the same nodes
+	const int width = 1024;
+	std::vector<BvhRay> rays(static_cast<size_t>(width) * width);
+	for (int y = 0; y < width; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			BvhRay& ray = rays[static_cast<size_t>(y) * width + x];
+			ray.origin = { .0f, 1.5f, -1.5f };
+			ray.direction = { (x + .5f) / width * 2.0f - 1.0f, -1.5f, (y + .5f) / width * 2.0f + .5f };
+			ray.maxDistance = .0f;
+		}
+	}
+	measure_rays("coherent", bvh, rays);
+
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> range(-1.0f, 1.0f);
+	for (BvhRay& ray : rays)
+	{
+		ray.origin = { range(random), range(random) * .2f + .1f, range(random) };
+		ray.direction = { range(random), range(random), range(random) };
+		ray.maxDistance = .0f;
+	}
+	measure_rays("incoherent", bvh, rays);
+
+	std::vector<Vector3> points(rays.size() / 4);
+	for (Vector3& point : points)
+	{
+		point = { range(random), range(random) * .1f, range(random) };
+	}
+	std::vector<BvhHit> hits(points.size());
+	start = std::chrono::steady_clock::now();
+	bvh_closest_points(bvh, points.data(), .0f, hits.data(), static_cast<int>(points.size()));
+	printf("%-10s %9d points, %6.2f Mpoints/s\n", "closest", static_cast<int>(points.size()), points.size() / seconds_since(start) * 1e-6);
+
+	destroy_bvh(bvh);
+	destroy_model(model);
+	return 0;
+}
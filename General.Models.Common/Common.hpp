@@ -2,6 +2,14 @@
 #define GENERAL_MODELS_COMMON_HPP
 
 #include "Types/Types.hpp"
+#include "Math/Math.hpp"
+#include "Processes/Processes.hpp"
+#include "Spatial/Bvh.hpp"
+#include "Importers/ModelBuilder.hpp"
+#include "Importers/ModelFile.hpp"
 #include "Importers/Importer.hpp"
+#include "Importers/Payload.hpp"
+#include "Importers/ImportTask.hpp"
+#include "Importers/BatchImport.hpp"
 
 #endif // GENERAL_MODELS_COMMON_HPP
\ No newline at end of file
@@ -0,0 +1,86 @@
+﻿#include "pch.h"
+#include "BatchImport.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace General
+{
+	namespace Models
+	{
+		static size_t estimate_import_memory(const Importer* importer)
+		{
+			std::error_code error;
+			const uintmax_t size = std::filesystem::file_size(importer->GetFilename(), error);
+			return error ? 0 : static_cast<size_t>(size) * BATCH_IMPORT_MEMORY_FACTOR;
+		}
+
+		static void set_batch_error(BatchImportResult* result, const std::string& error)
+		{
+			snprintf(result->error, sizeof(result->error), "%s", error.c_str());
+		}
+
+		int import_batch(Importer* const* importers, const int count, const size_t memoryBudget, const int jobLimit, BatchImportResult* results)
+		{
+			CHECK(importers && results && count >= 0, 0);
+
+			const int runningLimit = std::max(1, jobLimit > 0 ? std::min(jobLimit, parallel_thread_count()) : parallel_thread_count());
+			std::mutex mutex;
+			std::condition_variable condition;
+			size_t admittedMemory = 0;
+			int runningCount = 0;
+
+			for (int index = 0; index < count; ++index)
+			{
+				Importer* importer = importers[index];
+				BatchImportResult* result = results + index;
+				result->model = nullptr;
+				result->error[0] = '\0';
+				if (!importer)
+				{
+					set_batch_error(result, "no importer");
+					continue;
+				}
+
+				const size_t memory = estimate_import_memory(importer);
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					condition.wait(lock, [&]()
+					{
+						return runningCount < runningLimit && (0 == runningCount || 0 == memoryBudget || admittedMemory + memory <= memoryBudget);
+					});
+					admittedMemory += memory;
+					++runningCount;
+				}
+
+				parallel_submit([&, importer, result, memory]()
+				{
+					const Model* model = importer->Import();
+					result->model = model;
+					if (!model)
+					{
+						const std::string& error = importer->GetErrorMessage();
+						set_batch_error(result, error.empty() ? "failed to import " + importer->GetFilename() : error);
+					}
+					delete importer;
+
+					// notified under the lock, the batch returns as soon as it sees the last import done
+					std::lock_guard<std::mutex> lock(mutex);
+					admittedMemory -= memory;
+					--runningCount;
+					condition.notify_all();
+				});
+			}
+
+			std::unique_lock<std::mutex> lock(mutex);
+			condition.wait(lock, [&]() { return 0 == runningCount; });
+
+			int importedCount = 0;
+			for (int index = 0; index < count; ++index)
+			{
+				if (results[index].model) ++importedCount;
+			}
+			return importedCount;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+﻿#ifndef GENERAL_MODELS_BATCH_IMPORT_HPP
+#define GENERAL_MODELS_BATCH_IMPORT_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* Imports many files concurrently on the worker pool, see
+		* parallel_submit. Imports are admitted in input order while
+		* their estimated peak memory fits the budget, an import that
+		* does not fit waits for running ones to finish, one alone may
+		* always run. Results come back in input order.
+		* ***************************************************************/
+
+#define BATCH_IMPORT_MEMORY_FACTOR 8 // estimated peak memory of an import relative to the size of its file, parsed scene and model included
+
+		class Importer;
+
+		struct BatchImportResult
+		{
+			const Model* model; // belongs to the caller, nullptr if the import failed
+			char error[256]; // why the import failed, empty otherwise
+		};
+
+		/// <summary>imports every item and returns the number of models imported, not to be called from a pool task</summary>
+		/// <param name="importers">count importers, takes ownership</param>
+		/// <param name="memoryBudget">in bytes, 0 for no limit</param>
+		/// <param name="jobLimit">most imports running at once, 0 for one per worker</param>
+		/// <param name="results">count items</param>
+		EXPORT int import_batch(Importer* const* importers, const int count, const size_t memoryBudget, const int jobLimit, BatchImportResult* results);
+	}
+}
+
+#endif // GENERAL_MODELS_BATCH_IMPORT_HPP
@@ -0,0 +1,117 @@
+﻿#include "pch.h"
+#include "ImportTask.hpp"
+
+#include <condition_variable>
+#include <mutex>
+
+namespace General
+{
+	namespace Models
+	{
+		struct ImportTask
+		{
+			Importer* importer;
+			ImportProgressCallback callback;
+			void* userData;
+
+			std::atomic<bool> cancelled;
+			std::atomic<int> phase;
+			std::atomic<float> progress;
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool done;
+			const Model* model;
+		};
+
+		static void import_task_progress(void* userData, const ImportPhase phase, const float progress)
+		{
+			ImportTask* task = static_cast<ImportTask*>(userData);
+			task->phase.store(phase, std::memory_order_relaxed);
+			task->progress.store(progress, std::memory_order_relaxed);
+			if (task->callback)
+			{
+				task->callback(task->userData, phase, progress);
+			}
+		}
+
+		static void run_import_task(ImportTask* task)
+		{
+			const Model* model = task->importer->Import();
+			delete task->importer;
+			task->importer = nullptr;
+
+			// notified under the lock, a waiter may destroy the task as soon as it sees done
+			std::lock_guard<std::mutex> lock(task->mutex);
+			task->model = model;
+			task->done = true;
+			task->condition.notify_all();
+		}
+
+		ImportTask* start_import_task(Importer* importer, const ImportProgressCallback callback, void* userData)
+		{
+			CHECK(importer, nullptr);
+
+			ImportTask* task = new ImportTask();
+			task->importer = importer;
+			task->callback = callback;
+			task->userData = userData;
+			task->cancelled = false;
+			task->phase = IMPORT_PHASE_PARSE;
+			task->progress = 0.0f;
+			task->done = false;
+			task->model = nullptr;
+
+			importer->SetProgressCallback(import_task_progress, task);
+			importer->SetCancelFlag(&task->cancelled);
+			parallel_submit([task]() { run_import_task(task); });
+			return task;
+		}
+
+		void import_task_cancel(ImportTask* instance)
+		{
+			CHECK(instance, );
+			instance->cancelled = true;
+		}
+
+		bool import_task_is_done(const ImportTask* instance)
+		{
+			CHECK(instance, true);
+
+			std::lock_guard<std::mutex> lock(const_cast<ImportTask*>(instance)->mutex);
+			return instance->done;
+		}
+
+		ImportPhase import_task_get_progress(const ImportTask* instance, float* progress)
+		{
+			CHECK(instance, IMPORT_PHASE_PARSE);
+
+			if (progress) *progress = instance->progress.load(std::memory_order_relaxed);
+			return static_cast<ImportPhase>(instance->phase.load(std::memory_order_relaxed));
+		}
+
+		const Model* import_task_wait(ImportTask* instance)
+		{
+			CHECK(instance, nullptr);
+
+			std::unique_lock<std::mutex> lock(instance->mutex);
+			instance->condition.wait(lock, [instance]() { return instance->done; });
+			const Model* model = instance->model;
+			instance->model = nullptr;
+			return model;
+		}
+
+		void destroy_import_task(ImportTask* instance)
+		{
+			CHECK(instance, );
+
+			import_task_cancel(instance);
+			const Model* model = import_task_wait(instance);
+			if (model)
+			{
+				destroy_model(const_cast<Model*>(model));
+			}
+			delete instance;
+		}
+	}
+}
@@ -0,0 +1,32 @@
+﻿#ifndef GENERAL_MODELS_IMPORT_TASK_HPP
+#define GENERAL_MODELS_IMPORT_TASK_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* An import running on the library worker pool, see
+		* parallel_submit. Cancelling is cooperative, the importer stops
+		* between phases and between the meshes of a phase, the task is
+		* done without a model shortly after.
+		* ***************************************************************/
+
+		class Importer;
+		struct ImportTask;
+
+		/// <summary>runs importer->Import() on the worker pool</summary>
+		/// <param name="importer">takes ownership</param>
+		/// <param name="callback">called on the worker thread, nullptr to poll import_task_get_progress instead</param>
+		EXPORT ImportTask* start_import_task(Importer* importer, const ImportProgressCallback callback, void* userData);
+		EXPORT void import_task_cancel(ImportTask* instance);
+		EXPORT bool import_task_is_done(const ImportTask* instance);
+		EXPORT ImportPhase import_task_get_progress(const ImportTask* instance, float* progress); // the phase reported last
+		/// <summary>blocks until the task is done, the model belongs to the caller from then on</summary>
+		/// <returns>nullptr if the import failed or was cancelled, or if the model was already taken</returns>
+		EXPORT const Model* import_task_wait(ImportTask* instance);
+		EXPORT void destroy_import_task(ImportTask* instance); // cancels and waits for a running task, destroys a model nobody took
+	}
+}
+
+#endif // GENERAL_MODELS_IMPORT_TASK_HPP
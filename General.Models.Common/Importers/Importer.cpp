@@ -5,7 +5,13 @@ namespace General
 {
 	namespace Models
 	{
-		Importer::Importer(const ImportParams& params) : mFilename(params.filename), mUnitLevel(params.unitLevel), mHasError(false), mErrorMessage(), mModel(), mScaleFactor(1.0f) { }
+		Importer::Importer(const ImportParams& params) : mFilename(params.filename), mCacheDirectory(params.cacheDirectory ? params.cacheDirectory : ""), mLodTargets(params.lodTargets && params.lodCount > 0 ? params.lodTargets : nullptr, params.lodTargets && params.lodCount > 0 ? params.lodTargets + params.lodCount : nullptr), mUnitLevel(params.unitLevel), mParams(params), mHasError(false), mErrorMessage(), mProgressCallback(), mProgressUserData(), mCancelled(), mModel(), mBuilder(), mScaleFactor(1.0f)
+		{
+			mParams.filename = mFilename.c_str();
+			mParams.cacheDirectory = mCacheDirectory.empty() ? nullptr : mCacheDirectory.c_str();
+			mParams.lodTargets = mLodTargets.empty() ? nullptr : mLodTargets.data();
+			mParams.lodCount = static_cast<int>(mLodTargets.size());
+		}
 
 		Importer::~Importer() { }
 
@@ -19,6 +25,27 @@ namespace General
 			return mUnitLevel;
 		}
 
+		const ImportParams& Importer::GetParams() const
+		{
+			return mParams;
+		}
+
+		const std::string& Importer::GetErrorMessage() const
+		{
+			return mErrorMessage;
+		}
+
+		void Importer::SetProgressCallback(const ImportProgressCallback callback, void* userData)
+		{
+			mProgressCallback = callback;
+			mProgressUserData = userData;
+		}
+
+		void Importer::SetCancelFlag(const std::atomic<bool>* cancelled)
+		{
+			mCancelled = cancelled;
+		}
+
 		std::string Importer::getFullPath(const std::string& maybePath) const
 		{
 			std::filesystem::path path(maybePath);
@@ -51,6 +78,103 @@ namespace General
 			return Directory::FindFile(directory, path.filename(), true).string();
 		}
 
+		static inline unsigned long long hash_rotate(const unsigned long long value, const int bits)
+		{
+			return (value << bits) | (value >> (64 - bits));
+		}
+
+		static unsigned long long hash_bytes(const void* data, const size_t size, unsigned long long hash)
+		{
+			// eight bytes per multiply, far faster than a byte-wise hash on large source files
+			const unsigned long long prime1 = 0x9E3779B185EBCA87ull;
+			const unsigned long long prime2 = 0xC2B2AE3D27D4EB4Full;
+			const unsigned char* bytes = static_cast<const unsigned char*>(data);
+			size_t offset = 0;
+			for (; offset + sizeof(unsigned long long) <= size; offset += sizeof(unsigned long long))
+			{
+				unsigned long long lane;
+				memcpy(&lane, bytes + offset, sizeof(lane));
+				hash ^= hash_rotate(lane * prime2, 31) * prime1;
+				hash = hash_rotate(hash, 27) * prime1 + 0x85EBCA77C2B2AE63ull;
+			}
+			for (; offset < size; ++offset)
+			{
+				hash ^= bytes[offset] * 0x27D4EB2F165667C5ull;
+				hash = hash_rotate(hash, 11) * prime1;
+			}
+
+			hash ^= size;
+			hash ^= hash >> 33;
+			hash *= prime2;
+			hash ^= hash >> 29;
+			hash *= 0x165667B19E3779F9ull;
+			hash ^= hash >> 32;
+			return hash;
+		}
+
+		template <typename T>
+		static unsigned long long hash_value(const T& value, const unsigned long long hash)
+		{
+			return hash_bytes(&value, sizeof(value), hash);
+		}
+
+		std::string Importer::getCachePath() const
+		{
+			FILE* file = fopen(mFilename.c_str(), "rb");
+			if (!file)
+			{
+				return std::string();
+			}
+
+			unsigned long long hash = 0;
+			std::vector<char> buffer(1 << 20);
+			size_t size;
+			while ((size = fread(buffer.data(), 1, buffer.size(), file)) > 0)
+			{
+				hash = hash_bytes(buffer.data(), size, hash);
+			}
+			const bool failed = 0 != ferror(file);
+			fclose(file);
+			if (failed)
+			{
+				return std::string();
+			}
+
+			// texture paths are resolved against the source directory, so a copy of the file elsewhere is another entry
+			const std::string directory = std::filesystem::absolute(std::filesystem::path(mFilename).parent_path()).lexically_normal().string();
+			hash = hash_bytes(directory.data(), directory.size(), hash);
+
+			// member by member, the padding of ImportParams is not initialized
+			hash = hash_value(mParams.unitLevel, hash);
+			hash = hash_value(mParams.arenaBlockSize, hash);
+			hash = hash_value(mParams.vertexStreams, hash);
+			hash = hash_value(mParams.wideIndices, hash);
+			hash = hash_value(mParams.localMatrices, hash);
+			hash = hash_value(mParams.weldVertices, hash);
+			hash = hash_value(mParams.weldEpsilon, hash);
+			hash = hash_value(mParams.optimizeVertexCache, hash);
+			hash = hash_value(mParams.optimizeOverdraw, hash);
+			const int lodCount = mParams.lodTargets && mParams.lodCount > 0 ? mParams.lodCount : 0;
+			hash = hash_value(lodCount, hash);
+			for (int lodIndex = 0; lodIndex < lodCount; ++lodIndex)
+			{
+				hash = hash_value(mParams.lodTargets[lodIndex].ratio, hash);
+				hash = hash_value(mParams.lodTargets[lodIndex].error, hash);
+			}
+			hash = hash_value(mParams.buildMeshlets, hash);
+			hash = hash_value(mParams.batchStaticMeshes, hash);
+
+			const std::string version = this->getVersion();
+			hash = hash_bytes(version.data(), version.size(), hash);
+			hash = hash_value(IMPORTER_VERSION, hash);
+			hash = hash_value(MODEL_FILE_VERSION, hash);
+
+			char key[17];
+			snprintf(key, sizeof(key), "%016llx", hash);
+			const std::string name = std::filesystem::path(mFilename).stem().string() + "-" + key + ".gmdl";
+			return (std::filesystem::path(mCacheDirectory) / name).string();
+		}
+
 		const Model* Importer::Import()
 		{
 			const std::string& filename = mFilename;
@@ -59,30 +183,209 @@ namespace General
 				return nullptr;
 			}
 
-			mModel = create_model();
-			if (!this->internalImport(mModel))
+			const std::string cachePath = mCacheDirectory.empty() ? std::string() : this->getCachePath();
+			if (!cachePath.empty())
+			{
+				const Model* cached = load_model_file(cachePath.c_str());
+				if (cached)
+				{
+					TRACE("Import cache hit: %s -> %s", filename.c_str(), cachePath.c_str());
+					return cached;
+				}
+			}
+
+			// payloads are released one by one, which an arena cannot do
+			mModel = mParams.arenaBlockSize && !mParams.lazyPayloads ? create_model_with_arena(mParams.arenaBlockSize) : create_model();
+			Model* previous = model_bind(mModel);
+			ModelBuilder builder(mModel);
+			mBuilder = &builder;
+			bool succeeded = this->internalImport(mModel) && !this->isCancelled();
+			builder.Freeze();
+			mBuilder = nullptr;
+			if (succeeded)
+			{
+				succeeded = this->finalizeModel(mModel);
+			}
+			model_bind(previous);
+			if (!succeeded)
 			{
+				if (this->isCancelled())
+				{
+					TRACE("Import of %s cancelled", filename.c_str());
+				}
 				destroy_model(mModel);
+				mModel = nullptr;
 				return nullptr;
 			}
+
+			bool cached = false;
+			if (!cachePath.empty())
+			{
+				std::error_code error;
+				std::filesystem::create_directories(mCacheDirectory, error);
+				cached = model_write_file(mModel, cachePath.c_str());
+				if (cached)
+				{
+					TRACE("Import cache miss: %s -> %s", filename.c_str(), cachePath.c_str());
+				}
+				else
+				{
+					TRACE_WARN("Failed to write import cache %s", cachePath.c_str());
+				}
+			}
+
+			if (mParams.lazyPayloads)
+			{
+				// a mapped file is lazy by itself, its payload pages are only read when touched. Without a cache the file is private to this model
+				const Model* mapped = cached ? load_model_file(cachePath.c_str()) : nullptr;
+				if (nullptr == mapped)
+				{
+					mapped = model_map_temporary_file(mModel);
+				}
+				if (mapped)
+				{
+					destroy_model(mModel);
+					return mapped;
+				}
+				TRACE_WARN("Lazy payloads of %s re-parse the source", filename.c_str());
+				model_attach_payload_source(mModel, this->createImporter(mParams));
+			}
 			return mModel;
 		}
 
+		bool Importer::finalizeModel(Model* model)
+		{
+			model_index_names(model);
+			model_build_node_table(model);
+			model_build_mesh_instances(model);
+
+			// before the per-mesh processing, so the batches are welded and optimized like any other mesh
+			if (mParams.batchStaticMeshes)
+			{
+				const BatchReport report = model_batch_static_meshes(model, mParams.wideIndices ? 0 : 0x10000);
+				TRACE("Static batching merged %d nodes into %d meshes: %d -> %d draw calls", report.mergedNodeCount, report.batchCount, report.drawCallsBefore, report.drawCallsAfter);
+			}
+
+			for (int meshIndex = 0; meshIndex < model->meshCount; ++meshIndex)
+			{
+				if (!this->reportProgress(IMPORT_PHASE_MESHES, static_cast<float>(meshIndex) / model->meshCount))
+				{
+					return false;
+				}
+
+				Mesh* mesh = model->meshes[meshIndex];
+				if (mParams.weldVertices)
+				{
+					weld_mesh(mesh, mParams.weldEpsilon);
+				}
+
+				if (mParams.vertexStreams)
+				{
+					mesh_split_vertices(mesh);
+				}
+				else
+				{
+					mesh_interleave_streams(mesh);
+				}
+
+				if (!mParams.wideIndices)
+				{
+					mesh_set_index_format(mesh, mesh_check_index_format(mesh));
+				}
+			}
+
+			// the passes below run over every mesh in parallel, the meshes not started yet are skipped once the import is cancelled
+			if (mParams.optimizeVertexCache || mParams.optimizeOverdraw)
+			{
+				this->optimizeTriangles(model);
+			}
+
+			// after the vertex fetch order is final, the levels index the same vertices
+			if (mParams.lodTargets && mParams.lodCount > 0 && !this->isCancelled())
+			{
+				model_generate_lods(model, mParams.lodTargets, mParams.lodCount, mCancelled);
+			}
+
+			if (mParams.buildMeshlets && !this->isCancelled())
+			{
+				model_build_meshlets(model, MESHLET_MAX_VERTICES, MESHLET_MAX_TRIANGLES, mCancelled);
+			}
+			if (!this->reportProgress(IMPORT_PHASE_MESHES, 1.0f))
+			{
+				return false;
+			}
+
+			// welding and renumbering build the skin of the meshes they change, the others are built here
+			for (int meshIndex = 0; meshIndex < model->meshCount; ++meshIndex)
+			{
+				if (!this->reportProgress(IMPORT_PHASE_SKIN, static_cast<float>(meshIndex) / model->meshCount))
+				{
+					return false;
+				}
+
+				Mesh* mesh = model->meshes[meshIndex];
+				if (mesh->weightCollectionCount && !mesh->skin)
+				{
+					mesh_build_skin(mesh);
+				}
+				mesh_sync_weights(mesh);
+			}
+
+			model_update_bounds(model);
+			return this->reportProgress(IMPORT_PHASE_SKIN, 1.0f);
+		}
+
+		void Importer::optimizeTriangles(Model* model)
+		{
+			const bool overdraw = mParams.optimizeOverdraw;
+			std::vector<VertexCacheStats> before(model->meshCount);
+			std::vector<VertexCacheStats> after(model->meshCount);
+			parallel_for(model->meshCount, [&](const int meshIndex)
+			{
+				if (this->isCancelled()) return;
+				Mesh* mesh = model->meshes[meshIndex];
+				before[meshIndex] = mesh_analyze_vertex_cache(mesh, VERTEX_CACHE_SIZE);
+				optimize_vertex_cache(mesh);
+				if (overdraw) optimize_overdraw(mesh, OVERDRAW_THRESHOLD);
+				after[meshIndex] = mesh_analyze_vertex_cache(mesh, VERTEX_CACHE_SIZE);
+			});
+			if (this->isCancelled())
+			{
+				return;
+			}
+
+			if (overdraw)
+			{
+				// renumbering reallocates the vertices and the skin, which only the thread the model is bound to may do
+				for (int meshIndex = 0; meshIndex < model->meshCount; ++meshIndex)
+				{
+					optimize_vertex_fetch(model->meshes[meshIndex]);
+				}
+			}
+
+			VertexCacheStats totalBefore = { };
+			VertexCacheStats totalAfter = { };
+			for (int meshIndex = 0; meshIndex < model->meshCount; ++meshIndex)
+			{
+				vertex_cache_stats_add(&totalBefore, &before[meshIndex]);
+				vertex_cache_stats_add(&totalAfter, &after[meshIndex]);
+			}
+			TRACE("Vertex cache of %d triangles in %d meshes: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", totalAfter.triangleCount, model->meshCount, totalBefore.acmr, totalAfter.acmr, totalBefore.atvr, totalAfter.atvr);
+		}
 
 		void Importer::registerNode(Node* node)
 		{
-			if (mNodeMap.end() != mNodeMap.find(node->name))
+			if (model_find_node(mModel, node->name))
 			{
 				TRACE_WARN("Duplication node registration for name %s", node->name);
 			}
 
-			mNodeMap[node->name] = node;
+			model_index_node(mModel, node);
 		}
 
 		Node* Importer::findNode(const std::string& name)
 		{
-			auto finder = mNodeMap.find(name);
-			return mNodeMap.end() == finder ? nullptr : finder->second;
+			return model_find_node(mModel, name.c_str());
 		}
 
 		void Importer::setError(const std::string& error)
@@ -90,5 +393,19 @@ namespace General
 			mHasError = true;
 			mErrorMessage = error;
 		}
+
+		bool Importer::isCancelled() const
+		{
+			return mCancelled && mCancelled->load(std::memory_order_relaxed);
+		}
+
+		bool Importer::reportProgress(const ImportPhase phase, const float progress)
+		{
+			if (mProgressCallback)
+			{
+				mProgressCallback(mProgressUserData, phase, progress);
+			}
+			return !this->isCancelled();
+		}
 	}
 }
\ No newline at end of file
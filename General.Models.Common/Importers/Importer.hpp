@@ -1,11 +1,16 @@
 ﻿#ifndef GENERAL_MODELS_IMPORTER_HPP
 #define GENERAL_MODELS_IMPORTER_HPP
 
+#include <atomic>
+
 namespace General
 {
 	namespace Models
 	{
 		struct Model;
+		class ModelBuilder;
+
+#define IMPORTER_VERSION 1 // raise whenever the same source and settings import to a different model, invalidates every import cache
 
 		enum UnitLevel
 		{
@@ -15,24 +20,55 @@ namespace General
 			UNIT_LEVEL_METER,
 		};
 
+		enum ImportPhase // reported in this order, a phase never comes back once the next one started
+		{
+			IMPORT_PHASE_PARSE, // reading the source file
+			IMPORT_PHASE_NODES, // the hierarchy and the meshes, materials and bone weights it references
+			IMPORT_PHASE_ANIMATIONS,
+			IMPORT_PHASE_MESHES, // welding, layout, optimization, lods and meshlets of every mesh
+			IMPORT_PHASE_SKIN, // skin tables
+		};
+
+		typedef void (*ImportProgressCallback)(void* userData, const ImportPhase phase, const float progress); // progress of the phase from 0 to 1, called on the importing thread
+
 		struct GENERAL_API ImportParams
 		{
 			UnitLevel unitLevel; 
 			const char* filename;
+			size_t arenaBlockSize; // allocates the whole model from blocks of this size, 0 to allocate every object separately
+			bool vertexStreams; // stores meshes as separate attribute streams instead of interleaved vertices
+			bool wideIndices; // keeps 32-bit indices even if a mesh has few enough vertices for 16-bit ones
+			bool localMatrices; // keeps the local matrix of every node as read from the source file, see Node::localMatrix
+			bool weldVertices; // merges duplicated vertices of every mesh, see weld_mesh
+			float weldEpsilon; // attribute tolerance of welding, 0 merges exact duplicates only
+			bool optimizeVertexCache; // reorders triangles for post-transform vertex cache reuse and traces ACMR/ATVR before and after
+			bool optimizeOverdraw; // also sorts triangle clusters against overdraw and renumbers vertices in first use order, implies optimizeVertexCache
+			const LodTarget* lodTargets; // generates one LOD level per target for every mesh, see model_generate_lods, copied by the importer
+			int lodCount;
+			bool buildMeshlets; // clusters every mesh into meshlets of MESHLET_MAX_VERTICES and MESHLET_MAX_TRIANGLES, see model_build_meshlets
+			bool batchStaticMeshes; // merges the static meshes sharing materials and traces the draw calls saved, see model_batch_static_meshes
+			const char* cacheDirectory; // keeps a native model file of every import here, keyed by the source bytes, these settings and the importer version, nullptr to always import
+			bool lazyPayloads; // maps the import from the cached or a private temporary model file, payloads are paged in when touched, see model_acquire_mesh. Re-parses the source instead if no file can be written, ignores arenaBlockSize
 		};
 
 		class GENERAL_API Importer
 		{
 		private:
 			const std::string mFilename;
+			const std::string mCacheDirectory;
+			const std::vector<LodTarget> mLodTargets;
 			UnitLevel mUnitLevel;
-
-			std::unordered_map<std::string, Node*> mNodeMap;
+			ImportParams mParams; // filename, cacheDirectory and lodTargets refer to the copies above
 
 			bool mHasError;
 			std::string mErrorMessage;
+
+			ImportProgressCallback mProgressCallback;
+			void* mProgressUserData;
+			const std::atomic<bool>* mCancelled;
 		protected:
 			Model* mModel;
+			ModelBuilder* mBuilder; // valid during internalImport
 			float mScaleFactor;
 		public:
 			Importer(const ImportParams& params);
@@ -40,6 +76,10 @@ namespace General
 
 			const std::string& GetFilename() const;
 			UnitLevel GetUnitLevel() const;
+			const ImportParams& GetParams() const;
+			const std::string& GetErrorMessage() const; // empty unless the importer gave a reason for failing
+			void SetProgressCallback(const ImportProgressCallback callback, void* userData);
+			void SetCancelFlag(const std::atomic<bool>* cancelled); // Import returns nullptr soon after the flag is set
 		protected:
 			std::string getFullPath(const std::string& maybePath) const;
 			std::string findFile(const std::string& maybePath) const;
@@ -47,11 +87,21 @@ namespace General
 			const Model* Import();
 		protected:
 			virtual bool internalImport(Model* model) = 0;
-
-			void registerNode(Node* node);
+			virtual std::string getVersion() const = 0; // of the importer and the library it wraps, a new version invalidates the import cache
+		public:
+			virtual Importer* createImporter(const ImportParams& params) const = 0; // another importer of the same kind, re-parses the source of lazy payloads
+		private:
+			std::string getCachePath() const; // empty if the source cannot be read
+			bool finalizeModel(Model* model); // false if cancelled
+			void optimizeTriangles(Model* model);
+		protected:
+			void registerNode(Node* node); // the first node of a name is kept
 			Node* findNode(const std::string& name);
 
 			void setError(const std::string& error);
+
+			bool isCancelled() const;
+			bool reportProgress(const ImportPhase phase, const float progress); // false once cancelled, internalImport should return false as soon as it can
 		};
 	}
 }
@@ -0,0 +1,153 @@
+﻿#include "pch.h"
+#include "ModelBuilder.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+		template <typename Item> static void append_items(const Model* owner, std::vector<Item*>& items, Item*** array, int* count)
+		{
+			if (items.empty())
+			{
+				return;
+			}
+
+			const int offset = *count;
+			models_resize_array(owner, array, count, offset + static_cast<int>(items.size()));
+			memcpy(*array + offset, items.data(), sizeof(Item*) * items.size());
+			items.clear();
+		}
+
+		/// <summary>appends pairs grouped by owner, keeping the insertion order of every owner, each array grows exactly once</summary>
+		template <typename Owner, typename Item, typename ArrayOf> static void append_owned_items(std::vector<std::pair<Owner*, Item*>>& pairs, ArrayOf array_of)
+		{
+			if (pairs.empty())
+			{
+				return;
+			}
+
+			std::unordered_map<Owner*, int> cursors;
+			cursors.reserve(pairs.size());
+			for (const std::pair<Owner*, Item*>& pair : pairs)
+			{
+				++cursors[pair.first];
+			}
+
+			for (std::pair<Owner* const, int>& cursor : cursors)
+			{
+				const std::pair<Item***, int*> target = array_of(cursor.first);
+				const int offset = *target.second;
+				models_resize_array(cursor.first, target.first, target.second, offset + cursor.second);
+				cursor.second = offset;
+			}
+
+			for (const std::pair<Owner*, Item*>& pair : pairs)
+			{
+				const std::pair<Item***, int*> target = array_of(pair.first);
+				*(*target.first + cursors[pair.first]++) = pair.second;
+			}
+			pairs.clear();
+		}
+
+		ModelBuilder::ModelBuilder(Model* model) : mModel(model) { }
+
+		ModelBuilder::~ModelBuilder() { }
+
+		Model* ModelBuilder::GetModel() const
+		{
+			return mModel;
+		}
+
+		void ModelBuilder::ReserveNodes(const size_t count)
+		{
+			mChildren.reserve(count);
+		}
+
+		void ModelBuilder::ReserveMeshes(const size_t count)
+		{
+			mMeshes.reserve(count);
+			mMeshMaterials.reserve(count);
+		}
+
+		void ModelBuilder::ReserveMaterials(const size_t count)
+		{
+			mMaterials.reserve(count);
+		}
+
+		void ModelBuilder::ReserveWeightCollections(const size_t count)
+		{
+			mMeshWeightCollections.reserve(count);
+		}
+
+		void ModelBuilder::ReserveCurveNodes(const size_t count)
+		{
+			mCurveNodes.reserve(count);
+		}
+
+		void ModelBuilder::AddChild(Node* parent, Node* child)
+		{
+			CHECK(parent && child, );
+			child->parent = parent;
+			mChildren.push_back(std::make_pair(parent, child));
+		}
+
+		void ModelBuilder::AddMesh(Mesh* mesh)
+		{
+			CHECK(mesh, );
+			mMeshes.push_back(mesh);
+		}
+
+		void ModelBuilder::AddMaterial(Material* material)
+		{
+			CHECK(material, );
+			mMaterials.push_back(material);
+			model_index_material(mModel, material);
+		}
+
+		void ModelBuilder::AddAnimation(Animation* animation)
+		{
+			CHECK(animation, );
+			mAnimations.push_back(animation);
+		}
+
+		void ModelBuilder::AddMeshMaterial(Mesh* mesh, Material* material)
+		{
+			CHECK(mesh && material, );
+			mMeshMaterials.push_back(std::make_pair(mesh, material));
+		}
+
+		void ModelBuilder::AddMeshWeightCollection(Mesh* mesh, WeightCollection* collection)
+		{
+			CHECK(mesh && collection, );
+			mMeshWeightCollections.push_back(std::make_pair(mesh, collection));
+		}
+
+		void ModelBuilder::AddCurveNode(AnimationCurve* curve, AnimationCurveNode* node)
+		{
+			CHECK(curve && node, );
+			mCurveNodes.push_back(std::make_pair(curve, node));
+		}
+
+		Material* ModelBuilder::FindMaterial(const char* name) const
+		{
+			CHECK(name, nullptr);
+
+			return model_find_material(mModel, name); // staged materials are indexed by AddMaterial
+		}
+
+		void ModelBuilder::Freeze()
+		{
+			Model* model = mModel;
+			CHECK(model, );
+
+			append_items(model, mMeshes, &model->meshes, &model->meshCount);
+			append_items(model, mMaterials, &model->materials, &model->materialCount);
+			append_items(model, mAnimations, &model->animations, &model->animationCount);
+
+			append_owned_items(mChildren, [](Node* node) { return std::make_pair(&node->children, &node->childCount); });
+			append_owned_items(mMeshMaterials, [](Mesh* mesh) { return std::make_pair(&mesh->materials, &mesh->materialCount); });
+			append_owned_items(mMeshWeightCollections, [](Mesh* mesh) { return std::make_pair(&mesh->weightCollections, &mesh->weightCollectionCount); });
+			append_owned_items(mCurveNodes, [](AnimationCurve* curve) { return std::make_pair(const_cast<AnimationCurveNode***>(&curve->nodes), const_cast<int*>(&curve->nodeCount)); });
+		}
+	}
+}
@@ -0,0 +1,54 @@
+﻿#ifndef GENERAL_MODELS_MODEL_BUILDER_HPP
+#define GENERAL_MODELS_MODEL_BUILDER_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* Collects the hierarchy, meshes and curve nodes of a model in
+		* growable buffers, Freeze writes everything collected so far into
+		* the flat arrays of Model, Node, Mesh and AnimationCurve at once.
+		* Node::parent is assigned immediately, every other array is only
+		* valid after Freeze.
+		* ***************************************************************/
+		class GENERAL_API ModelBuilder
+		{
+		private:
+			Model* mModel;
+
+			std::vector<std::pair<Node*, Node*>> mChildren;
+			std::vector<Mesh*> mMeshes;
+			std::vector<Material*> mMaterials;
+			std::vector<Animation*> mAnimations;
+			std::vector<std::pair<Mesh*, Material*>> mMeshMaterials;
+			std::vector<std::pair<Mesh*, WeightCollection*>> mMeshWeightCollections;
+			std::vector<std::pair<AnimationCurve*, AnimationCurveNode*>> mCurveNodes;
+		public:
+			ModelBuilder(Model* model);
+			~ModelBuilder();
+
+			Model* GetModel() const;
+
+			void ReserveNodes(const size_t count);
+			void ReserveMeshes(const size_t count);
+			void ReserveMaterials(const size_t count);
+			void ReserveWeightCollections(const size_t count);
+			void ReserveCurveNodes(const size_t count);
+
+			void AddChild(Node* parent, Node* child);
+			void AddMesh(Mesh* mesh);
+			void AddMaterial(Material* material);
+			void AddAnimation(Animation* animation);
+			void AddMeshMaterial(Mesh* mesh, Material* material);
+			void AddMeshWeightCollection(Mesh* mesh, WeightCollection* collection);
+			void AddCurveNode(AnimationCurve* curve, AnimationCurveNode* node);
+
+			Material* FindMaterial(const char* name) const;
+
+			void Freeze();
+		};
+	}
+}
+
+#endif // GENERAL_MODELS_MODEL_BUILDER_HPP
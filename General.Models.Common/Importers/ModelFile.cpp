@@ -0,0 +1,676 @@
+﻿#include "pch.h"
+#include "ModelFile.hpp"
+
+#include <stddef.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+namespace General
+{
+	namespace Models
+	{
+#define MODEL_FILE_ALIGNMENT 16llu
+
+		static const char MODEL_FILE_MAGIC[4] = { 'G', 'M', 'D', 'L' };
+
+		static unsigned int model_file_layout()
+		{
+			// every structure copied as it is into the block, a different compiler or member layout changes the hash
+			const size_t sizes[] = {
+				sizeof(void*), sizeof(Model), sizeof(StringPool), sizeof(NodeTable), sizeof(Node), sizeof(Matrix),
+				sizeof(Mesh), sizeof(Vertex), sizeof(Submesh), sizeof(MeshLod), sizeof(MeshletTable), sizeof(Meshlet),
+				sizeof(SkinTable), sizeof(SkinInfluence), sizeof(WeightCollection), sizeof(WeightData),
+				sizeof(Material), sizeof(MaterialTexture), sizeof(UVSet), sizeof(UV), sizeof(Bounds), sizeof(BatchRange),
+				sizeof(Animation), sizeof(AnimationCurve), sizeof(AnimationCurveNode), sizeof(AnimationCurveFrame),
+			};
+			unsigned int hash = 2166136261u;
+			for (const size_t size : sizes)
+			{
+				hash = (hash ^ static_cast<unsigned int>(size)) * 16777619u;
+			}
+			return hash;
+		}
+
+		static size_t model_file_model_offset()
+		{
+			return (sizeof(ModelFileHeader) + MODEL_FILE_ALIGNMENT - 1) & ~(MODEL_FILE_ALIGNMENT - 1);
+		}
+
+		/// <summary>
+		/// appends every object once, shared nodes, meshes, materials, uv sets and strings by identity, and stores pointers as
+		/// offsets into the block, 0 for nullptr. Data may move while objects are appended, so only offsets are kept
+		/// </summary>
+		class ModelFileWriter
+		{
+		private:
+			std::vector<char> mData;
+			std::vector<unsigned long long> mRelocations;
+			std::unordered_map<const void*, size_t> mObjects; // nodes, meshes, materials and uv sets
+			std::unordered_map<std::string, size_t> mStrings;
+		public:
+			ModelFileWriter()
+			{
+				this->reserve(sizeof(ModelFileHeader));
+			}
+
+			std::vector<char>& Write(const Model* model)
+			{
+				const size_t offset = this->reserve(sizeof(Model)); // at model_file_model_offset
+				memcpy(mData.data() + offset, model, sizeof(Model));
+
+				this->link(offset + offsetof(Model, arena), 0);
+				this->link(offset + offsetof(Model, file), 0);
+				this->link(offset + offsetof(Model, payloads), 0);
+				this->link(offset + offsetof(Model, names), this->writeStringPool(model->names));
+				this->link(offset + offsetof(Model, nodeNames) + offsetof(NameTable, items), this->writeNameTable(&model->nodeNames, &ModelFileWriter::writeNode));
+				this->link(offset + offsetof(Model, materialNames) + offsetof(NameTable, items), this->writeNameTable(&model->materialNames, &ModelFileWriter::writeMaterial));
+				this->link(offset + offsetof(Model, uvSetNames) + offsetof(NameTable, items), this->writeNameTable(&model->uvSetNames, &ModelFileWriter::writeUVSet));
+				this->link(offset + offsetof(Model, root), this->writeNode(model->root));
+				this->link(offset + offsetof(Model, nodeTable), this->writeNodeTable(model->nodeTable));
+				this->link(offset + offsetof(Model, nodeBounds), this->writeArray(model->nodeBounds, model->nodeBoundsCount));
+				this->link(offset + offsetof(Model, batchRanges), this->writeBatchRanges(model->batchRanges, model->batchRangeCount));
+				this->link(offset + offsetof(Model, meshes), this->writePointers(model->meshes, model->meshCount, &ModelFileWriter::writeMesh));
+				this->link(offset + offsetof(Model, materials), this->writePointers(model->materials, model->materialCount, &ModelFileWriter::writeMaterial));
+				this->link(offset + offsetof(Model, uvSets), this->writePointers(model->uvSets, model->uvSetCount, &ModelFileWriter::writeUVSet));
+				this->link(offset + offsetof(Model, animations), this->writePointers(model->animations, model->animationCount, &ModelFileWriter::writeAnimation));
+
+				// the relocations go last, so a loader may drop them once they are applied
+				const size_t relocationOffset = this->reserve(sizeof(unsigned long long) * mRelocations.size());
+				if (mRelocations.size()) memcpy(mData.data() + relocationOffset, mRelocations.data(), sizeof(unsigned long long) * mRelocations.size());
+
+				ModelFileHeader* header = reinterpret_cast<ModelFileHeader*>(mData.data());
+				memcpy(header->magic, MODEL_FILE_MAGIC, sizeof(header->magic));
+				header->version = MODEL_FILE_VERSION;
+				header->layout = model_file_layout();
+				header->storage = MODEL_FILE_STORAGE_NONE;
+				header->size = mData.size();
+				header->relocationOffset = relocationOffset;
+				header->relocationCount = mRelocations.size();
+				return mData;
+			}
+		private:
+			size_t reserve(const size_t size)
+			{
+				const size_t offset = (mData.size() + MODEL_FILE_ALIGNMENT - 1) & ~(MODEL_FILE_ALIGNMENT - 1);
+				mData.resize(offset + size, 0);
+				return offset;
+			}
+
+			template <typename T> size_t copy(const T* source, const size_t count)
+			{
+				const size_t offset = this->reserve(sizeof(T) * count);
+				memcpy(mData.data() + offset, source, sizeof(T) * count);
+				return offset;
+			}
+
+			template <typename T> T* at(const size_t offset)
+			{
+				return reinterpret_cast<T*>(mData.data() + offset);
+			}
+
+			// every pointer slot of a copied structure is written, either with a target or with nullptr, slots keep the
+			// pointer size of the build, which model_file_layout hashes, so 32-bit and 64-bit files reject each other
+			void link(const size_t slot, const size_t target)
+			{
+				static_assert(sizeof(target) == sizeof(void*), "pointer slots hold a size_t offset");
+				memcpy(mData.data() + slot, &target, sizeof(target));
+				if (target) mRelocations.push_back(slot);
+			}
+
+			template <typename T> size_t writeArray(const T* source, const int count)
+			{
+				return source && count > 0 ? this->copy(source, count) : 0;
+			}
+
+			template <typename P, typename T> size_t writePointers(P const* items, const int count, size_t (ModelFileWriter::*write)(const T*))
+			{
+				if (nullptr == items || count <= 0)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->reserve(sizeof(void*) * count);
+				for (int i = 0; i < count; ++i)
+				{
+					this->link(offset + sizeof(void*) * i, (this->*write)(items[i]));
+				}
+				return offset;
+			}
+
+			size_t writeString(const char* value)
+			{
+				if (nullptr == value)
+				{
+					return 0;
+				}
+
+				const auto found = mStrings.find(value);
+				if (mStrings.end() != found)
+				{
+					return found->second;
+				}
+				const size_t offset = this->copy(value, strlen(value) + 1);
+				mStrings[value] = offset;
+				return offset;
+			}
+
+			size_t writeStringPool(const StringPool* pool)
+			{
+				if (nullptr == pool)
+				{
+					return 0;
+				}
+
+				// lookups only read the ids, hashes and slots, so the pool keeps working without its arena
+				const size_t offset = this->copy(pool, 1);
+				StringPool* frozen = this->at<StringPool>(offset);
+				frozen->capacity = pool->count;
+				this->link(offset + offsetof(StringPool, arena), 0);
+				this->link(offset + offsetof(StringPool, strings), this->writePointers(pool->strings, pool->count, &ModelFileWriter::writeString));
+				this->link(offset + offsetof(StringPool, hashes), this->writeArray(pool->hashes, pool->count));
+				this->link(offset + offsetof(StringPool, slots), this->writeArray(pool->slots, pool->slotCount));
+				return offset;
+			}
+
+			template <typename T> size_t writeNameTable(const NameTable* table, size_t (ModelFileWriter::*write)(const T*))
+			{
+				return this->writePointers(reinterpret_cast<T* const*>(table->items), table->count, write);
+			}
+
+			size_t writeNode(const Node* node)
+			{
+				if (nullptr == node)
+				{
+					return 0;
+				}
+
+				const auto found = mObjects.find(node);
+				if (mObjects.end() != found)
+				{
+					return found->second;
+				}
+				const size_t offset = this->copy(node, 1);
+				mObjects[node] = offset;
+
+				this->link(offset + offsetof(Node, name), this->writeString(node->name));
+				this->link(offset + offsetof(Node, parent), this->writeNode(node->parent));
+				this->link(offset + offsetof(Node, localMatrix), this->writeArray(node->localMatrix, 1));
+				this->link(offset + offsetof(Node, children), this->writePointers(node->children, node->childCount, &ModelFileWriter::writeNode));
+				this->link(offset + offsetof(Node, mesh), this->writeMesh(node->mesh));
+				return offset;
+			}
+
+			size_t writeNodeTable(const NodeTable* table)
+			{
+				if (nullptr == table)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(table, 1);
+				this->link(offset + offsetof(NodeTable, nodes), this->writePointers(table->nodes, table->count, &ModelFileWriter::writeNode));
+				this->link(offset + offsetof(NodeTable, parents), this->writeArray(table->parents, table->count));
+				this->link(offset + offsetof(NodeTable, ends), this->writeArray(table->ends, table->count));
+
+				// the transform arrays are stride floats apart in one block
+				const NodeTransforms& transforms = table->transforms;
+				const float* sources[] = {
+					transforms.positionX, transforms.positionY, transforms.positionZ,
+					transforms.rotationX, transforms.rotationY, transforms.rotationZ, transforms.rotationW,
+					transforms.scalingX, transforms.scalingY, transforms.scalingZ,
+				};
+				const int arrayCount = static_cast<int>(sizeof(sources) / sizeof(sources[0]));
+				const size_t block = this->reserve(sizeof(float) * transforms.stride * arrayCount);
+				const size_t slots = offset + offsetof(NodeTable, transforms) + offsetof(NodeTransforms, positionX);
+				for (int i = 0; i < arrayCount; ++i)
+				{
+					const size_t array = block + sizeof(float) * transforms.stride * i;
+					if (sources[i]) memcpy(mData.data() + array, sources[i], sizeof(float) * transforms.stride);
+					this->link(slots + sizeof(float*) * i, sources[i] ? array : 0);
+				}
+				return offset;
+			}
+
+			size_t writeBatchRanges(const BatchRange* ranges, const int count)
+			{
+				const size_t offset = this->writeArray(ranges, count);
+				for (int i = 0; i < count && offset; ++i)
+				{
+					const size_t range = offset + sizeof(BatchRange) * i;
+					this->link(range + offsetof(BatchRange, node), this->writeNode(ranges[i].node));
+					this->link(range + offsetof(BatchRange, batch), this->writeMesh(ranges[i].batch));
+				}
+				return offset;
+			}
+
+			size_t writeTexture(const MaterialTexture* texture)
+			{
+				if (nullptr == texture)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(texture, 1);
+				this->link(offset + offsetof(MaterialTexture, texture), this->writeString(texture->texture));
+				this->link(offset + offsetof(MaterialTexture, uvSet), this->writeString(texture->uvSet));
+				return offset;
+			}
+
+			size_t writeUVSet(const UVSet* uvSet)
+			{
+				if (nullptr == uvSet)
+				{
+					return 0;
+				}
+
+				const auto found = mObjects.find(uvSet);
+				if (mObjects.end() != found)
+				{
+					return found->second;
+				}
+				const size_t offset = this->copy(uvSet, 1);
+				mObjects[uvSet] = offset;
+
+				this->link(offset + offsetof(UVSet, name), this->writeString(uvSet->name));
+				this->link(offset + offsetof(UVSet, uvArray), this->writeArray(uvSet->uvArray, uvSet->uvCount));
+				return offset;
+			}
+
+			size_t writeMaterial(const Material* material)
+			{
+				if (nullptr == material)
+				{
+					return 0;
+				}
+
+				const auto found = mObjects.find(material);
+				if (mObjects.end() != found)
+				{
+					return found->second;
+				}
+				const size_t offset = this->copy(material, 1);
+				mObjects[material] = offset;
+
+				this->link(offset + offsetof(Material, name), this->writeString(material->name));
+				this->link(offset + offsetof(Material, ambient), this->writeTexture(material->ambient));
+				this->link(offset + offsetof(Material, diffuse), this->writeTexture(material->diffuse));
+				this->link(offset + offsetof(Material, emissive), this->writeTexture(material->emissive));
+				this->link(offset + offsetof(Material, specular), this->writeTexture(material->specular));
+				return offset;
+			}
+
+			size_t writeWeightCollection(const WeightCollection* collection)
+			{
+				if (nullptr == collection)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(collection, 1);
+				this->link(offset + offsetof(WeightCollection, bone), this->writeNode(collection->bone));
+				this->link(offset + offsetof(WeightCollection, weights), this->writeArray(collection->weights, collection->weightCount));
+				return offset;
+			}
+
+			size_t writeSkin(const SkinTable* skin)
+			{
+				if (nullptr == skin)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(skin, 1);
+				SkinTable* frozen = this->at<SkinTable>(offset);
+				frozen->vertexCapacity = skin->vertexCount + 1;
+				frozen->influenceCapacity = skin->influenceCount;
+				this->link(offset + offsetof(SkinTable, offsets), this->writeArray(skin->offsets, skin->vertexCount + 1));
+				this->link(offset + offsetof(SkinTable, influences), this->writeArray(skin->influences, skin->influenceCount));
+				return offset;
+			}
+
+			size_t writeMeshlets(const MeshletTable* meshlets)
+			{
+				if (nullptr == meshlets)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(meshlets, 1);
+				this->link(offset + offsetof(MeshletTable, meshlets), this->writeArray(meshlets->meshlets, meshlets->meshletCount));
+				this->link(offset + offsetof(MeshletTable, vertices), this->writeArray(meshlets->vertices, meshlets->vertexCount));
+				this->link(offset + offsetof(MeshletTable, triangles), this->writeArray(meshlets->triangles, meshlets->triangleCount * 3));
+				return offset;
+			}
+
+			size_t writeMesh(const Mesh* mesh)
+			{
+				if (nullptr == mesh)
+				{
+					return 0;
+				}
+
+				const auto found = mObjects.find(mesh);
+				if (mObjects.end() != found)
+				{
+					return found->second;
+				}
+				// the collections are written as they are, frozen meshes are never stale so this only touches heap models
+				mesh_sync_weights(const_cast<Mesh*>(mesh));
+				const size_t offset = this->copy(mesh, 1);
+				mObjects[mesh] = offset;
+
+				// the vertex and index payload first, the small structures referencing it follow
+				const int vertexCount = mesh->vertexCount;
+				this->link(offset + offsetof(Mesh, vertices), this->writeArray(mesh->vertices, vertexCount));
+				this->link(offset + offsetof(Mesh, positions), this->writeArray(mesh->positions, vertexCount));
+				this->link(offset + offsetof(Mesh, normals), this->writeArray(mesh->normals, vertexCount));
+				for (int i = 0; i < 4; ++i)
+				{
+					this->link(offset + offsetof(Mesh, uvs) + sizeof(Vector2*) * i, this->writeArray(mesh->uvs[i], vertexCount));
+				}
+				this->link(offset + offsetof(Mesh, triangles), this->writeArray(mesh->triangles, INDEX_FORMAT_32 == mesh->indexFormat ? mesh->triangleCount : 0));
+				this->link(offset + offsetof(Mesh, shortTriangles), this->writeArray(mesh->shortTriangles, INDEX_FORMAT_16 == mesh->indexFormat ? mesh->triangleCount : 0));
+
+				this->link(offset + offsetof(Mesh, name), this->writeString(mesh->name));
+				this->link(offset + offsetof(Mesh, materials), this->writePointers(mesh->materials, mesh->materialCount, &ModelFileWriter::writeMaterial));
+				this->link(offset + offsetof(Mesh, submeshes), this->writeArray(mesh->submeshes, mesh->submeshCount));
+				this->link(offset + offsetof(Mesh, weightCollections), this->writePointers(mesh->weightCollections, mesh->weightCollectionCount, &ModelFileWriter::writeWeightCollection));
+				this->link(offset + offsetof(Mesh, skin), this->writeSkin(mesh->skin));
+				this->link(offset + offsetof(Mesh, instances), this->writePointers(mesh->instances, mesh->instanceCount, &ModelFileWriter::writeNode));
+				this->link(offset + offsetof(Mesh, meshlets), this->writeMeshlets(mesh->meshlets));
+
+				const size_t lods = this->writeArray(mesh->lods, mesh->lodCount);
+				this->link(offset + offsetof(Mesh, lods), lods);
+				for (int i = 0; i < mesh->lodCount && lods; ++i)
+				{
+					const MeshLod& lod = mesh->lods[i];
+					const size_t level = lods + sizeof(MeshLod) * i;
+					this->link(level + offsetof(MeshLod, triangles), this->writeArray(lod.triangles, lod.triangleCount));
+					this->link(level + offsetof(MeshLod, submeshes), this->writeArray(lod.submeshes, lod.submeshes ? mesh->submeshCount : 0));
+				}
+				return offset;
+			}
+
+			size_t writeCurveNode(const AnimationCurveNode* node)
+			{
+				if (nullptr == node)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(node, 1);
+				this->link(offset + offsetof(AnimationCurveNode, target), this->writeNode(node->target));
+				this->link(offset + offsetof(AnimationCurveNode, frames), this->writeArray(node->frames, node->frameCount));
+				return offset;
+			}
+
+			size_t writeAnimation(const Animation* animation)
+			{
+				if (nullptr == animation)
+				{
+					return 0;
+				}
+
+				const size_t offset = this->copy(animation, 1);
+				this->link(offset + offsetof(Animation, name), this->writeString(animation->name));
+
+				size_t curve = 0;
+				if (animation->curve)
+				{
+					curve = this->copy(animation->curve, 1);
+					this->link(curve + offsetof(AnimationCurve, nodes), this->writePointers(animation->curve->nodes, animation->curve->nodeCount, &ModelFileWriter::writeCurveNode));
+				}
+				this->link(offset + offsetof(Animation, curve), curve);
+				return offset;
+			}
+		};
+
+		/// <summary>checks the header against the block, then turns every stored offset into an address</summary>
+		static const Model* relocate_model_file(char* base, const size_t size, const ModelFileStorage storage)
+		{
+			ModelFileHeader* header = reinterpret_cast<ModelFileHeader*>(base);
+			CHECK(size >= model_file_model_offset() + sizeof(Model), nullptr);
+			CHECK(0 == memcmp(header->magic, MODEL_FILE_MAGIC, sizeof(header->magic)) && MODEL_FILE_VERSION == header->version && model_file_layout() == header->layout, nullptr);
+			CHECK(size == header->size && header->relocationOffset <= size && header->relocationCount <= (size - header->relocationOffset) / sizeof(unsigned long long), nullptr);
+
+			const unsigned long long* relocations = reinterpret_cast<const unsigned long long*>(base + header->relocationOffset);
+			for (unsigned long long i = 0; i < header->relocationCount; ++i)
+			{
+				const unsigned long long slot = relocations[i];
+				CHECK(slot <= header->relocationOffset - sizeof(void*), nullptr);
+				size_t value;
+				memcpy(&value, base + slot, sizeof(value));
+				CHECK(value < header->relocationOffset, nullptr);
+				char* address = base + value;
+				memcpy(base + slot, &address, sizeof(address));
+			}
+
+			header->storage = storage;
+			Model* model = reinterpret_cast<Model*>(base + model_file_model_offset());
+			model->file = header;
+			return model;
+		}
+
+		// unique per process and thread, so concurrent writers of one target never share the temporary file
+		static std::string model_file_temporary_path(const char* filename)
+		{
+#ifdef _WIN32
+			const unsigned long long process = GetCurrentProcessId();
+			const unsigned long long thread = GetCurrentThreadId();
+#else
+			const unsigned long long process = static_cast<unsigned long long>(getpid());
+			const unsigned long long thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+#endif
+			char suffix[64];
+			snprintf(suffix, sizeof(suffix), ".%llu-%llx.tmp", process, thread);
+			return std::string(filename) + suffix;
+		}
+
+		bool model_write_file(const Model* instance, const char* filename)
+		{
+			CHECK(instance && filename, false);
+
+			ModelFileWriter writer;
+			const std::vector<char>& data = writer.Write(instance);
+
+			// written next to the target and renamed, so a reader never maps a partial file
+			const std::string temporary = model_file_temporary_path(filename);
+			FILE* file = fopen(temporary.c_str(), "wb");
+			CHECK(file, false);
+			const bool written = data.size() == fwrite(data.data(), 1, data.size(), file);
+			const bool closed = 0 == fclose(file);
+			std::error_code error;
+			if (written && closed)
+			{
+				std::filesystem::rename(temporary, filename, error);
+				if (!error)
+				{
+					return true;
+				}
+			}
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+
+		const Model* load_model_file(const char* filename)
+		{
+			CHECK(filename, nullptr);
+
+#ifdef _WIN32
+			HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (INVALID_HANDLE_VALUE == file)
+			{
+				// a missing file is the usual import cache miss, not an error
+				const DWORD error = GetLastError();
+				CHECK(ERROR_FILE_NOT_FOUND == error || ERROR_PATH_NOT_FOUND == error, nullptr);
+				return nullptr;
+			}
+			LARGE_INTEGER fileSize = { };
+			HANDLE mapping = GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0 ? CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr) : nullptr;
+			CloseHandle(file);
+			CHECK(mapping, nullptr);
+			char* base = static_cast<char*>(MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0));
+			CloseHandle(mapping);
+			CHECK(base, nullptr);
+			const size_t size = static_cast<size_t>(fileSize.QuadPart);
+#else
+			const int file = open(filename, O_RDONLY);
+			if (file < 0)
+			{
+				// a missing file is the usual import cache miss, not an error
+				CHECK(ENOENT == errno, nullptr);
+				return nullptr;
+			}
+			struct stat status;
+			const bool sized = 0 == fstat(file, &status) && status.st_size > 0;
+			void* view = sized ? mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0) : MAP_FAILED;
+			close(file);
+			CHECK(MAP_FAILED != view, nullptr);
+			char* base = static_cast<char*>(view);
+			const size_t size = static_cast<size_t>(status.st_size);
+#endif
+
+			// only the pages holding pointers are copied on write, the payload stays shared with the file cache
+			const Model* model = relocate_model_file(base, size, MODEL_FILE_STORAGE_MAPPED);
+			if (nullptr == model)
+			{
+				TRACE_WARN("%s is not a model file of this build", filename);
+#ifdef _WIN32
+				UnmapViewOfFile(base);
+#else
+				munmap(base, size);
+#endif
+				return nullptr;
+			}
+
+#ifdef _WIN32
+			DWORD protection;
+			VirtualProtect(base, size, PAGE_READONLY, &protection);
+#else
+			mprotect(base, size, PROT_READ);
+#endif
+			return model;
+		}
+
+#ifdef _WIN32
+		// a mapped file can not be deleted on Windows, release_model_file removes these once their view is gone
+		static std::mutex temporary_files_mutex;
+		static std::unordered_map<const ModelFileHeader*, std::string> temporary_files;
+#endif
+
+		const Model* model_map_temporary_file(const Model* instance)
+		{
+			CHECK(instance, nullptr);
+
+			std::error_code error;
+			const std::filesystem::path directory = std::filesystem::temp_directory_path(error);
+			CHECK(!error, nullptr);
+			static std::atomic<unsigned long long> counter(0);
+			char name[32];
+			snprintf(name, sizeof(name), "gmdl-%llu", counter++);
+			const std::string filename = model_file_temporary_path((directory / name).string().c_str());
+			if (!model_write_file(instance, filename.c_str()))
+			{
+				TRACE_WARN("Failed to write the temporary model file %s", filename.c_str());
+				return nullptr;
+			}
+
+			const Model* model = load_model_file(filename.c_str());
+#ifdef _WIN32
+			if (model)
+			{
+				std::lock_guard<std::mutex> lock(temporary_files_mutex);
+				temporary_files[model->file] = filename;
+				return model;
+			}
+#endif
+			std::filesystem::remove(filename, error); // the mapping keeps the pages alive
+			return model;
+		}
+
+		const Model* model_freeze(const Model* instance)
+		{
+			CHECK(instance, nullptr);
+
+			ModelFileWriter writer;
+			const std::vector<char>& data = writer.Write(instance);
+			char* base = static_cast<char*>(malloc(data.size())); // at least 16-byte aligned on 64-bit targets
+			CHECK(base, nullptr);
+			memcpy(base, data.data(), data.size());
+
+			const Model* model = relocate_model_file(base, data.size(), MODEL_FILE_STORAGE_HEAP);
+			if (nullptr == model) free(base);
+			return model;
+		}
+
+		bool model_is_frozen(const Model* instance)
+		{
+			return instance && instance->file;
+		}
+
+		void release_model_file(const ModelFileHeader* file)
+		{
+			CHECK(file, );
+
+			if (MODEL_FILE_STORAGE_HEAP == file->storage)
+			{
+				free(const_cast<ModelFileHeader*>(file));
+				return;
+			}
+#ifdef _WIN32
+			UnmapViewOfFile(file);
+
+			std::string temporary;
+			{
+				std::lock_guard<std::mutex> lock(temporary_files_mutex);
+				const auto found = temporary_files.find(file);
+				if (temporary_files.end() == found)
+				{
+					return;
+				}
+				temporary = found->second;
+				temporary_files.erase(found);
+			}
+			std::error_code error;
+			std::filesystem::remove(temporary, error);
+#else
+			munmap(const_cast<ModelFileHeader*>(file), static_cast<size_t>(file->size));
+#endif
+		}
+
+		void model_file_discard_pages(const ModelFileHeader* file, const void* data, const size_t size)
+		{
+			CHECK(file && MODEL_FILE_STORAGE_MAPPED == file->storage && data && size, );
+
+#ifdef _WIN32
+			SYSTEM_INFO system;
+			GetSystemInfo(&system);
+			const size_t pageSize = system.dwPageSize;
+#else
+			const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+			// partial pages may hold relocated pointers, which are private copies and must stay
+			const size_t begin = (reinterpret_cast<size_t>(data) + pageSize - 1) & ~(pageSize - 1);
+			const size_t end = (reinterpret_cast<size_t>(data) + size) & ~(pageSize - 1);
+			if (end <= begin)
+			{
+				return;
+			}
+#ifdef _WIN32
+			VirtualUnlock(reinterpret_cast<void*>(begin), end - begin); // unlocking pages that are not locked removes them from the working set
+#else
+			madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+#endif
+		}
+	}
+}
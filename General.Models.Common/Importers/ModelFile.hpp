@@ -0,0 +1,50 @@
+﻿#ifndef GENERAL_MODELS_MODEL_FILE_HPP
+#define GENERAL_MODELS_MODEL_FILE_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* A frozen model is one relocatable block holding the model and
+		* everything it references. Pointers are stored as offsets from
+		* the start of the block and listed in a relocation table, so
+		* loading maps the file and patches those slots only, vertices,
+		* indices and keyframes are never read until they are used.
+		* Frozen models are read-only, destroy_model releases them.
+		* ***************************************************************/
+
+#define MODEL_FILE_VERSION 4
+
+		enum ModelFileStorage
+		{
+			MODEL_FILE_STORAGE_NONE, // as written to disk
+			MODEL_FILE_STORAGE_MAPPED, // a copy-on-write view of the file, see load_model_file
+			MODEL_FILE_STORAGE_HEAP, // see model_freeze
+		};
+
+		struct ModelFileHeader
+		{
+			char magic[4]; // "GMDL"
+			unsigned int version; // MODEL_FILE_VERSION
+			unsigned int layout; // hash of the sizes of every frozen structure, files of other builds are rejected
+			unsigned int storage; // ModelFileStorage
+			unsigned long long size; // of the whole block, header included
+			unsigned long long relocationOffset; // offsets of the pointer slots to patch, always at the end of the block
+			unsigned long long relocationCount;
+		};
+
+		EXPORT bool model_write_file(const Model* instance, const char* filename);
+		EXPORT const Model* load_model_file(const char* filename); // nullptr if the file is missing, broken or written by another version or build
+		EXPORT const Model* model_freeze(const Model* instance); // copies the model into one block of the file layout, the source stays untouched
+		EXPORT bool model_is_frozen(const Model* instance);
+
+		/// <summary>writes the model to a private temporary file and maps it like load_model_file, the file is gone once the model is destroyed</summary>
+		/// <returns>nullptr if the file can not be written</returns>
+		const Model* model_map_temporary_file(const Model* instance);
+		void release_model_file(const ModelFileHeader* file); // destroy_model of a frozen model
+		void model_file_discard_pages(const ModelFileHeader* file, const void* data, const size_t size); // drops the whole pages of a mapped range, they are read from the file again on the next access
+	}
+}
+
+#endif // GENERAL_MODELS_MODEL_FILE_HPP
@@ -0,0 +1,311 @@
+﻿#include "pch.h"
+#include "Payload.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+		struct PayloadSource
+		{
+			Importer* importer; // re-parses the source, its params are those of the lazy import
+			std::vector<bool> residentMeshes;
+			std::vector<bool> residentAnimations;
+		};
+
+		static void release_mesh_payload(Mesh* mesh)
+		{
+			if (mesh->vertices) models_free(mesh->vertices);
+			if (mesh->positions) models_free(mesh->positions);
+			if (mesh->normals) models_free(mesh->normals);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (mesh->uvs[i]) models_free(mesh->uvs[i]);
+				mesh->uvs[i] = nullptr;
+			}
+			if (mesh->triangles) models_free(mesh->triangles);
+			if (mesh->shortTriangles) models_free(mesh->shortTriangles);
+			mesh->vertices = nullptr;
+			mesh->positions = nullptr;
+			mesh->normals = nullptr;
+			mesh->triangles = nullptr;
+			mesh->shortTriangles = nullptr;
+
+			// counts stay, so the metadata still describes the released data
+			for (int i = 0; i < mesh->weightCollectionCount; ++i)
+			{
+				WeightCollection* collection = mesh->weightCollections[i];
+				if (collection->weights) models_free(collection->weights);
+				collection->weights = nullptr;
+			}
+			for (int i = 0; i < mesh->lodCount; ++i)
+			{
+				if (mesh->lods[i].triangles) models_free(mesh->lods[i].triangles);
+				mesh->lods[i].triangles = nullptr;
+			}
+			if (mesh->skin) destroy_skin_table(mesh->skin);
+			if (mesh->meshlets) destroy_meshlet_table(mesh->meshlets);
+			mesh->skin = nullptr;
+			mesh->weightsStale = false; // the weights are released too, re-parsing restores both
+			mesh->meshlets = nullptr;
+		}
+
+		static void release_animation_payload(Animation* animation)
+		{
+			for (int i = 0; i < animation->curve->nodeCount; ++i)
+			{
+				AnimationCurveNode* node = const_cast<AnimationCurveNode*>(animation->curve->nodes[i]);
+				if (node->frames) models_free(const_cast<AnimationCurveFrame*>(node->frames));
+				const_cast<const AnimationCurveFrame*&>(node->frames) = nullptr;
+			}
+		}
+
+		// a changed source is an expected outcome, reparse_payloads warns once for the whole model
+		static bool mesh_payload_matches(const Mesh* mesh, const Mesh* parsed)
+		{
+			if (mesh->vertexCount != parsed->vertexCount || mesh->triangleCount != parsed->triangleCount || mesh->indexFormat != parsed->indexFormat || mesh->streamFlags != parsed->streamFlags)
+			{
+				return false;
+			}
+			if (mesh->weightCollectionCount != parsed->weightCollectionCount || mesh->lodCount != parsed->lodCount)
+			{
+				return false;
+			}
+			for (int i = 0; i < mesh->weightCollectionCount; ++i)
+			{
+				if (mesh->weightCollections[i]->weightCount != parsed->weightCollections[i]->weightCount) return false;
+			}
+			for (int i = 0; i < mesh->lodCount; ++i)
+			{
+				if (mesh->lods[i].triangleCount != parsed->lods[i].triangleCount) return false;
+			}
+			return true;
+		}
+
+		static bool animation_payload_matches(const Animation* animation, const Animation* parsed)
+		{
+			if (animation->curve->nodeCount != parsed->curve->nodeCount)
+			{
+				return false;
+			}
+			for (int i = 0; i < animation->curve->nodeCount; ++i)
+			{
+				if (animation->curve->nodes[i]->frameCount != parsed->curve->nodes[i]->frameCount) return false;
+			}
+			return true;
+		}
+
+		// both models allocate separately, so the arrays change owners by swapping pointers
+		static void swap_mesh_payload(Mesh* mesh, Mesh* parsed)
+		{
+			std::swap(mesh->vertices, parsed->vertices);
+			std::swap(mesh->positions, parsed->positions);
+			std::swap(mesh->normals, parsed->normals);
+			for (int i = 0; i < 4; ++i)
+			{
+				std::swap(mesh->uvs[i], parsed->uvs[i]);
+			}
+			std::swap(mesh->triangles, parsed->triangles);
+			std::swap(mesh->shortTriangles, parsed->shortTriangles);
+			for (int i = 0; i < mesh->weightCollectionCount; ++i)
+			{
+				std::swap(mesh->weightCollections[i]->weights, parsed->weightCollections[i]->weights);
+			}
+			for (int i = 0; i < mesh->lodCount; ++i)
+			{
+				std::swap(mesh->lods[i].triangles, parsed->lods[i].triangles);
+			}
+			std::swap(mesh->skin, parsed->skin);
+			std::swap(mesh->meshlets, parsed->meshlets);
+		}
+
+		static void swap_animation_payload(Animation* animation, Animation* parsed)
+		{
+			for (int i = 0; i < animation->curve->nodeCount; ++i)
+			{
+				AnimationCurveNode* node = const_cast<AnimationCurveNode*>(animation->curve->nodes[i]);
+				AnimationCurveNode* parsedNode = const_cast<AnimationCurveNode*>(parsed->curve->nodes[i]);
+				std::swap(const_cast<const AnimationCurveFrame*&>(node->frames), const_cast<const AnimationCurveFrame*&>(parsedNode->frames));
+			}
+		}
+
+		// the whole source is read anyway, so every released payload is decoded at once
+		static bool reparse_payloads(Model* instance, PayloadSource* source)
+		{
+			ImportParams params = source->importer->GetParams();
+			params.lazyPayloads = false;
+			params.cacheDirectory = nullptr;
+			params.arenaBlockSize = 0;
+			Importer* importer = source->importer->createImporter(params);
+			const Model* parsed = importer->Import();
+			delete importer;
+			if (nullptr == parsed)
+			{
+				TRACE_WARN("Failed to re-parse %s for lazy payloads", source->importer->GetFilename().c_str());
+				return false;
+			}
+
+			bool matches = parsed->meshCount == instance->meshCount && parsed->animationCount == instance->animationCount;
+			for (int i = 0; matches && i < instance->meshCount; ++i)
+			{
+				matches = source->residentMeshes[i] || mesh_payload_matches(instance->meshes[i], parsed->meshes[i]);
+			}
+			for (int i = 0; matches && i < instance->animationCount; ++i)
+			{
+				matches = source->residentAnimations[i] || animation_payload_matches(instance->animations[i], parsed->animations[i]);
+			}
+			if (matches)
+			{
+				for (int i = 0; i < instance->meshCount; ++i)
+				{
+					if (!source->residentMeshes[i])
+					{
+						swap_mesh_payload(instance->meshes[i], parsed->meshes[i]);
+						source->residentMeshes[i] = true;
+					}
+				}
+				for (int i = 0; i < instance->animationCount; ++i)
+				{
+					if (!source->residentAnimations[i])
+					{
+						swap_animation_payload(instance->animations[i], parsed->animations[i]);
+						source->residentAnimations[i] = true;
+					}
+				}
+			}
+			else
+			{
+				TRACE_WARN("%s changed since it was imported, lazy payloads are not decoded", source->importer->GetFilename().c_str());
+			}
+			destroy_model(const_cast<Model*>(parsed));
+			return matches;
+		}
+
+		const Mesh* model_acquire_mesh(const Model* instance, const int index)
+		{
+			CHECK(instance && index >= 0 && index < instance->meshCount, nullptr);
+
+			PayloadSource* source = instance->payloads;
+			if (source && !source->residentMeshes[index] && !reparse_payloads(const_cast<Model*>(instance), source))
+			{
+				return nullptr;
+			}
+			return instance->meshes[index];
+		}
+
+		const Animation* model_acquire_animation(const Model* instance, const int index)
+		{
+			CHECK(instance && index >= 0 && index < instance->animationCount, nullptr);
+
+			PayloadSource* source = instance->payloads;
+			if (source && !source->residentAnimations[index] && !reparse_payloads(const_cast<Model*>(instance), source))
+			{
+				return nullptr;
+			}
+			return instance->animations[index];
+		}
+
+		static void discard_mesh_pages(const ModelFileHeader* file, const Mesh* mesh)
+		{
+			model_file_discard_pages(file, mesh->vertices, sizeof(Vertex) * mesh->vertexCount);
+			model_file_discard_pages(file, mesh->positions, sizeof(Vector3) * mesh->vertexCount);
+			model_file_discard_pages(file, mesh->normals, sizeof(Vector3) * mesh->vertexCount);
+			for (int i = 0; i < 4; ++i)
+			{
+				model_file_discard_pages(file, mesh->uvs[i], sizeof(Vector2) * mesh->vertexCount);
+			}
+			model_file_discard_pages(file, mesh->triangles, sizeof(Triangle) * mesh->triangleCount);
+			model_file_discard_pages(file, mesh->shortTriangles, sizeof(ShortTriangle) * mesh->triangleCount);
+			for (int i = 0; i < mesh->weightCollectionCount; ++i)
+			{
+				const WeightCollection* collection = mesh->weightCollections[i];
+				model_file_discard_pages(file, collection->weights, sizeof(WeightData) * collection->weightCount);
+			}
+			for (int i = 0; i < mesh->lodCount; ++i)
+			{
+				model_file_discard_pages(file, mesh->lods[i].triangles, sizeof(Triangle) * mesh->lods[i].triangleCount);
+			}
+			if (mesh->skin)
+			{
+				model_file_discard_pages(file, mesh->skin->offsets, sizeof(int) * (mesh->skin->vertexCount + 1llu));
+				model_file_discard_pages(file, mesh->skin->influences, sizeof(SkinInfluence) * mesh->skin->influenceCount);
+			}
+			if (mesh->meshlets)
+			{
+				model_file_discard_pages(file, mesh->meshlets->meshlets, sizeof(Meshlet) * mesh->meshlets->meshletCount);
+				model_file_discard_pages(file, mesh->meshlets->vertices, sizeof(int) * mesh->meshlets->vertexCount);
+				model_file_discard_pages(file, mesh->meshlets->triangles, 3llu * mesh->meshlets->triangleCount);
+			}
+		}
+
+		void model_release_payload(const Model* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->file)
+			{
+				// the payload of a mapped model is the file itself, its pages are dropped and faulted back in
+				for (int i = 0; i < instance->meshCount; ++i)
+				{
+					discard_mesh_pages(instance->file, instance->meshes[i]);
+				}
+				for (int i = 0; i < instance->animationCount; ++i)
+				{
+					const AnimationCurve* curve = instance->animations[i]->curve;
+					for (int j = 0; j < curve->nodeCount; ++j)
+					{
+						model_file_discard_pages(instance->file, curve->nodes[j]->frames, sizeof(AnimationCurveFrame) * curve->nodes[j]->frameCount);
+					}
+				}
+				return;
+			}
+
+			PayloadSource* source = instance->payloads;
+			CHECK(source, );
+
+			Model* model = const_cast<Model*>(instance);
+			Model* previous = model_bind(model);
+			for (int i = 0; i < model->meshCount; ++i)
+			{
+				if (source->residentMeshes[i])
+				{
+					release_mesh_payload(model->meshes[i]);
+					source->residentMeshes[i] = false;
+				}
+			}
+			for (int i = 0; i < model->animationCount; ++i)
+			{
+				if (source->residentAnimations[i])
+				{
+					release_animation_payload(model->animations[i]);
+					source->residentAnimations[i] = false;
+				}
+			}
+			model_bind(previous);
+		}
+
+		bool model_is_lazy(const Model* instance)
+		{
+			return instance && (instance->payloads || (instance->file && MODEL_FILE_STORAGE_MAPPED == instance->file->storage));
+		}
+
+		void model_attach_payload_source(Model* instance, Importer* importer)
+		{
+			CHECK(instance && importer && !instance->arena && !instance->file && !instance->payloads, );
+
+			PayloadSource* source = new PayloadSource();
+			source->importer = importer;
+			source->residentMeshes.assign(instance->meshCount, true);
+			source->residentAnimations.assign(instance->animationCount, true);
+			instance->payloads = source;
+			model_release_payload(instance);
+		}
+
+		void release_payload_source(PayloadSource* source)
+		{
+			CHECK(source, );
+
+			delete source->importer;
+			delete source;
+		}
+	}
+}
@@ -0,0 +1,41 @@
+﻿#ifndef GENERAL_MODELS_PAYLOAD_HPP
+#define GENERAL_MODELS_PAYLOAD_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* A lazy model keeps the hierarchy, names, materials, counts,
+		* submeshes and bounds resident, vertices, indices, weights,
+		* skins, lods, meshlets and keyframes are payloads decoded on
+		* the first acquire. Models mapped from a native file decode by
+		* paging the file in, heap models re-parse their source, which
+		* lazy imports only fall back to when no file can be written.
+		* Acquire and release from the thread owning the model only.
+		* ***************************************************************/
+
+		class Importer;
+		struct PayloadSource;
+
+		/// <summary>the mesh with its payload decoded, nullptr if the source is gone or no longer matches the model</summary>
+		EXPORT const Mesh* model_acquire_mesh(const Model* instance, const int index);
+		/// <summary>the animation with its keyframes decoded, nullptr if the source is gone or no longer matches the model</summary>
+		EXPORT const Animation* model_acquire_animation(const Model* instance, const int index);
+		/// <summary>evicts every decoded payload, pointers into them are invalid until the next acquire</summary>
+		EXPORT void model_release_payload(const Model* instance);
+		/// <summary>
+		/// true if the payloads are decoded on demand. Released payloads of a heap model are nullptr while their counts stay,
+		/// so only the acquire functions may read them, other model functions such as model_write_file or model_update_bounds
+		/// must not be called on a lazy heap model
+		/// </summary>
+		EXPORT bool model_is_lazy(const Model* instance);
+
+		/// <summary>releases every payload of a heap model and keeps the importer to re-parse them on demand</summary>
+		/// <param name="importer">takes ownership, see Importer::createImporter</param>
+		void model_attach_payload_source(Model* instance, Importer* importer);
+		void release_payload_source(PayloadSource* source); // destroy_model of a lazy model
+	}
+}
+
+#endif // GENERAL_MODELS_PAYLOAD_HPP
@@ -0,0 +1,579 @@
+﻿#ifndef GENERAL_MODELS_COMMON_MATH_KERNELS_HPP
+#define GENERAL_MODELS_COMMON_MATH_KERNELS_HPP
+
+// internal to the math module, every Kernels*.cpp instantiates the templates below with its own lanes
+// nothing here calls library code, inline library functions compiled for AVX could be shared with callers built without it
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define MATH_X86
+#endif
+
+#ifdef MATH_X86
+#include <emmintrin.h>
+#else
+#include <math.h>
+#endif
+
+namespace General
+{
+	namespace Models
+	{
+		struct MathKernels
+		{
+			void (*multiplyMatrices)(const Matrix* a, const Matrix* b, Matrix* results, const int count);
+			void (*invertMatrices)(const Matrix* matrices, Matrix* results, const int count);
+			void (*composeMatrices)(const Vector3* translations, const Vector4* rotations, const Vector3* scalings, Matrix* results, const int count);
+			void (*decomposeMatrices)(const Matrix* matrices, Vector3* translations, Vector4* rotations, Vector3* scalings, const int count);
+			void (*normalizeQuaternions)(const Vector4* quaternions, Vector4* results, const int count);
+			void (*nlerpQuaternions)(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count);
+			void (*slerpQuaternions)(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count);
+			void (*eulerToQuaternions)(const Vector3* degrees, Vector4* results, const int count);
+			void (*quaternionsToEuler)(const Vector4* quaternions, Vector3* degrees, const int count);
+			void (*transformPoints)(const Matrix* matrix, const Vector3* points, Vector3* results, const int count);
+			void (*transformDirections)(const Matrix* matrix, const Vector3* directions, Vector3* results, const int count);
+			void (*boundPoints)(const Vector3* points, const int stride, const int count, Vector3* minimum, Vector3* maximum);
+			float (*maxDistance)(const Vector3* points, const int stride, const int count, const Vector3* center);
+		};
+
+		extern const MathKernels math_kernels_scalar;
+#ifdef MATH_X86
+		extern const MathKernels math_kernels_sse2;
+		extern const MathKernels math_kernels_avx2;
+		extern const MathKernels math_kernels_avx512;
+#endif
+
+#define MATH_PI 3.14159265358979323846f
+
+		// every Kernels*.cpp is compiled for another instruction set, internal linkage keeps their instantiations apart
+		namespace
+		{
+			/****************************************************************
+			* Lanes types wrap one register of floats: V holds width floats,
+			* M a per lane mask. gather and scatter step through arrays of
+			* structures, so the kernels below work on one item per lane.
+			* ***************************************************************/
+
+			union FloatBits
+			{
+				float value;
+				unsigned int bits;
+			};
+
+			static inline float float_from_bits(const unsigned int bits)
+			{
+				FloatBits f;
+				f.bits = bits;
+				return f.value;
+			}
+
+			static inline unsigned int float_bits(const float value)
+			{
+				FloatBits f;
+				f.value = value;
+				return f.bits;
+			}
+
+			struct ScalarLanes
+			{
+				typedef float V;
+				typedef bool M;
+				static const int width = 1;
+
+				static inline V gather(const float* p, const int) { return *p; }
+				static inline void scatter(float* p, const int, const V v) { *p = v; }
+				static inline V set(const float v) { return v; }
+				static inline V add(const V a, const V b) { return a + b; }
+				static inline V sub(const V a, const V b) { return a - b; }
+				static inline V mul(const V a, const V b) { return a * b; }
+				static inline V div(const V a, const V b) { return a / b; }
+				static inline V madd(const V a, const V b, const V c) { return a * b + c; }
+#ifdef MATH_X86
+				static inline V sqrt(const V v) { return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(v))); }
+#else
+				static inline V sqrt(const V v) { return sqrtf(v); }
+#endif
+				static inline V min(const V a, const V b) { return a < b ? a : b; }
+				static inline V max(const V a, const V b) { return a > b ? a : b; }
+				static inline V abs(const V v) { return float_from_bits(float_bits(v) & 0x7fffffffu); }
+				static inline V round(const V v)
+				{
+					const float r = v + .5f;
+					if (!(abs(r) < 8388608.0f)) return r; // already integral, or nan
+					const float t = static_cast<float>(static_cast<int>(r));
+					return t > r ? t - 1.0f : t; // floor
+				}
+				static inline V copysign(const V magnitude, const V sign) { return float_from_bits((float_bits(magnitude) & 0x7fffffffu) | (float_bits(sign) & 0x80000000u)); }
+				static inline M less(const V a, const V b) { return a < b; }
+				static inline M equal(const V a, const V b) { return a == b; }
+				static inline M both(const M a, const M b) { return a && b; }
+				static inline V select(const M mask, const V a, const V b) { return mask ? a : b; }
+			};
+
+			template <typename F> struct Lanes3 { typename F::V x, y, z; };
+			template <typename F> struct Lanes4 { typename F::V x, y, z, w; };
+
+			template <typename F> static inline Lanes3<F> gather3(const Vector3* p)
+			{
+				const float* v = p->values;
+				return { F::gather(v, 3), F::gather(v + 1, 3), F::gather(v + 2, 3) };
+			}
+
+			template <typename F> static inline void scatter3(Vector3* p, const Lanes3<F>& v)
+			{
+				float* r = p->values;
+				F::scatter(r, 3, v.x); F::scatter(r + 1, 3, v.y); F::scatter(r + 2, 3, v.z);
+			}
+
+			template <typename F> static inline Lanes4<F> gather4(const Vector4* p)
+			{
+				const float* v = p->values;
+				return { F::gather(v, 4), F::gather(v + 1, 4), F::gather(v + 2, 4), F::gather(v + 3, 4) };
+			}
+
+			template <typename F> static inline void scatter4(Vector4* p, const Lanes4<F>& v)
+			{
+				float* r = p->values;
+				F::scatter(r, 4, v.x); F::scatter(r + 1, 4, v.y); F::scatter(r + 2, 4, v.z); F::scatter(r + 3, 4, v.w);
+			}
+
+			template <typename F> static inline void gather16(const Matrix* p, typename F::V m[16])
+			{
+				for (int k = 0; k < 16; ++k) m[k] = F::gather(p->values + k, 16);
+			}
+
+			template <typename F> static inline void scatter16(Matrix* p, const typename F::V m[16])
+			{
+				for (int k = 0; k < 16; ++k) F::scatter(p->values + k, 16, m[k]);
+			}
+
+			/// <summary>runs body over full registers, and the remaining items one by one with the scalar lanes</summary>
+			template <typename F, typename Body> static inline void for_lanes(const int count, Body body)
+			{
+				int i = 0;
+				for (; i + F::width <= count; i += F::width) body.template run<F>(i);
+				for (; i < count; ++i) body.template run<ScalarLanes>(i);
+			}
+
+			/// <summary>radians reduced to [-pi/4, pi/4] and evaluated with the cephes polynomials</summary>
+			template <typename F> static inline void lanes_sincos(const typename F::V radians, typename F::V& sine, typename F::V& cosine)
+			{
+				typedef typename F::V V;
+
+				const V j = F::round(F::mul(radians, F::set(0.636619772367581343f))); // x / (pi / 2)
+				V r = F::sub(radians, F::mul(j, F::set(1.5703125f)));
+				r = F::sub(r, F::mul(j, F::set(4.837512969970703125e-4f)));
+				r = F::sub(r, F::mul(j, F::set(7.54978995489188216e-8f)));
+
+				const V r2 = F::mul(r, r);
+				V s = F::madd(r2, F::set(-1.9515295891e-4f), F::set(8.3321608736e-3f));
+				s = F::madd(s, r2, F::set(-1.6666654611e-1f));
+				s = F::madd(F::mul(s, r2), r, r);
+				V c = F::madd(r2, F::set(2.443315711809948e-5f), F::set(-1.388731625493765e-3f));
+				c = F::madd(c, r2, F::set(4.166664568298827e-2f));
+				c = F::madd(F::mul(c, r2), r2, F::sub(F::set(1.0f), F::mul(r2, F::set(.5f))));
+
+				// quadrant q = j mod 4, floor(a / n) of an integer a is round(a / n - (n - 1) / 2n)
+				const V q = F::sub(j, F::mul(F::round(F::sub(F::mul(j, F::set(.25f)), F::set(.375f))), F::set(4.0f)));
+				const typename F::M odd = F::equal(F::sub(q, F::mul(F::round(F::sub(F::mul(q, F::set(.5f)), F::set(.25f))), F::set(2.0f))), F::set(1.0f));
+				const V sineSign = F::select(F::less(F::set(1.5f), q), F::set(-1.0f), F::set(1.0f));
+				const V cosineSign = F::select(F::both(F::less(F::set(.5f), q), F::less(q, F::set(2.5f))), F::set(-1.0f), F::set(1.0f));
+				sine = F::mul(F::select(odd, c, s), sineSign);
+				cosine = F::mul(F::select(odd, s, c), cosineSign);
+			}
+
+			/// <summary>cephes atanf</summary>
+			template <typename F> static inline typename F::V lanes_atan(const typename F::V value)
+			{
+				typedef typename F::V V;
+
+				const V x = F::abs(value);
+				const typename F::M big = F::less(F::set(2.414213562373095f), x);
+				const typename F::M middle = F::less(F::set(.4142135623730950f), x);
+				const V offset = F::select(big, F::set(MATH_PI * .5f), F::select(middle, F::set(MATH_PI * .25f), F::set(.0f)));
+				const V reduced = F::select(big, F::div(F::set(-1.0f), x), F::select(middle, F::div(F::sub(x, F::set(1.0f)), F::add(x, F::set(1.0f))), x));
+				const V z = F::mul(reduced, reduced);
+				V p = F::madd(z, F::set(8.05374449538e-2f), F::set(-1.38776856032e-1f));
+				p = F::madd(p, z, F::set(1.99777106478e-1f));
+				p = F::madd(p, z, F::set(-3.33329491539e-1f));
+				p = F::madd(F::mul(p, z), reduced, reduced);
+				return F::copysign(F::add(offset, p), value);
+			}
+
+			template <typename F> static inline typename F::V lanes_atan2(const typename F::V y, const typename F::V x)
+			{
+				typedef typename F::V V;
+
+				const V zero = F::set(.0f);
+				const V a = lanes_atan<F>(F::div(y, x));
+				const V corrected = F::select(F::less(x, zero), F::add(a, F::copysign(F::set(MATH_PI), y)), a);
+				return F::select(F::equal(x, zero), F::select(F::equal(y, zero), zero, F::copysign(F::set(MATH_PI * .5f), y)), corrected);
+			}
+
+			template <typename F> static inline typename F::V lanes_dot4(const Lanes4<F>& a, const Lanes4<F>& b)
+			{
+				return F::madd(a.x, b.x, F::madd(a.y, b.y, F::madd(a.z, b.z, F::mul(a.w, b.w))));
+			}
+
+			template <typename F> static inline Lanes4<F> lanes_normalize4(const Lanes4<F>& q)
+			{
+				typedef typename F::V V;
+
+				const V length = F::sqrt(lanes_dot4<F>(q, q));
+				const typename F::M zero = F::equal(length, F::set(.0f));
+				const V inverse = F::div(F::set(1.0f), F::select(zero, F::set(1.0f), length));
+				return { F::select(zero, F::set(.0f), F::mul(q.x, inverse)), F::select(zero, F::set(.0f), F::mul(q.y, inverse)),
+					F::select(zero, F::set(.0f), F::mul(q.z, inverse)), F::select(zero, F::set(1.0f), F::mul(q.w, inverse)) };
+			}
+
+			/// <summary>weights of a and b for every lane blended into a normalized quaternion, b is negated if it is on the other hemisphere</summary>
+			template <typename F> static inline Lanes4<F> lanes_blend4(const Lanes4<F>& a, const Lanes4<F>& b, const typename F::V wa, const typename F::V wb)
+			{
+				return lanes_normalize4<F>({ F::madd(a.x, wa, F::mul(b.x, wb)), F::madd(a.y, wa, F::mul(b.y, wb)), F::madd(a.z, wa, F::mul(b.z, wb)), F::madd(a.w, wa, F::mul(b.w, wb)) });
+			}
+
+			template <typename F> static inline void lanes_compose(const Lanes3<F>& t, const Lanes4<F>& q, const Lanes3<F>& s, typename F::V m[16])
+			{
+				typedef typename F::V V;
+
+				const V two = F::set(2.0f), one = F::set(1.0f), zero = F::set(.0f);
+				const V x2 = F::mul(q.x, two), y2 = F::mul(q.y, two), z2 = F::mul(q.z, two);
+				const V xx = F::mul(q.x, x2), yy = F::mul(q.y, y2), zz = F::mul(q.z, z2);
+				const V xy = F::mul(q.x, y2), xz = F::mul(q.x, z2), yz = F::mul(q.y, z2);
+				const V wx = F::mul(q.w, x2), wy = F::mul(q.w, y2), wz = F::mul(q.w, z2);
+				m[0] = F::mul(F::sub(one, F::add(yy, zz)), s.x); m[1] = F::mul(F::add(xy, wz), s.x); m[2] = F::mul(F::sub(xz, wy), s.x); m[3] = zero;
+				m[4] = F::mul(F::sub(xy, wz), s.y); m[5] = F::mul(F::sub(one, F::add(xx, zz)), s.y); m[6] = F::mul(F::add(yz, wx), s.y); m[7] = zero;
+				m[8] = F::mul(F::add(xz, wy), s.z); m[9] = F::mul(F::sub(yz, wx), s.z); m[10] = F::mul(F::sub(one, F::add(xx, yy)), s.z); m[11] = zero;
+				m[12] = t.x; m[13] = t.y; m[14] = t.z; m[15] = one;
+			}
+
+			struct MultiplyMatricesBody
+			{
+				const Matrix* a; const Matrix* b; Matrix* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typename F::V x[16], y[16], r[16];
+					gather16<F>(a + i, x);
+					gather16<F>(b + i, y);
+					for (int row = 0; row < 4; ++row)
+					{
+						for (int column = 0; column < 4; ++column)
+						{
+							const int k = row * 4;
+							r[k + column] = F::madd(x[k], y[column], F::madd(x[k + 1], y[4 + column], F::madd(x[k + 2], y[8 + column], F::mul(x[k + 3], y[12 + column]))));
+						}
+					}
+					scatter16<F>(results + i, r);
+				}
+			};
+
+			struct InvertMatricesBody
+			{
+				const Matrix* matrices; Matrix* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					V m[16], r[16];
+					gather16<F>(matrices + i, m);
+					const V s0 = F::sub(F::mul(m[0], m[5]), F::mul(m[4], m[1]));
+					const V s1 = F::sub(F::mul(m[0], m[6]), F::mul(m[4], m[2]));
+					const V s2 = F::sub(F::mul(m[0], m[7]), F::mul(m[4], m[3]));
+					const V s3 = F::sub(F::mul(m[1], m[6]), F::mul(m[5], m[2]));
+					const V s4 = F::sub(F::mul(m[1], m[7]), F::mul(m[5], m[3]));
+					const V s5 = F::sub(F::mul(m[2], m[7]), F::mul(m[6], m[3]));
+					const V c5 = F::sub(F::mul(m[10], m[15]), F::mul(m[14], m[11]));
+					const V c4 = F::sub(F::mul(m[9], m[15]), F::mul(m[13], m[11]));
+					const V c3 = F::sub(F::mul(m[9], m[14]), F::mul(m[13], m[10]));
+					const V c2 = F::sub(F::mul(m[8], m[15]), F::mul(m[12], m[11]));
+					const V c1 = F::sub(F::mul(m[8], m[14]), F::mul(m[12], m[10]));
+					const V c0 = F::sub(F::mul(m[8], m[13]), F::mul(m[12], m[9]));
+					const V determinant = F::add(F::add(F::sub(F::mul(s0, c5), F::mul(s1, c4)), F::add(F::mul(s2, c3), F::mul(s3, c2))), F::sub(F::mul(s5, c0), F::mul(s4, c1)));
+					const typename F::M singular = F::equal(determinant, F::set(.0f));
+					const V inverse = F::select(singular, F::set(.0f), F::div(F::set(1.0f), F::select(singular, F::set(1.0f), determinant)));
+
+					r[0] = F::add(F::sub(F::mul(m[5], c5), F::mul(m[6], c4)), F::mul(m[7], c3));
+					r[1] = F::sub(F::sub(F::mul(m[2], c4), F::mul(m[1], c5)), F::mul(m[3], c3));
+					r[2] = F::add(F::sub(F::mul(m[13], s5), F::mul(m[14], s4)), F::mul(m[15], s3));
+					r[3] = F::sub(F::sub(F::mul(m[10], s4), F::mul(m[9], s5)), F::mul(m[11], s3));
+					r[4] = F::sub(F::sub(F::mul(m[6], c2), F::mul(m[4], c5)), F::mul(m[7], c1));
+					r[5] = F::add(F::sub(F::mul(m[0], c5), F::mul(m[2], c2)), F::mul(m[3], c1));
+					r[6] = F::sub(F::sub(F::mul(m[14], s2), F::mul(m[12], s5)), F::mul(m[15], s1));
+					r[7] = F::add(F::sub(F::mul(m[8], s5), F::mul(m[10], s2)), F::mul(m[11], s1));
+					r[8] = F::add(F::sub(F::mul(m[4], c4), F::mul(m[5], c2)), F::mul(m[7], c0));
+					r[9] = F::sub(F::sub(F::mul(m[1], c2), F::mul(m[0], c4)), F::mul(m[3], c0));
+					r[10] = F::add(F::sub(F::mul(m[12], s4), F::mul(m[13], s2)), F::mul(m[15], s0));
+					r[11] = F::sub(F::sub(F::mul(m[9], s2), F::mul(m[8], s4)), F::mul(m[11], s0));
+					r[12] = F::sub(F::sub(F::mul(m[5], c1), F::mul(m[4], c3)), F::mul(m[6], c0));
+					r[13] = F::add(F::sub(F::mul(m[0], c3), F::mul(m[1], c1)), F::mul(m[2], c0));
+					r[14] = F::sub(F::sub(F::mul(m[13], s1), F::mul(m[12], s3)), F::mul(m[14], s0));
+					r[15] = F::add(F::sub(F::mul(m[8], s3), F::mul(m[9], s1)), F::mul(m[10], s0));
+					for (int k = 0; k < 16; ++k) r[k] = F::mul(r[k], inverse);
+					scatter16<F>(results + i, r);
+				}
+			};
+
+			struct ComposeMatricesBody
+			{
+				const Vector3* translations; const Vector4* rotations; const Vector3* scalings; Matrix* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typename F::V m[16];
+					lanes_compose<F>(gather3<F>(translations + i), gather4<F>(rotations + i), gather3<F>(scalings + i), m);
+					scatter16<F>(results + i, m);
+				}
+			};
+
+			struct DecomposeMatricesBody
+			{
+				const Matrix* matrices; Vector3* translations; Vector4* rotations; Vector3* scalings;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					V m[16];
+					gather16<F>(matrices + i, m);
+					const V zero = F::set(.0f), one = F::set(1.0f), half = F::set(.5f);
+					V sx = F::sqrt(F::madd(m[0], m[0], F::madd(m[1], m[1], F::mul(m[2], m[2]))));
+					const V sy = F::sqrt(F::madd(m[4], m[4], F::madd(m[5], m[5], F::mul(m[6], m[6]))));
+					const V sz = F::sqrt(F::madd(m[8], m[8], F::madd(m[9], m[9], F::mul(m[10], m[10]))));
+					const V determinant = F::add(F::add(F::mul(m[0], F::sub(F::mul(m[5], m[10]), F::mul(m[6], m[9]))),
+						F::mul(m[1], F::sub(F::mul(m[6], m[8]), F::mul(m[4], m[10])))), F::mul(m[2], F::sub(F::mul(m[4], m[9]), F::mul(m[5], m[8]))));
+					sx = F::select(F::less(determinant, zero), F::sub(zero, sx), sx); // a mirrored matrix gets a negative x scaling
+
+					const V ix = F::select(F::equal(sx, zero), zero, F::div(one, F::select(F::equal(sx, zero), one, sx)));
+					const V iy = F::select(F::equal(sy, zero), zero, F::div(one, F::select(F::equal(sy, zero), one, sy)));
+					const V iz = F::select(F::equal(sz, zero), zero, F::div(one, F::select(F::equal(sz, zero), one, sz)));
+					const V r00 = F::mul(m[0], ix), r01 = F::mul(m[1], ix), r02 = F::mul(m[2], ix);
+					const V r10 = F::mul(m[4], iy), r11 = F::mul(m[5], iy), r12 = F::mul(m[6], iy);
+					const V r20 = F::mul(m[8], iz), r21 = F::mul(m[9], iz), r22 = F::mul(m[10], iz);
+
+					// the diagonal gives the magnitudes, the antisymmetric part the signs relative to w
+					Lanes4<F> q;
+					q.w = F::mul(half, F::sqrt(F::max(zero, F::add(F::add(one, r00), F::add(r11, r22)))));
+					q.x = F::copysign(F::mul(half, F::sqrt(F::max(zero, F::sub(F::add(one, r00), F::add(r11, r22))))), F::sub(r12, r21));
+					q.y = F::copysign(F::mul(half, F::sqrt(F::max(zero, F::sub(F::add(one, r11), F::add(r00, r22))))), F::sub(r20, r02));
+					q.z = F::copysign(F::mul(half, F::sqrt(F::max(zero, F::sub(F::add(one, r22), F::add(r00, r11))))), F::sub(r01, r10));
+
+					scatter3<F>(translations + i, { m[12], m[13], m[14] });
+					scatter4<F>(rotations + i, lanes_normalize4<F>(q));
+					scatter3<F>(scalings + i, { sx, sy, sz });
+				}
+			};
+
+			struct NormalizeQuaternionsBody
+			{
+				const Vector4* quaternions; Vector4* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					scatter4<F>(results + i, lanes_normalize4<F>(gather4<F>(quaternions + i)));
+				}
+			};
+
+			struct NlerpQuaternionsBody
+			{
+				const Vector4* a; const Vector4* b; const float* t; Vector4* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					const Lanes4<F> qa = gather4<F>(a + i), qb = gather4<F>(b + i);
+					const V weight = F::gather(t + i, 1);
+					const V sign = F::select(F::less(lanes_dot4<F>(qa, qb), F::set(.0f)), F::set(-1.0f), F::set(1.0f));
+					scatter4<F>(results + i, lanes_blend4<F>(qa, qb, F::sub(F::set(1.0f), weight), F::mul(weight, sign)));
+				}
+			};
+
+			struct SlerpQuaternionsBody
+			{
+				const Vector4* a; const Vector4* b; const float* t; Vector4* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					const Lanes4<F> qa = gather4<F>(a + i), qb = gather4<F>(b + i);
+					const V weight = F::gather(t + i, 1);
+					const V one = F::set(1.0f);
+					const V dot = lanes_dot4<F>(qa, qb);
+					const V sign = F::select(F::less(dot, F::set(.0f)), F::set(-1.0f), one);
+					const V cosine = F::abs(dot);
+
+					// theta = acos(cosine) as atan2(sin, cos), close quaternions fall back to nlerp
+					const V sine = F::sqrt(F::max(F::set(.0f), F::sub(one, F::mul(cosine, cosine))));
+					const V theta = lanes_atan2<F>(sine, cosine);
+					const typename F::M close = F::less(F::set(.9995f), cosine);
+					V sa, ca, sb, cb;
+					lanes_sincos<F>(F::mul(F::sub(one, weight), theta), sa, ca);
+					lanes_sincos<F>(F::mul(weight, theta), sb, cb);
+					const V inverse = F::div(one, F::select(close, one, sine));
+					const V wa = F::select(close, F::sub(one, weight), F::mul(sa, inverse));
+					const V wb = F::select(close, weight, F::mul(sb, inverse));
+					scatter4<F>(results + i, lanes_blend4<F>(qa, qb, wa, F::mul(wb, sign)));
+				}
+			};
+
+			struct EulerToQuaternionsBody
+			{
+				const Vector3* degrees; Vector4* results;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					const Lanes3<F> e = gather3<F>(degrees + i);
+					const V halfRadians = F::set(MATH_PI / 360.0f);
+					V sx, cx, sy, cy, sz, cz;
+					lanes_sincos<F>(F::mul(e.x, halfRadians), sx, cx);
+					lanes_sincos<F>(F::mul(e.y, halfRadians), sy, cy);
+					lanes_sincos<F>(F::mul(e.z, halfRadians), sz, cz);
+					const V cycz = F::mul(cy, cz), sysz = F::mul(sy, sz), sycz = F::mul(sy, cz), cysz = F::mul(cy, sz);
+
+					Lanes4<F> q;
+					q.x = F::sub(F::mul(sx, cycz), F::mul(cx, sysz));
+					q.y = F::add(F::mul(cx, sycz), F::mul(sx, cysz));
+					q.z = F::sub(F::mul(cx, cysz), F::mul(sx, sycz));
+					q.w = F::add(F::mul(cx, cycz), F::mul(sx, sysz));
+					scatter4<F>(results + i, q);
+				}
+			};
+
+			struct QuaternionsToEulerBody
+			{
+				const Vector4* quaternions; Vector3* degrees;
+
+				template <typename F> inline void run(const int i) const
+				{
+					typedef typename F::V V;
+
+					const Lanes4<F> q = gather4<F>(quaternions + i);
+					const V one = F::set(1.0f), two = F::set(2.0f);
+					const V toDegrees = F::set(180.0f / MATH_PI);
+					V sy = F::mul(two, F::sub(F::mul(q.w, q.y), F::mul(q.x, q.z)));
+					sy = F::select(F::less(one, sy), one, F::select(F::less(sy, F::set(-1.0f)), F::set(-1.0f), sy));
+
+					Lanes3<F> e;
+					e.x = F::mul(lanes_atan2<F>(F::mul(two, F::madd(q.y, q.z, F::mul(q.w, q.x))), F::sub(one, F::mul(two, F::madd(q.x, q.x, F::mul(q.y, q.y))))), toDegrees);
+					e.y = F::mul(lanes_atan2<F>(sy, F::sqrt(F::max(F::set(.0f), F::sub(one, F::mul(sy, sy))))), toDegrees);
+					e.z = F::mul(lanes_atan2<F>(F::mul(two, F::madd(q.x, q.y, F::mul(q.w, q.z))), F::sub(one, F::mul(two, F::madd(q.y, q.y, F::mul(q.z, q.z))))), toDegrees);
+					scatter3<F>(degrees + i, e);
+				}
+			};
+
+			struct TransformVectorsBody
+			{
+				const Matrix* matrix; const Vector3* vectors; Vector3* results; bool translate;
+
+				template <typename F> inline void run(const int i) const
+				{
+					const float* m = matrix->values;
+					const Lanes3<F> v = gather3<F>(vectors + i);
+					Lanes3<F> r;
+					r.x = F::madd(v.x, F::set(m[0]), F::madd(v.y, F::set(m[4]), F::mul(v.z, F::set(m[8]))));
+					r.y = F::madd(v.x, F::set(m[1]), F::madd(v.y, F::set(m[5]), F::mul(v.z, F::set(m[9]))));
+					r.z = F::madd(v.x, F::set(m[2]), F::madd(v.y, F::set(m[6]), F::mul(v.z, F::set(m[10]))));
+					if (translate)
+					{
+						r.x = F::add(r.x, F::set(m[12]));
+						r.y = F::add(r.y, F::set(m[13]));
+						r.z = F::add(r.z, F::set(m[14]));
+					}
+					scatter3<F>(results + i, r);
+				}
+			};
+
+			/// <summary>reductions keep one accumulator per lane and fold the lanes at the end, stride is in floats</summary>
+			template <typename F> static void lanes_bound_points(const float* points, const int stride, const int begin, const int end, float minimum[3], float maximum[3])
+			{
+				typedef typename F::V V;
+
+				V low[3] = { F::set(minimum[0]), F::set(minimum[1]), F::set(minimum[2]) };
+				V high[3] = { F::set(maximum[0]), F::set(maximum[1]), F::set(maximum[2]) };
+				for (int i = begin; i < end; i += F::width)
+				{
+					const float* p = points + static_cast<size_t>(stride) * i;
+					for (int k = 0; k < 3; ++k)
+					{
+						const V v = F::gather(p + k, stride);
+						low[k] = F::min(low[k], v);
+						high[k] = F::max(high[k], v);
+					}
+				}
+
+				float lanes[F::width];
+				for (int k = 0; k < 3; ++k)
+				{
+					F::scatter(lanes, 1, low[k]);
+					for (int j = 0; j < F::width; ++j) minimum[k] = lanes[j] < minimum[k] ? lanes[j] : minimum[k];
+					F::scatter(lanes, 1, high[k]);
+					for (int j = 0; j < F::width; ++j) maximum[k] = lanes[j] > maximum[k] ? lanes[j] : maximum[k];
+				}
+			}
+
+			template <typename F> static float lanes_max_distance(const float* points, const int stride, const int begin, const int end, const float center[3], float result)
+			{
+				typedef typename F::V V;
+
+				const V cx = F::set(center[0]), cy = F::set(center[1]), cz = F::set(center[2]);
+				V farthest = F::set(result);
+				for (int i = begin; i < end; i += F::width)
+				{
+					const float* p = points + static_cast<size_t>(stride) * i;
+					const V dx = F::sub(F::gather(p, stride), cx), dy = F::sub(F::gather(p + 1, stride), cy), dz = F::sub(F::gather(p + 2, stride), cz);
+					farthest = F::max(farthest, F::madd(dx, dx, F::madd(dy, dy, F::mul(dz, dz))));
+				}
+
+				float lanes[F::width];
+				F::scatter(lanes, 1, farthest);
+				for (int j = 0; j < F::width; ++j) result = lanes[j] > result ? lanes[j] : result;
+				return result;
+			}
+
+			template <typename F> static void multiply_matrices(const Matrix* a, const Matrix* b, Matrix* results, const int count) { for_lanes<F>(count, MultiplyMatricesBody{ a, b, results }); }
+			template <typename F> static void invert_matrices(const Matrix* matrices, Matrix* results, const int count) { for_lanes<F>(count, InvertMatricesBody{ matrices, results }); }
+			template <typename F> static void compose_matrices(const Vector3* translations, const Vector4* rotations, const Vector3* scalings, Matrix* results, const int count) { for_lanes<F>(count, ComposeMatricesBody{ translations, rotations, scalings, results }); }
+			template <typename F> static void decompose_matrices(const Matrix* matrices, Vector3* translations, Vector4* rotations, Vector3* scalings, const int count) { for_lanes<F>(count, DecomposeMatricesBody{ matrices, translations, rotations, scalings }); }
+			template <typename F> static void normalize_quaternions(const Vector4* quaternions, Vector4* results, const int count) { for_lanes<F>(count, NormalizeQuaternionsBody{ quaternions, results }); }
+			template <typename F> static void nlerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count) { for_lanes<F>(count, NlerpQuaternionsBody{ a, b, t, results }); }
+			template <typename F> static void slerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count) { for_lanes<F>(count, SlerpQuaternionsBody{ a, b, t, results }); }
+			template <typename F> static void euler_to_quaternions(const Vector3* degrees, Vector4* results, const int count) { for_lanes<F>(count, EulerToQuaternionsBody{ degrees, results }); }
+			template <typename F> static void quaternions_to_euler(const Vector4* quaternions, Vector3* degrees, const int count) { for_lanes<F>(count, QuaternionsToEulerBody{ quaternions, degrees }); }
+			template <typename F> static void transform_points(const Matrix* matrix, const Vector3* points, Vector3* results, const int count) { for_lanes<F>(count, TransformVectorsBody{ matrix, points, results, true }); }
+			template <typename F> static void transform_directions(const Matrix* matrix, const Vector3* directions, Vector3* results, const int count) { for_lanes<F>(count, TransformVectorsBody{ matrix, directions, results, false }); }
+
+			template <typename F> static void bound_points(const Vector3* points, const int stride, const int count, Vector3* minimum, Vector3* maximum)
+			{
+				const int full = count - count % F::width;
+				const int step = stride / static_cast<int>(sizeof(float));
+				const float infinity = float_from_bits(0x7f800000u);
+				float low[3] = { infinity, infinity, infinity }, high[3] = { -infinity, -infinity, -infinity };
+				lanes_bound_points<F>(reinterpret_cast<const float*>(points), step, 0, full, low, high);
+				lanes_bound_points<ScalarLanes>(reinterpret_cast<const float*>(points), step, full, count, low, high);
+				*minimum = { low[0], low[1], low[2] };
+				*maximum = { high[0], high[1], high[2] };
+			}
+
+			template <typename F> static float max_distance(const Vector3* points, const int stride, const int count, const Vector3* center)
+			{
+				const int full = count - count % F::width;
+				const int step = stride / static_cast<int>(sizeof(float));
+				const float squared = lanes_max_distance<ScalarLanes>(reinterpret_cast<const float*>(points), step, full, count, center->values, lanes_max_distance<F>(reinterpret_cast<const float*>(points), step, 0, full, center->values, .0f));
+				return ScalarLanes::sqrt(squared);
+			}
+		}
+
+#define MATH_KERNELS(Lanes) { \
+			multiply_matrices<Lanes>, invert_matrices<Lanes>, compose_matrices<Lanes>, decompose_matrices<Lanes>, \
+			normalize_quaternions<Lanes>, nlerp_quaternions<Lanes>, slerp_quaternions<Lanes>, euler_to_quaternions<Lanes>, quaternions_to_euler<Lanes>, \
+			transform_points<Lanes>, transform_directions<Lanes>, \
+			bound_points<Lanes>, max_distance<Lanes>, \
+		}
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_MATH_KERNELS_HPP
@@ -0,0 +1,54 @@
+﻿// compiled with /arch:AVX2, only called when the CPU reports AVX2 and FMA
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx2,fma")
+#endif
+
+#include "../Types/Vector.hpp" // not the precompiled header, its inline functions would be compiled for AVX2 too
+#include "Kernels.hpp"
+
+#ifdef MATH_X86
+#include <immintrin.h>
+
+namespace General
+{
+	namespace Models
+	{
+		namespace
+		{
+			struct Avx2Lanes
+			{
+				typedef __m256 V;
+				typedef __m256 M;
+				static const int width = 8;
+
+				static inline __m256i offsets(const int stride) { return _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(stride)); }
+				static inline V gather(const float* p, const int stride) { return _mm256_i32gather_ps(p, offsets(stride), 4); }
+				static inline void scatter(float* p, const int stride, const V v)
+				{
+					float lanes[8];
+					_mm256_storeu_ps(lanes, v);
+					for (int i = 0; i < 8; ++i) p[stride * i] = lanes[i];
+				}
+				static inline V set(const float v) { return _mm256_set1_ps(v); }
+				static inline V add(const V a, const V b) { return _mm256_add_ps(a, b); }
+				static inline V sub(const V a, const V b) { return _mm256_sub_ps(a, b); }
+				static inline V mul(const V a, const V b) { return _mm256_mul_ps(a, b); }
+				static inline V div(const V a, const V b) { return _mm256_div_ps(a, b); }
+				static inline V madd(const V a, const V b, const V c) { return _mm256_fmadd_ps(a, b, c); }
+				static inline V sqrt(const V v) { return _mm256_sqrt_ps(v); }
+				static inline V min(const V a, const V b) { return _mm256_min_ps(a, b); }
+				static inline V max(const V a, const V b) { return _mm256_max_ps(a, b); }
+				static inline V abs(const V v) { return _mm256_andnot_ps(_mm256_set1_ps(-.0f), v); }
+				static inline V round(const V v) { return _mm256_round_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+				static inline V copysign(const V magnitude, const V sign) { const V mask = _mm256_set1_ps(-.0f); return _mm256_or_ps(_mm256_andnot_ps(mask, magnitude), _mm256_and_ps(mask, sign)); }
+				static inline M less(const V a, const V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+				static inline M equal(const V a, const V b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+				static inline M both(const M a, const M b) { return _mm256_and_ps(a, b); }
+				static inline V select(const M mask, const V a, const V b) { return _mm256_blendv_ps(b, a, mask); }
+			};
+		}
+
+		const MathKernels math_kernels_avx2 = MATH_KERNELS(Avx2Lanes);
+	}
+}
+#endif
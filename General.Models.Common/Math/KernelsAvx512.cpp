@@ -0,0 +1,53 @@
+﻿// compiled with /arch:AVX512, only called when the CPU and the OS report AVX-512F
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC target("avx512f,avx2,fma")
+#endif
+
+#include "../Types/Vector.hpp" // not the precompiled header, its inline functions would be compiled for AVX512 too
+#include "Kernels.hpp"
+
+#ifdef MATH_X86
+#include <immintrin.h>
+
+namespace General
+{
+	namespace Models
+	{
+		namespace
+		{
+			struct Avx512Lanes
+			{
+				typedef __m512 V;
+				typedef __mmask16 M;
+				static const int width = 16;
+
+				static inline __m512i offsets(const int stride) { return _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15), _mm512_set1_epi32(stride)); }
+				static inline V gather(const float* p, const int stride) { return _mm512_i32gather_ps(offsets(stride), p, 4); }
+				static inline void scatter(float* p, const int stride, const V v) { _mm512_i32scatter_ps(p, offsets(stride), v, 4); }
+				static inline V set(const float v) { return _mm512_set1_ps(v); }
+				static inline V add(const V a, const V b) { return _mm512_add_ps(a, b); }
+				static inline V sub(const V a, const V b) { return _mm512_sub_ps(a, b); }
+				static inline V mul(const V a, const V b) { return _mm512_mul_ps(a, b); }
+				static inline V div(const V a, const V b) { return _mm512_div_ps(a, b); }
+				static inline V madd(const V a, const V b, const V c) { return _mm512_fmadd_ps(a, b, c); }
+				static inline V sqrt(const V v) { return _mm512_sqrt_ps(v); }
+				static inline V min(const V a, const V b) { return _mm512_min_ps(a, b); }
+				static inline V max(const V a, const V b) { return _mm512_max_ps(a, b); }
+				static inline V abs(const V v) { return _mm512_abs_ps(v); }
+				static inline V round(const V v) { return _mm512_roundscale_ps(v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC); }
+				static inline V copysign(const V magnitude, const V sign)
+				{
+					const __m512i mask = _mm512_set1_epi32(0x7fffffff);
+					return _mm512_castsi512_ps(_mm512_ternarylogic_epi32(mask, _mm512_castps_si512(magnitude), _mm512_castps_si512(sign), 0xca)); // mask ? magnitude : sign
+				}
+				static inline M less(const V a, const V b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+				static inline M equal(const V a, const V b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+				static inline M both(const M a, const M b) { return static_cast<M>(a & b); }
+				static inline V select(const M mask, const V a, const V b) { return _mm512_mask_blend_ps(mask, b, a); }
+			};
+		}
+
+		const MathKernels math_kernels_avx512 = MATH_KERNELS(Avx512Lanes);
+	}
+}
+#endif
@@ -0,0 +1,10 @@
+﻿#include "pch.h"
+#include "Kernels.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+		const MathKernels math_kernels_scalar = MATH_KERNELS(ScalarLanes);
+	}
+}
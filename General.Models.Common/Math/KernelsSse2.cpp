@@ -0,0 +1,48 @@
+﻿#include "pch.h"
+#include "Kernels.hpp"
+
+#ifdef MATH_X86
+#include <immintrin.h>
+
+namespace General
+{
+	namespace Models
+	{
+		namespace
+		{
+			struct Sse2Lanes
+			{
+				typedef __m128 V;
+				typedef __m128 M;
+				static const int width = 4;
+
+				static inline V gather(const float* p, const int stride) { return _mm_setr_ps(p[0], p[stride], p[stride * 2], p[stride * 3]); }
+				static inline void scatter(float* p, const int stride, const V v)
+				{
+					float lanes[4];
+					_mm_storeu_ps(lanes, v);
+					p[0] = lanes[0]; p[stride] = lanes[1]; p[stride * 2] = lanes[2]; p[stride * 3] = lanes[3];
+				}
+				static inline V set(const float v) { return _mm_set1_ps(v); }
+				static inline V add(const V a, const V b) { return _mm_add_ps(a, b); }
+				static inline V sub(const V a, const V b) { return _mm_sub_ps(a, b); }
+				static inline V mul(const V a, const V b) { return _mm_mul_ps(a, b); }
+				static inline V div(const V a, const V b) { return _mm_div_ps(a, b); }
+				static inline V madd(const V a, const V b, const V c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+				static inline V sqrt(const V v) { return _mm_sqrt_ps(v); }
+				static inline V min(const V a, const V b) { return _mm_min_ps(a, b); }
+				static inline V max(const V a, const V b) { return _mm_max_ps(a, b); }
+				static inline V abs(const V v) { return _mm_andnot_ps(_mm_set1_ps(-.0f), v); }
+				static inline V round(const V v) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(v)); } // nearest, the default rounding mode
+				static inline V copysign(const V magnitude, const V sign) { const V mask = _mm_set1_ps(-.0f); return _mm_or_ps(_mm_andnot_ps(mask, magnitude), _mm_and_ps(mask, sign)); }
+				static inline M less(const V a, const V b) { return _mm_cmplt_ps(a, b); }
+				static inline M equal(const V a, const V b) { return _mm_cmpeq_ps(a, b); }
+				static inline M both(const M a, const M b) { return _mm_and_ps(a, b); }
+				static inline V select(const M mask, const V a, const V b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+			};
+		}
+
+		const MathKernels math_kernels_sse2 = MATH_KERNELS(Sse2Lanes);
+	}
+}
+#endif
@@ -0,0 +1,190 @@
+﻿#include "pch.h"
+#include "Math.hpp"
+#include "Kernels.hpp"
+
+#ifdef MATH_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace General
+{
+	namespace Models
+	{
+#ifdef MATH_X86
+		static void read_cpuid(const int leaf, const int subleaf, unsigned int registers[4])
+		{
+#ifdef _MSC_VER
+			__cpuidex(reinterpret_cast<int*>(registers), leaf, subleaf);
+#else
+			__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+		}
+
+		static unsigned long long read_xcr0()
+		{
+#ifdef _MSC_VER
+			return _xgetbv(0);
+#else
+			unsigned int eax, edx;
+			__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+			return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+		}
+#endif
+
+		static SimdLevel detect_simd_level()
+		{
+#ifdef MATH_X86
+			unsigned int registers[4] = { };
+			read_cpuid(0, 0, registers);
+			const unsigned int maxLeaf = registers[0];
+
+			read_cpuid(1, 0, registers);
+			const bool sse2 = 0 != (registers[3] & (1u << 26));
+			const bool osxsave = 0 != (registers[2] & (1u << 27));
+			const bool avx = 0 != (registers[2] & (1u << 28));
+			const bool fma = 0 != (registers[2] & (1u << 12));
+			if (!sse2)
+			{
+				return SIMD_LEVEL_SCALAR;
+			}
+			if (!osxsave || !avx || !fma || maxLeaf < 7)
+			{
+				return SIMD_LEVEL_SSE2;
+			}
+
+			// the OS has to save the upper halves of the registers as well
+			const unsigned long long xcr0 = read_xcr0();
+			read_cpuid(7, 0, registers);
+			const bool avx2 = 0 != (registers[1] & (1u << 5)) && 0x6 == (xcr0 & 0x6);
+			const bool avx512 = 0 != (registers[1] & (1u << 16)) && 0xe6 == (xcr0 & 0xe6);
+			return avx512 && avx2 ? SIMD_LEVEL_AVX512 : (avx2 ? SIMD_LEVEL_AVX2 : SIMD_LEVEL_SSE2);
+#else
+			return SIMD_LEVEL_SCALAR;
+#endif
+		}
+
+		static const MathKernels* kernels_of(const SimdLevel level)
+		{
+			switch (level)
+			{
+#ifdef MATH_X86
+			case SIMD_LEVEL_AVX512: return &math_kernels_avx512;
+			case SIMD_LEVEL_AVX2: return &math_kernels_avx2;
+			case SIMD_LEVEL_SSE2: return &math_kernels_sse2;
+#endif
+			default: return &math_kernels_scalar;
+			}
+		}
+
+		struct MathDispatch
+		{
+			SimdLevel supported;
+			SimdLevel level;
+			const MathKernels* kernels;
+
+			MathDispatch() : supported(detect_simd_level()), level(supported), kernels(kernels_of(supported)) { }
+		};
+
+		static MathDispatch& dispatch()
+		{
+			static MathDispatch instance; // detected once, thread safe since C++11
+			return instance;
+		}
+
+		SimdLevel math_get_simd_level()
+		{
+			return dispatch().level;
+		}
+
+		SimdLevel math_set_simd_level(const SimdLevel level)
+		{
+			MathDispatch& instance = dispatch();
+			instance.level = level < instance.supported ? level : instance.supported;
+			instance.kernels = kernels_of(instance.level);
+			return instance.level;
+		}
+
+		void math_multiply_matrices(const Matrix* a, const Matrix* b, Matrix* results, const int count)
+		{
+			CHECK(a && b && results && count >= 0, );
+			dispatch().kernels->multiplyMatrices(a, b, results, count);
+		}
+
+		void math_invert_matrices(const Matrix* matrices, Matrix* results, const int count)
+		{
+			CHECK(matrices && results && count >= 0, );
+			dispatch().kernels->invertMatrices(matrices, results, count);
+		}
+
+		void math_compose_matrices(const Vector3* translations, const Vector4* rotations, const Vector3* scalings, Matrix* results, const int count)
+		{
+			CHECK(translations && rotations && scalings && results && count >= 0, );
+			dispatch().kernels->composeMatrices(translations, rotations, scalings, results, count);
+		}
+
+		void math_decompose_matrices(const Matrix* matrices, Vector3* translations, Vector4* rotations, Vector3* scalings, const int count)
+		{
+			CHECK(matrices && translations && rotations && scalings && count >= 0, );
+			dispatch().kernels->decomposeMatrices(matrices, translations, rotations, scalings, count);
+		}
+
+		void math_normalize_quaternions(const Vector4* quaternions, Vector4* results, const int count)
+		{
+			CHECK(quaternions && results && count >= 0, );
+			dispatch().kernels->normalizeQuaternions(quaternions, results, count);
+		}
+
+		void math_nlerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count)
+		{
+			CHECK(a && b && t && results && count >= 0, );
+			dispatch().kernels->nlerpQuaternions(a, b, t, results, count);
+		}
+
+		void math_slerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count)
+		{
+			CHECK(a && b && t && results && count >= 0, );
+			dispatch().kernels->slerpQuaternions(a, b, t, results, count);
+		}
+
+		void math_euler_to_quaternions(const Vector3* degrees, Vector4* results, const int count)
+		{
+			CHECK(degrees && results && count >= 0, );
+			dispatch().kernels->eulerToQuaternions(degrees, results, count);
+		}
+
+		void math_quaternions_to_euler(const Vector4* quaternions, Vector3* degrees, const int count)
+		{
+			CHECK(quaternions && degrees && count >= 0, );
+			dispatch().kernels->quaternionsToEuler(quaternions, degrees, count);
+		}
+
+		void math_transform_points(const Matrix* matrix, const Vector3* points, Vector3* results, const int count)
+		{
+			CHECK(matrix && points && results && count >= 0, );
+			dispatch().kernels->transformPoints(matrix, points, results, count);
+		}
+
+		void math_transform_directions(const Matrix* matrix, const Vector3* directions, Vector3* results, const int count)
+		{
+			CHECK(matrix && directions && results && count >= 0, );
+			dispatch().kernels->transformDirections(matrix, directions, results, count);
+		}
+
+		void math_bound_points(const Vector3* points, const int stride, const int count, Vector3* minimum, Vector3* maximum)
+		{
+			CHECK((points || 0 == count) && stride >= static_cast<int>(sizeof(Vector3)) && 0 == stride % sizeof(float) && count >= 0 && minimum && maximum, );
+			dispatch().kernels->boundPoints(points, stride, count, minimum, maximum);
+		}
+
+		float math_max_distance(const Vector3* points, const int stride, const int count, const Vector3* center)
+		{
+			CHECK((points || 0 == count) && stride >= static_cast<int>(sizeof(Vector3)) && 0 == stride % sizeof(float) && count >= 0 && center, .0f);
+			return dispatch().kernels->maxDistance(points, stride, count, center);
+		}
+	}
+}
@@ -0,0 +1,46 @@
+﻿#ifndef GENERAL_MODELS_COMMON_MATH_HPP
+#define GENERAL_MODELS_COMMON_MATH_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		enum SimdLevel
+		{
+			SIMD_LEVEL_SCALAR,
+			SIMD_LEVEL_SSE2,
+			SIMD_LEVEL_AVX2, // with FMA
+			SIMD_LEVEL_AVX512,
+		};
+
+		/****************************************************************
+		* Batch kernels over arrays, the implementation is picked once at
+		* runtime from the instruction sets of the CPU. Every kernel reads
+		* its inputs with unaligned loads and may work in place.
+		* Matrices follow Hierarchy.hpp: row matrices, local = S * R * T.
+		* ***************************************************************/
+
+		EXPORT SimdLevel math_get_simd_level();
+		EXPORT SimdLevel math_set_simd_level(const SimdLevel level); // clamped to what the CPU supports, returns the level in use
+
+		EXPORT void math_multiply_matrices(const Matrix* a, const Matrix* b, Matrix* results, const int count); // results[i] = a[i] * b[i]
+		EXPORT void math_invert_matrices(const Matrix* matrices, Matrix* results, const int count); // singular matrices become zero
+		EXPORT void math_compose_matrices(const Vector3* translations, const Vector4* rotations, const Vector3* scalings, Matrix* results, const int count);
+		EXPORT void math_decompose_matrices(const Matrix* matrices, Vector3* translations, Vector4* rotations, Vector3* scalings, const int count);
+
+		EXPORT void math_normalize_quaternions(const Vector4* quaternions, Vector4* results, const int count); // zero quaternions become identity
+		EXPORT void math_nlerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count);
+		EXPORT void math_slerp_quaternions(const Vector4* a, const Vector4* b, const float* t, Vector4* results, const int count);
+		EXPORT void math_euler_to_quaternions(const Vector3* degrees, Vector4* results, const int count); // x, y and then z
+		EXPORT void math_quaternions_to_euler(const Vector4* quaternions, Vector3* degrees, const int count);
+
+		EXPORT void math_transform_points(const Matrix* matrix, const Vector3* points, Vector3* results, const int count);
+		EXPORT void math_transform_directions(const Matrix* matrix, const Vector3* directions, Vector3* results, const int count); // ignores translation
+
+		// stride is the distance between two points in bytes, a multiple of 4, so positions can be read straight out of Vertex arrays
+		EXPORT void math_bound_points(const Vector3* points, const int stride, const int count, Vector3* minimum, Vector3* maximum); // minimum > maximum if count is 0
+		EXPORT float math_max_distance(const Vector3* points, const int stride, const int count, const Vector3* center);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_MATH_HPP
@@ -0,0 +1,407 @@
+﻿#include "pch.h"
+#include "Batch.hpp"
+
+#include <map>
+#include <math.h>
+#include <set>
+#include <unordered_map>
+
+namespace General
+{
+	namespace Models
+	{
+		static bool string_equals(const char* a, const char* b)
+		{
+			return a == b || (a && b && 0 == strcmp(a, b));
+		}
+
+		static bool texture_equals(const MaterialTexture* a, const MaterialTexture* b)
+		{
+			if (nullptr == a || nullptr == b)
+			{
+				return a == b;
+			}
+			return string_equals(a->texture, b->texture) && string_equals(a->uvSet, b->uvSet) && a->useDefaultUVSet == b->useDefaultUVSet;
+		}
+
+		// importers may create one material per mesh, so equal materials are not always the same object
+		static bool material_equals(const Material* a, const Material* b)
+		{
+			if (a == b)
+			{
+				return true;
+			}
+			if (nullptr == a || nullptr == b)
+			{
+				return false;
+			}
+			return string_equals(a->name, b->name) && texture_equals(a->ambient, b->ambient) && texture_equals(a->diffuse, b->diffuse) &&
+				texture_equals(a->emissive, b->emissive) && texture_equals(a->specular, b->specular);
+		}
+
+		static MaterialTexture* copy_material_texture(const MaterialTexture* texture)
+		{
+			if (nullptr == texture)
+			{
+				return nullptr;
+			}
+			MaterialTexture* copy = create_material_texture();
+			set_material_texture(copy, texture->texture, texture->uvSet);
+			copy->useDefaultUVSet = texture->useDefaultUVSet;
+			return copy;
+		}
+
+		// meshes destroy their materials, so a batch can not share them with the meshes it merged
+		static Material* copy_material(const Material* material)
+		{
+			if (nullptr == material)
+			{
+				return nullptr;
+			}
+			Material* copy = create_material(material->name);
+			copy->ambient = copy_material_texture(material->ambient);
+			copy->diffuse = copy_material_texture(material->diffuse);
+			copy->emissive = copy_material_texture(material->emissive);
+			copy->specular = copy_material_texture(material->specular);
+			return copy;
+		}
+
+		/// <summary>marks the nodes an animation curve targets and all their descendants</summary>
+		static void find_animated_nodes(const Model* instance, std::vector<char>& animated)
+		{
+			const NodeTable* table = instance->nodeTable;
+			animated.assign(table->count, 0);
+			for (int i = 0; i < instance->animationCount; ++i)
+			{
+				const AnimationCurve* curve = instance->animations[i]->curve;
+				for (int j = 0; curve && j < curve->nodeCount; ++j)
+				{
+					const Node* target = curve->nodes[j]->target;
+					if (target && target->index >= 0 && target->index < table->count && table->nodes[target->index] == target) animated[target->index] = 1;
+				}
+			}
+			for (int i = 1; i < table->count; ++i)
+			{
+				if (animated[table->parents[i]]) animated[i] = 1;
+			}
+		}
+
+		static bool is_batch(const Model* instance, const Mesh* mesh)
+		{
+			for (int i = 0; i < instance->batchRangeCount; ++i)
+			{
+				if (instance->batchRanges[i].batch == mesh) return true;
+			}
+			return false;
+		}
+
+		/// <summary>normals transform with the inverse transpose, mirrored transforms also flip the winding</summary>
+		static bool compute_normal_matrix(const Matrix& transform, Matrix& normalMatrix)
+		{
+			Matrix inverse;
+			math_invert_matrices(&transform, &inverse, 1);
+			normalMatrix = { };
+			for (int row = 0; row < 3; ++row)
+			{
+				for (int column = 0; column < 3; ++column)
+				{
+					normalMatrix.values[row * 4 + column] = inverse.values[column * 4 + row];
+				}
+			}
+			normalMatrix.values[15] = 1.0f;
+
+			const float* m = transform.values;
+			const float determinant = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) + m[2] * (m[4] * m[9] - m[5] * m[8]);
+			return determinant < .0f;
+		}
+
+		struct BatchMember
+		{
+			int node; // into Model::nodeTable
+			int firstVertex;
+			int firstTriangle;
+		};
+
+		static Mesh* build_batch(Model* instance, const std::vector<BatchMember>& members, const std::vector<Matrix>& transforms, const int vertexCount, const int triangleCount, const char* name)
+		{
+			const NodeTable* table = instance->nodeTable;
+			Mesh* batch = create_mesh(name);
+			mesh_set_vertex_count(batch, vertexCount);
+			batch->vertexAttributes = 0;
+			for (const BatchMember& member : members)
+			{
+				batch->vertexAttributes |= table->nodes[member.node]->mesh->vertexAttributes;
+			}
+			std::vector<int> indices(static_cast<size_t>(triangleCount) * 3);
+			std::vector<int> materials(triangleCount);
+
+			// members write disjoint parts of the vertices and indices, nothing is allocated through models_*
+			parallel_for(static_cast<int>(members.size()), [&](const int i)
+			{
+				const BatchMember& member = members[i];
+				const Mesh* mesh = table->nodes[member.node]->mesh;
+				Vertex* vertices = batch->vertices + member.firstVertex;
+				mesh_copy_vertices(mesh, vertices);
+
+				const Matrix& transform = transforms[member.node];
+				Matrix normalMatrix;
+				const bool mirrored = compute_normal_matrix(transform, normalMatrix);
+				std::vector<Vector3> scratch(mesh->vertexCount);
+				for (int v = 0; v < mesh->vertexCount; ++v) scratch[v] = vertices[v].position;
+				math_transform_points(&transform, scratch.data(), scratch.data(), mesh->vertexCount);
+				for (int v = 0; v < mesh->vertexCount; ++v) vertices[v].position = scratch[v];
+				for (int v = 0; v < mesh->vertexCount; ++v) scratch[v] = vertices[v].normal;
+				math_transform_directions(&normalMatrix, scratch.data(), scratch.data(), mesh->vertexCount);
+				for (int v = 0; v < mesh->vertexCount; ++v)
+				{
+					const Vector3& n = scratch[v];
+					const float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+					vertices[v].normal = length > .0f ? Vector3{ n.x / length, n.y / length, n.z / length } : n;
+				}
+
+				int* target = indices.data() + static_cast<size_t>(member.firstTriangle) * 3;
+				mesh_copy_indices(mesh, target);
+				for (int t = 0; t < mesh->triangleCount; ++t)
+				{
+					int* triangle = target + t * 3;
+					for (int k = 0; k < 3; ++k) triangle[k] += member.firstVertex;
+					if (mirrored) std::swap(triangle[1], triangle[2]);
+				}
+				for (int s = 0; s < mesh_get_submesh_count(mesh); ++s)
+				{
+					const Submesh submesh = mesh_get_submesh(mesh, s);
+					int* material = materials.data() + member.firstTriangle + submesh.firstTriangle;
+					std::fill(material, material + submesh.triangleCount, submesh.material);
+				}
+			});
+			mesh_set_indices(batch, static_cast<int>(indices.size()), indices.data());
+
+			const Mesh* first = table->nodes[members.front().node]->mesh;
+			for (int i = 0; i < first->materialCount; ++i)
+			{
+				mesh_add_material(batch, copy_material(first->materials[i]));
+			}
+			mesh_sort_submeshes(batch, materials.data()); // the members of one material stay in order, so every member keeps a range per submesh
+			return batch;
+		}
+
+		/// <summary>detaches the merged nodes, then releases the meshes left without nodes and the materials only they used</summary>
+		static void release_merged_meshes(Model* instance, const std::vector<Node*>& mergedNodes)
+		{
+			std::unordered_map<Mesh*, int> detached;
+			for (Node* node : mergedNodes)
+			{
+				++detached[node->mesh];
+				node->mesh = nullptr;
+			}
+
+			std::set<const Material*> kept;
+			std::vector<Mesh*> released;
+			auto keep_materials = [&](const Mesh* mesh)
+			{
+				for (int i = 0; i < mesh->materialCount; ++i) kept.insert(mesh->materials[i]);
+			};
+			for (int i = 0; i < instance->meshCount; ++i)
+			{
+				Mesh* mesh = instance->meshes[i];
+				const auto found = detached.find(mesh);
+				if (found == detached.end() || mesh->referenceCount > found->second) keep_materials(mesh);
+			}
+			for (const auto& item : detached)
+			{
+				if (item.first->referenceCount == item.second) released.push_back(item.first);
+			}
+
+			// meshes destroy their materials, so every material is left to the last mesh owning it
+			std::set<const Material*> destroyed;
+			for (Mesh* mesh : released)
+			{
+				for (int i = 0; i < mesh->materialCount; ++i)
+				{
+					Material*& material = mesh->materials[i];
+					if (kept.count(material) || !destroyed.insert(material).second) material = nullptr;
+				}
+			}
+			for (const auto& item : detached)
+			{
+				for (int i = 0; i < item.second; ++i) destroy_mesh(item.first);
+			}
+
+			int meshCount = 0;
+			for (int i = 0; i < instance->meshCount; ++i)
+			{
+				if (std::find(released.begin(), released.end(), instance->meshes[i]) == released.end()) instance->meshes[meshCount++] = instance->meshes[i];
+			}
+			models_resize_array(instance, &instance->meshes, &instance->meshCount, meshCount);
+			int materialCount = 0;
+			for (int i = 0; i < instance->materialCount; ++i)
+			{
+				if (!destroyed.count(instance->materials[i])) instance->materials[materialCount++] = instance->materials[i];
+			}
+			models_resize_array(instance, &instance->materials, &instance->materialCount, materialCount);
+		}
+
+		static BatchReport batch_static_meshes(Model* instance, const int maxVertexCount)
+		{
+			BatchReport report = { };
+			CHECK(instance && instance->root && maxVertexCount >= 0, report);
+
+			const NodeTable* table = model_build_node_table(instance);
+			std::vector<char> animated;
+			find_animated_nodes(instance, animated);
+
+			// nodes are grouped by the equality classes of their materials, in preorder
+			std::vector<const Material*> representatives;
+			std::map<std::vector<int>, std::vector<int>> groups;
+			for (int i = 0; i < table->count; ++i)
+			{
+				const Node* node = table->nodes[i];
+				const Mesh* mesh = node->mesh;
+				if (nullptr == mesh)
+				{
+					continue;
+				}
+				++report.drawCallsBefore;
+				if (!node->visible || animated[i] || mesh->weightCollectionCount || mesh->skin || 0 == mesh->triangleCount || is_batch(instance, mesh) ||
+					(maxVertexCount && mesh->vertexCount > maxVertexCount))
+				{
+					continue;
+				}
+
+				std::vector<int> key(mesh->materialCount);
+				for (int m = 0; m < mesh->materialCount; ++m)
+				{
+					int id = 0;
+					while (id < static_cast<int>(representatives.size()) && !material_equals(representatives[id], mesh->materials[m])) ++id;
+					if (id == static_cast<int>(representatives.size())) representatives.push_back(mesh->materials[m]);
+					key[m] = id;
+				}
+				groups[key].push_back(i);
+			}
+
+			// vertices are baked relative to the root, the batches hang right below it
+			std::vector<Matrix> transforms(table->count);
+			model_compute_matrices(instance, nullptr, transforms.data());
+			Matrix rootInverse;
+			math_invert_matrices(transforms.data(), &rootInverse, 1);
+			std::vector<Matrix> roots(table->count, rootInverse);
+			math_multiply_matrices(transforms.data(), roots.data(), transforms.data(), table->count);
+
+			std::vector<Node*> mergedNodes;
+			std::vector<Mesh*> batches;
+			std::vector<BatchRange> ranges;
+			for (const auto& group : groups)
+			{
+				const std::vector<int>& nodes = group.second;
+				size_t begin = 0;
+				while (begin < nodes.size())
+				{
+					std::vector<BatchMember> members;
+					int vertexCount = 0, triangleCount = 0;
+					size_t end = begin;
+					for (; end < nodes.size(); ++end)
+					{
+						const Mesh* mesh = table->nodes[nodes[end]]->mesh;
+						if (maxVertexCount && vertexCount + mesh->vertexCount > maxVertexCount) break;
+						members.push_back({ nodes[end], vertexCount, triangleCount });
+						vertexCount += mesh->vertexCount;
+						triangleCount += mesh->triangleCount;
+					}
+					begin = end;
+					if (members.size() < 2)
+					{
+						continue;
+					}
+
+					const Mesh* first = table->nodes[members.front().node]->mesh;
+					char name[256];
+					snprintf(name, sizeof(name), "Batch %d (%s)", static_cast<int>(batches.size()), first->materialCount && first->materials[0] && first->materials[0]->name ? first->materials[0]->name : "no material");
+					Mesh* batch = build_batch(instance, members, transforms, vertexCount, triangleCount, name);
+					batches.push_back(batch);
+					for (int s = 0; s < mesh_get_submesh_count(batch); ++s)
+					{
+						const Submesh submesh = mesh_get_submesh(batch, s);
+						int firstTriangle = submesh.firstTriangle;
+						for (const BatchMember& member : members)
+						{
+							Node* node = table->nodes[member.node];
+							int triangleCount = 0;
+							for (int m = 0; m < mesh_get_submesh_count(node->mesh); ++m)
+							{
+								const Submesh source = mesh_get_submesh(node->mesh, m);
+								if (source.material == submesh.material) triangleCount += source.triangleCount;
+							}
+							if (triangleCount)
+							{
+								ranges.push_back({ node, batch, member.firstVertex, node->mesh->vertexCount, firstTriangle, triangleCount });
+								firstTriangle += triangleCount;
+							}
+						}
+					}
+					for (const BatchMember& member : members)
+					{
+						mergedNodes.push_back(table->nodes[member.node]);
+					}
+				}
+			}
+
+			report.mergedNodeCount = static_cast<int>(mergedNodes.size());
+			report.batchCount = static_cast<int>(batches.size());
+			report.drawCallsAfter = report.drawCallsBefore - report.mergedNodeCount + report.batchCount;
+			if (batches.empty())
+			{
+				return report;
+			}
+
+			release_merged_meshes(instance, mergedNodes);
+			for (Mesh* batch : batches)
+			{
+				Node* node = create_node(batch->name);
+				node->localScaling = { 1.0f, 1.0f, 1.0f };
+				node->mesh = batch;
+				node_add_child(instance->root, node);
+				model_add_mesh(instance, batch);
+				for (int i = 0; i < batch->materialCount; ++i)
+				{
+					if (batch->materials[i]) model_add_material(instance, batch->materials[i]);
+				}
+			}
+
+			const int rangeOffset = instance->batchRangeCount;
+			models_resize_array(instance, &instance->batchRanges, &instance->batchRangeCount, rangeOffset + static_cast<int>(ranges.size()));
+			memcpy(instance->batchRanges + rangeOffset, ranges.data(), sizeof(BatchRange) * ranges.size());
+
+			model_index_names(instance);
+			model_build_node_table(instance);
+			model_build_mesh_instances(instance);
+			model_update_bounds(instance);
+			return report;
+		}
+
+		BatchReport model_batch_static_meshes(Model* instance, const int maxVertexCount)
+		{
+			// batches add meshes, materials and nodes, binding the model carves and names them like imported ones
+			Model* previous = model_bind(instance);
+			const BatchReport report = batch_static_meshes(instance, maxVertexCount);
+			model_bind(previous);
+			return report;
+		}
+
+		const BatchRange* model_find_batch_range(const Model* instance, const Mesh* batch, const int triangle)
+		{
+			CHECK(instance && batch && triangle >= 0, nullptr);
+
+			const BatchRange* begin = instance->batchRanges;
+			const BatchRange* end = begin + instance->batchRangeCount;
+			begin = std::find_if(begin, end, [batch](const BatchRange& range) { return range.batch == batch; });
+			end = std::find_if(begin, end, [batch](const BatchRange& range) { return range.batch != batch; });
+			const BatchRange* found = std::upper_bound(begin, end, triangle, [](const int value, const BatchRange& range) { return value < range.firstTriangle; });
+			if (found == begin)
+			{
+				return nullptr;
+			}
+			--found;
+			return triangle < found->firstTriangle + found->triangleCount ? found : nullptr;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+﻿#ifndef GENERAL_MODELS_COMMON_BATCH_HPP
+#define GENERAL_MODELS_COMMON_BATCH_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct BatchRange // the part of a submesh of a merged mesh that came from one node
+		{
+			Node* node; // stays in the tree without a mesh
+			Mesh* batch; // drawn by a node added under Model::root
+			int firstVertex;
+			int vertexCount;
+			int firstTriangle;
+			int triangleCount;
+		};
+
+		struct BatchReport
+		{
+			int drawCallsBefore; // nodes drawing a mesh
+			int drawCallsAfter;
+			int mergedNodeCount;
+			int batchCount;
+		};
+
+		/// <summary>
+		/// merges the meshes of visible nodes that no animation moves and that are not skinned into one mesh per set of equal
+		/// materials, with the node transforms baked into the vertices relative to the root. Merged nodes lose their mesh,
+		/// Model::batchRanges maps every triangle of a batch back to its node
+		/// </summary>
+		/// <param name="maxVertexCount">starts another batch before one grows past this, 0 for no limit</param>
+		EXPORT BatchReport model_batch_static_meshes(Model* instance, const int maxVertexCount);
+		/// <returns>the range holding the triangle of a batch, nullptr if the mesh is not a batch</returns>
+		EXPORT const BatchRange* model_find_batch_range(const Model* instance, const Mesh* batch, const int triangle);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_BATCH_HPP
@@ -0,0 +1,146 @@
+﻿#include "pch.h"
+#include "Bounds.hpp"
+
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+		static Bounds empty_bounds()
+		{
+			Bounds bounds = { };
+			bounds.minimum = { HUGE_VALF, HUGE_VALF, HUGE_VALF };
+			bounds.maximum = { -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+			return bounds;
+		}
+
+		static bool bounds_empty(const Bounds& bounds)
+		{
+			return bounds.minimum.x > bounds.maximum.x;
+		}
+
+		static Vector3 bounds_center(const Bounds& bounds)
+		{
+			return { (bounds.minimum.x + bounds.maximum.x) * .5f, (bounds.minimum.y + bounds.maximum.y) * .5f, (bounds.minimum.z + bounds.maximum.z) * .5f };
+		}
+
+		static float distance(const Vector3& a, const Vector3& b)
+		{
+			return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+		}
+
+		void mesh_compute_bounds(Mesh* instance)
+		{
+			CHECK(instance, );
+
+			Bounds bounds = empty_bounds();
+			int stride;
+			const Vector3* positions = mesh_get_positions(instance, &stride);
+			if (positions && instance->vertexCount > 0)
+			{
+				math_bound_points(positions, stride, instance->vertexCount, &bounds.minimum, &bounds.maximum);
+				bounds.center = bounds_center(bounds);
+				bounds.radius = math_max_distance(positions, stride, instance->vertexCount, &bounds.center);
+			}
+			instance->bounds = bounds;
+			instance->boundsValid = true;
+		}
+
+		void model_compute_node_bounds(Model* instance)
+		{
+			CHECK(instance, );
+
+			const NodeTable* table = instance->nodeTable;
+			const int count = table ? table->count : 0;
+			models_resize_array(instance, &instance->nodeBounds, &instance->nodeBoundsCount, count);
+			if (0 == count)
+			{
+				return;
+			}
+
+			std::vector<Matrix> worlds(count);
+			model_compute_matrices(instance, nullptr, worlds.data());
+
+			// the box and sphere of every mesh in model space, the sphere scales with the longest axis of the matrix
+			std::vector<Vector3> centers(count);
+			std::vector<float> radii(count, -1.0f);
+			for (int i = 0; i < count; ++i)
+			{
+				Bounds& bounds = instance->nodeBounds[i] = empty_bounds();
+				const Mesh* mesh = table->nodes[i]->mesh;
+				if (!mesh || !mesh->boundsValid || bounds_empty(mesh->bounds))
+				{
+					continue;
+				}
+
+				const Vector3& low = mesh->bounds.minimum;
+				const Vector3& high = mesh->bounds.maximum;
+				Vector3 corners[8];
+				for (int k = 0; k < 8; ++k)
+				{
+					corners[k] = { k & 1 ? high.x : low.x, k & 2 ? high.y : low.y, k & 4 ? high.z : low.z };
+				}
+				math_transform_points(&worlds[i], corners, corners, 8);
+				math_bound_points(corners, sizeof(Vector3), 8, &bounds.minimum, &bounds.maximum);
+
+				const float* m = worlds[i].values;
+				float scale = .0f;
+				for (int row = 0; row < 3; ++row)
+				{
+					scale = std::max(scale, sqrtf(m[row * 4] * m[row * 4] + m[row * 4 + 1] * m[row * 4 + 1] + m[row * 4 + 2] * m[row * 4 + 2]));
+				}
+				math_transform_points(&worlds[i], &mesh->bounds.center, &centers[i], 1);
+				radii[i] = mesh->bounds.radius * scale;
+			}
+
+			// children come after their parents, so walking backwards folds every subtree into its root
+			for (int i = count - 1; i > 0; --i)
+			{
+				const Bounds& child = instance->nodeBounds[i];
+				Bounds& parent = instance->nodeBounds[table->parents[i]];
+				for (int k = 0; k < 3; ++k)
+				{
+					parent.minimum.values[k] = std::min(parent.minimum.values[k], child.minimum.values[k]);
+					parent.maximum.values[k] = std::max(parent.maximum.values[k], child.maximum.values[k]);
+				}
+			}
+
+			// the sphere of a subtree encloses the spheres of its meshes, but never gets larger than the one around its box
+			for (int i = 0; i < count; ++i)
+			{
+				Bounds& bounds = instance->nodeBounds[i];
+				if (bounds_empty(bounds))
+				{
+					continue;
+				}
+
+				bounds.center = bounds_center(bounds);
+				float radius = .0f;
+				for (int j = i; j < table->ends[i]; ++j)
+				{
+					if (radii[j] >= .0f) radius = std::max(radius, distance(bounds.center, centers[j]) + radii[j]);
+				}
+				bounds.radius = std::min(radius, distance(bounds.center, bounds.maximum));
+			}
+		}
+
+		void model_update_bounds(Model* instance)
+		{
+			CHECK(instance, );
+
+			std::vector<Mesh*> meshes;
+			for (int i = 0; i < instance->meshCount; ++i)
+			{
+				if (!instance->meshes[i]->boundsValid) meshes.push_back(instance->meshes[i]);
+			}
+			parallel_for(static_cast<int>(meshes.size()), [&meshes](const int i) { mesh_compute_bounds(meshes[i]); });
+
+			const int nodeCount = instance->nodeTable ? instance->nodeTable->count : 0;
+			if (!meshes.empty() || nodeCount != instance->nodeBoundsCount)
+			{
+				model_compute_node_bounds(instance);
+			}
+		}
+	}
+}
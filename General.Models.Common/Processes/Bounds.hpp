@@ -0,0 +1,16 @@
+﻿#ifndef GENERAL_MODELS_COMMON_BOUNDS_HPP
+#define GENERAL_MODELS_COMMON_BOUNDS_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		EXPORT void mesh_compute_bounds(Mesh* instance); // rebuilds Mesh::bounds from the positions and sets Mesh::boundsValid
+		/// <summary>rebuilds Model::nodeBounds from the mesh bounds and the transforms in Model::nodeTable, call it after nodes moved</summary>
+		EXPORT void model_compute_node_bounds(Model* instance);
+		/// <summary>recomputes the meshes whose bounds are not valid in parallel, and the node bounds if any of them or the node table changed</summary>
+		EXPORT void model_update_bounds(Model* instance);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_BOUNDS_HPP
@@ -0,0 +1,327 @@
+﻿#include "pch.h"
+#include "Meshlets.hpp"
+
+#include <climits>
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+		struct MeshletBuild
+		{
+			std::vector<Meshlet> meshlets;
+			std::vector<int> vertices;
+			std::vector<unsigned char> triangles;
+		};
+
+		static void compute_meshlet_bounds(Meshlet& meshlet, const MeshletBuild& build, const char* positions, const int stride)
+		{
+			auto position = [&](const int localIndex) -> const Vector3&
+			{
+				return *reinterpret_cast<const Vector3*>(positions + static_cast<size_t>(stride) * build.vertices[meshlet.vertexOffset + localIndex]);
+			};
+			auto distance = [](const Vector3& a, const Vector3& b)
+			{
+				return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y) + (a.z - b.z) * (a.z - b.z));
+			};
+
+			// Ritter's sphere, starts from the farthest pair of the axis extremes and grows over the points left outside
+			int extremes[6] = { };
+			for (int i = 1; i < meshlet.vertexCount; ++i)
+			{
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (position(i).values[axis] < position(extremes[axis * 2]).values[axis]) extremes[axis * 2] = i;
+					if (position(i).values[axis] > position(extremes[axis * 2 + 1]).values[axis]) extremes[axis * 2 + 1] = i;
+				}
+			}
+			int pair = 0;
+			for (int axis = 1; axis < 3; ++axis)
+			{
+				if (distance(position(extremes[axis * 2]), position(extremes[axis * 2 + 1])) > distance(position(extremes[pair * 2]), position(extremes[pair * 2 + 1]))) pair = axis;
+			}
+			const Vector3& first = position(extremes[pair * 2]);
+			const Vector3& second = position(extremes[pair * 2 + 1]);
+			Vector3 center = { (first.x + second.x) * .5f, (first.y + second.y) * .5f, (first.z + second.z) * .5f };
+			float radius = distance(first, second) * .5f;
+			for (int i = 0; i < meshlet.vertexCount; ++i)
+			{
+				const Vector3& p = position(i);
+				const float d = distance(p, center);
+				if (d > radius)
+				{
+					const float grown = (radius + d) * .5f;
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						center.values[axis] += (p.values[axis] - center.values[axis]) * (grown - radius) / d;
+					}
+					radius = grown;
+				}
+			}
+			meshlet.center = center;
+			meshlet.radius = radius;
+
+			// the cone axis averages the face normals, the apex moves back until every face plane is in front of it
+			std::vector<Vector3> normals(meshlet.triangleCount);
+			std::vector<Vector3> centroids(meshlet.triangleCount);
+			Vector3 axis = { };
+			int faceCount = 0;
+			for (int t = 0; t < meshlet.triangleCount; ++t)
+			{
+				const unsigned char* triangle = build.triangles.data() + (static_cast<size_t>(meshlet.triangleOffset) + t) * 3;
+				const Vector3& p0 = position(triangle[0]);
+				const Vector3& p1 = position(triangle[1]);
+				const Vector3& p2 = position(triangle[2]);
+				const Vector3 e1 = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+				const Vector3 e2 = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+				Vector3 n = { e1.y * e2.z - e1.z * e2.y, e1.z * e2.x - e1.x * e2.z, e1.x * e2.y - e1.y * e2.x };
+				const float length = sqrtf(n.x * n.x + n.y * n.y + n.z * n.z);
+				if (length <= .0f)
+				{
+					continue;
+				}
+				n = { n.x / length, n.y / length, n.z / length };
+				normals[faceCount] = n;
+				centroids[faceCount] = { (p0.x + p1.x + p2.x) / 3.0f, (p0.y + p1.y + p2.y) / 3.0f, (p0.z + p1.z + p2.z) / 3.0f };
+				axis = { axis.x + n.x, axis.y + n.y, axis.z + n.z };
+				++faceCount;
+			}
+
+			meshlet.coneApex = center;
+			meshlet.coneAxis = { };
+			meshlet.coneCutoff = 1.0f;
+			const float axisLength = sqrtf(axis.x * axis.x + axis.y * axis.y + axis.z * axis.z);
+			if (axisLength <= .0f)
+			{
+				return;
+			}
+			axis = { axis.x / axisLength, axis.y / axisLength, axis.z / axisLength };
+			meshlet.coneAxis = axis;
+
+			float minimumDot = 1.0f;
+			for (int i = 0; i < faceCount; ++i)
+			{
+				minimumDot = std::min(minimumDot, normals[i].x * axis.x + normals[i].y * axis.y + normals[i].z * axis.z);
+			}
+			if (minimumDot <= .1f)
+			{
+				return; // wider than about 84 degrees, culling would rarely succeed
+			}
+
+			// the apex center - axis * offset is behind the plane of face i once dot(center - centroid, n) <= offset * dot(axis, n)
+			float offset = .0f;
+			for (int i = 0; i < faceCount; ++i)
+			{
+				const Vector3& n = normals[i];
+				const float dc = (center.x - centroids[i].x) * n.x + (center.y - centroids[i].y) * n.y + (center.z - centroids[i].z) * n.z;
+				const float dn = axis.x * n.x + axis.y * n.y + axis.z * n.z;
+				offset = std::max(offset, dc / dn);
+			}
+			meshlet.coneApex = { center.x - axis.x * offset, center.y - axis.y * offset, center.z - axis.z * offset };
+			meshlet.coneCutoff = sqrtf(1.0f - minimumDot * minimumDot);
+		}
+
+		static bool build_meshlets(const Mesh* mesh, const int maxVertices, const int maxTriangles, MeshletBuild& build)
+		{
+			const int triangleCount = mesh->triangleCount;
+			const int vertexCount = mesh->vertexCount;
+			std::vector<int> indices(static_cast<size_t>(triangleCount) * 3);
+			mesh_copy_indices(mesh, indices.data());
+			for (const int index : indices)
+			{
+				CHECK(index >= 0 && index < vertexCount, false);
+			}
+
+			int stride;
+			const char* positions = reinterpret_cast<const char*>(mesh_get_positions(mesh, &stride));
+			CHECK(positions || 0 == triangleCount, false);
+
+			std::vector<int> offsets(vertexCount + 1, 0);
+			for (const int index : indices)
+			{
+				++offsets[index + 1];
+			}
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				offsets[i + 1] += offsets[i];
+			}
+			std::vector<int> adjacency(indices.size());
+			std::vector<int> cursors(offsets.begin(), offsets.end() - 1);
+			for (size_t i = 0; i < indices.size(); ++i)
+			{
+				adjacency[cursors[indices[i]]++] = static_cast<int>(i / 3);
+			}
+
+			std::vector<int> submeshes(triangleCount);
+			for (int i = 0; i < mesh_get_submesh_count(mesh); ++i)
+			{
+				const Submesh submesh = mesh_get_submesh(mesh, i);
+				std::fill(submeshes.begin() + submesh.firstTriangle, submeshes.begin() + submesh.firstTriangle + submesh.triangleCount, i);
+			}
+
+			std::vector<int> slots(vertexCount, -1); // local index of every vertex in the current meshlet
+			std::vector<bool> emitted(triangleCount, false);
+			std::vector<int> live(offsets.begin() + 1, offsets.end()); // triangles of every vertex not emitted yet
+			for (int i = vertexCount - 1; i > 0; --i)
+			{
+				live[i] -= live[i - 1];
+			}
+			Meshlet current = { };
+			auto flush = [&]()
+			{
+				if (0 == current.triangleCount)
+				{
+					return;
+				}
+				compute_meshlet_bounds(current, build, positions, stride);
+				build.meshlets.push_back(current);
+				for (int i = 0; i < current.vertexCount; ++i)
+				{
+					slots[build.vertices[current.vertexOffset + i]] = -1;
+				}
+				const int submesh = current.submesh;
+				current = { };
+				current.submesh = submesh;
+				current.vertexOffset = static_cast<int>(build.vertices.size());
+				current.triangleOffset = static_cast<int>(build.triangles.size() / 3);
+			};
+			auto newVertices = [&](const int triangleIndex)
+			{
+				const int* triangle = indices.data() + triangleIndex * 3;
+				int count = 0;
+				for (int i = 0; i < 3; ++i)
+				{
+					if (slots[triangle[i]] < 0 && (0 == i || triangle[i] != triangle[0]) && (i < 2 || triangle[2] != triangle[1])) ++count;
+				}
+				return count;
+			};
+			auto pick = [&](const int vertexIndex, int& best, int& bestCount, int& bestLive)
+			{
+				for (int i = offsets[vertexIndex]; i < offsets[vertexIndex + 1]; ++i)
+				{
+					const int triangleIndex = adjacency[i];
+					if (emitted[triangleIndex] || submeshes[triangleIndex] != current.submesh)
+					{
+						continue;
+					}
+					// among equals the triangle closing the fans of its vertices keeps the meshlet compact
+					const int count = newVertices(triangleIndex);
+					const int* triangle = indices.data() + triangleIndex * 3;
+					const int triangleLive = live[triangle[0]] + live[triangle[1]] + live[triangle[2]];
+					if ((count < bestCount || (count == bestCount && triangleLive < bestLive)) && current.vertexCount + count <= maxVertices)
+					{
+						best = triangleIndex;
+						bestCount = count;
+						bestLive = triangleLive;
+					}
+				}
+			};
+
+			int cursor = 0; // every triangle before it is emitted
+			int last = -1;
+			int submeshEnd = 0; // the submeshes are emitted one after another
+			for (int emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+			{
+				if (emittedCount == submeshEnd)
+				{
+					flush();
+					const int submesh = submeshes[emittedCount];
+					submeshEnd = emittedCount + mesh_get_submesh(mesh, submesh).triangleCount;
+					current.submesh = submesh;
+					last = -1;
+				}
+				if (current.triangleCount >= maxTriangles)
+				{
+					flush();
+				}
+
+				// the fewest new vertices, neighbours of the last triangle first and the whole meshlet unless they add none
+				int best = -1;
+				int bestCount = 4;
+				int bestLive = INT_MAX;
+				if (last >= 0)
+				{
+					for (int i = 0; i < 3; ++i) pick(indices[last * 3 + i], best, bestCount, bestLive);
+				}
+				if (bestCount > 0 && current.triangleCount > 0)
+				{
+					for (int i = 0; i < current.vertexCount; ++i) pick(build.vertices[current.vertexOffset + i], best, bestCount, bestLive);
+				}
+				if (best < 0)
+				{
+					while (emitted[cursor]) ++cursor;
+					best = cursor;
+					if (current.vertexCount + newVertices(best) > maxVertices)
+					{
+						flush();
+					}
+				}
+
+				const int* triangle = indices.data() + best * 3;
+				for (int i = 0; i < 3; ++i)
+				{
+					int& slot = slots[triangle[i]];
+					if (slot < 0)
+					{
+						slot = current.vertexCount++;
+						build.vertices.push_back(triangle[i]);
+					}
+					build.triangles.push_back(static_cast<unsigned char>(slot));
+					--live[triangle[i]];
+				}
+				++current.triangleCount;
+				emitted[best] = true;
+				last = best;
+			}
+			flush();
+			return true;
+		}
+
+		static void store_meshlets(Mesh* mesh, const MeshletBuild& build)
+		{
+			if (mesh->meshlets)
+			{
+				destroy_meshlet_table(mesh->meshlets);
+			}
+
+			MeshletTable* table = create_meshlet_table(static_cast<int>(build.meshlets.size()), static_cast<int>(build.vertices.size()), static_cast<int>(build.triangles.size() / 3), mesh);
+			if (table->meshletCount) memcpy(table->meshlets, build.meshlets.data(), sizeof(Meshlet) * table->meshletCount);
+			if (table->vertexCount) memcpy(table->vertices, build.vertices.data(), sizeof(int) * table->vertexCount);
+			if (table->triangleCount) memcpy(table->triangles, build.triangles.data(), build.triangles.size());
+			mesh->meshlets = table;
+		}
+
+		int mesh_build_meshlets(Mesh* instance, const int maxVertices, const int maxTriangles)
+		{
+			CHECK(instance && maxVertices >= 3 && maxVertices <= 256 && maxTriangles > 0, 0);
+
+			MeshletBuild build;
+			CHECK(build_meshlets(instance, maxVertices, maxTriangles, build), 0);
+			store_meshlets(instance, build);
+			return instance->meshlets->meshletCount;
+		}
+
+		void model_build_meshlets(Model* instance, const int maxVertices, const int maxTriangles, const std::atomic<bool>* cancelled)
+		{
+			CHECK(instance && maxVertices >= 3 && maxVertices <= 256 && maxTriangles > 0, );
+
+			std::vector<MeshletBuild> builds(instance->meshCount);
+			std::vector<char> built(instance->meshCount, 0);
+			parallel_for(instance->meshCount, [&](const int meshIndex)
+			{
+				if (cancelled && cancelled->load(std::memory_order_relaxed)) return;
+				built[meshIndex] = build_meshlets(instance->meshes[meshIndex], maxVertices, maxTriangles, builds[meshIndex]);
+			});
+
+			// storing allocates through models_*, so it stays on the calling thread
+			for (int meshIndex = 0; meshIndex < instance->meshCount; ++meshIndex)
+			{
+				if (built[meshIndex])
+				{
+					store_meshlets(instance->meshes[meshIndex], builds[meshIndex]);
+				}
+			}
+		}
+	}
+}
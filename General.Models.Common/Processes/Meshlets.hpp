@@ -0,0 +1,26 @@
+﻿#ifndef GENERAL_MODELS_COMMON_MESHLETS_HPP
+#define GENERAL_MODELS_COMMON_MESHLETS_HPP
+
+#include <atomic>
+
+namespace General
+{
+	namespace Models
+	{
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+		/// <summary>
+		/// rebuilds Mesh::meshlets, every meshlet grows over the triangles sharing most of its vertices and starts over
+		/// where the index buffer continues inside its submesh, so run it after the triangle order is final
+		/// </summary>
+		/// <param name="maxVertices">at most 256 so local indices fit a byte</param>
+		/// <returns>the meshlet count</returns>
+		EXPORT int mesh_build_meshlets(Mesh* instance, const int maxVertices, const int maxTriangles);
+		/// <summary>mesh_build_meshlets for every mesh, builds all meshes in parallel</summary>
+		/// <param name="cancelled">nullptr, or a flag that makes the meshes not started yet keep their old meshlets once it is set</param>
+		EXPORT void model_build_meshlets(Model* instance, const int maxVertices, const int maxTriangles, const std::atomic<bool>* cancelled);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_MESHLETS_HPP
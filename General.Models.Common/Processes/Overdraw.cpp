@@ -0,0 +1,236 @@
+﻿#include "pch.h"
+#include "Overdraw.hpp"
+
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+		struct OverdrawCache // FIFO post-transform cache, flushing only moves the clock
+		{
+			std::vector<int> stamps;
+			int clock;
+
+			OverdrawCache(const int vertexCount) : stamps(vertexCount, -VERTEX_CACHE_SIZE - 1), clock(0) { }
+
+			void flush()
+			{
+				clock += VERTEX_CACHE_SIZE + 1;
+			}
+
+			int misses(const int* triangle)
+			{
+				int count = 0;
+				for (int i = 0; i < 3; ++i)
+				{
+					int& stamp = stamps[triangle[i]];
+					if (clock - stamp > VERTEX_CACHE_SIZE)
+					{
+						stamp = clock++;
+						++count;
+					}
+				}
+				return count;
+			}
+		};
+
+		struct OverdrawCluster
+		{
+			int begin;
+			int end;
+			int submesh; // clusters only move inside their submesh
+			float key;
+		};
+
+		void optimize_overdraw(Mesh* instance, const float threshold)
+		{
+			CHECK(instance && threshold >= 1.0f, );
+
+			const int triangleCount = instance->triangleCount;
+			const int vertexCount = instance->vertexCount;
+			if (triangleCount < 2)
+			{
+				return;
+			}
+
+			std::vector<int> indices(triangleCount * 3);
+			mesh_copy_indices(instance, indices.data());
+			for (const int index : indices)
+			{
+				CHECK(index >= 0 && index < vertexCount, );
+			}
+
+			// a triangle missing all three vertices is where the cache optimizer jumped, so a hard boundary, and so is every submesh
+			std::vector<int> hardBoundaries;
+			std::vector<int> submeshes(triangleCount);
+			OverdrawCache cache(vertexCount);
+			for (int i = 0; i < mesh_get_submesh_count(instance); ++i)
+			{
+				const Submesh submesh = mesh_get_submesh(instance, i);
+				if (submesh.firstTriangle > 0 && submesh.triangleCount > 0)
+				{
+					hardBoundaries.push_back(submesh.firstTriangle);
+				}
+				std::fill(submeshes.begin() + submesh.firstTriangle, submeshes.begin() + submesh.firstTriangle + submesh.triangleCount, i);
+			}
+			for (int triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+			{
+				if (3 == cache.misses(indices.data() + triangleIndex * 3) && triangleIndex > 0 && submeshes[triangleIndex] == submeshes[triangleIndex - 1])
+				{
+					hardBoundaries.push_back(triangleIndex);
+				}
+			}
+			std::sort(hardBoundaries.begin(), hardBoundaries.end());
+			hardBoundaries.push_back(triangleCount);
+
+			// splits hard clusters further wherever the cut keeps the ACMR within threshold of the whole cluster
+			std::vector<OverdrawCluster> clusters;
+			int hardBegin = 0;
+			for (const int hardEnd : hardBoundaries)
+			{
+				cache.flush();
+				int hardMisses = 0;
+				for (int triangleIndex = hardBegin; triangleIndex < hardEnd; ++triangleIndex)
+				{
+					hardMisses += cache.misses(indices.data() + triangleIndex * 3);
+				}
+				const float acmr = static_cast<float>(hardMisses) / (hardEnd - hardBegin);
+
+				cache.flush();
+				OverdrawCluster cluster = { hardBegin, hardBegin, submeshes[hardBegin], .0f };
+				int misses = 0;
+				for (int triangleIndex = hardBegin; triangleIndex < hardEnd; ++triangleIndex)
+				{
+					misses += cache.misses(indices.data() + triangleIndex * 3);
+					cluster.end = triangleIndex + 1;
+					if (cluster.end < hardEnd && misses <= acmr * threshold * (cluster.end - cluster.begin))
+					{
+						clusters.push_back(cluster);
+						cache.flush();
+						cluster.begin = cluster.end;
+						misses = 0;
+					}
+				}
+				clusters.push_back(cluster);
+				hardBegin = hardEnd;
+			}
+
+			int stride;
+			const char* positions = reinterpret_cast<const char*>(mesh_get_positions(instance, &stride));
+			CHECK(positions, );
+			auto position = [positions, stride](const int vertexIndex) -> const Vector3&
+			{
+				return *reinterpret_cast<const Vector3*>(positions + static_cast<size_t>(stride) * vertexIndex);
+			};
+
+			// area weighted centroids and normals, the outer clusters facing away from the mesh center occlude the rest
+			std::vector<Vector3> centroids(clusters.size());
+			std::vector<Vector3> normals(clusters.size());
+			double meshCentroid[3] = { };
+			double meshArea = .0;
+			for (size_t clusterIndex = 0; clusterIndex < clusters.size(); ++clusterIndex)
+			{
+				const OverdrawCluster& cluster = clusters[clusterIndex];
+				double centroid[3] = { };
+				double normal[3] = { };
+				double area = .0;
+				for (int triangleIndex = cluster.begin; triangleIndex < cluster.end; ++triangleIndex)
+				{
+					const Vector3& p0 = position(indices[triangleIndex * 3]);
+					const Vector3& p1 = position(indices[triangleIndex * 3 + 1]);
+					const Vector3& p2 = position(indices[triangleIndex * 3 + 2]);
+					const double e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+					const double e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+					const double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+					const double a = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					for (int i = 0; i < 3; ++i)
+					{
+						centroid[i] += a * (p0.values[i] + p1.values[i] + p2.values[i]) / 3.0;
+						normal[i] += n[i];
+					}
+					area += a;
+				}
+
+				for (int i = 0; i < 3; ++i)
+				{
+					meshCentroid[i] += centroid[i];
+					centroids[clusterIndex].values[i] = static_cast<float>(area > .0 ? centroid[i] / area : .0);
+				}
+				meshArea += area;
+
+				const double length = sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+				for (int i = 0; i < 3; ++i)
+				{
+					normals[clusterIndex].values[i] = static_cast<float>(length > .0 ? normal[i] / length : .0);
+				}
+			}
+
+			for (size_t clusterIndex = 0; clusterIndex < clusters.size(); ++clusterIndex)
+			{
+				float key = .0f;
+				for (int i = 0; i < 3; ++i)
+				{
+					const float center = static_cast<float>(meshArea > .0 ? meshCentroid[i] / meshArea : .0);
+					key += (centroids[clusterIndex].values[i] - center) * normals[clusterIndex].values[i];
+				}
+				clusters[clusterIndex].key = key;
+			}
+			std::stable_sort(clusters.begin(), clusters.end(), [](const OverdrawCluster& a, const OverdrawCluster& b)
+			{
+				return a.submesh != b.submesh ? a.submesh < b.submesh : a.key > b.key;
+			});
+
+			std::vector<int> sorted;
+			sorted.reserve(indices.size());
+			for (const OverdrawCluster& cluster : clusters)
+			{
+				sorted.insert(sorted.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+			}
+			mesh_write_indices(instance, sorted.data());
+		}
+
+		void optimize_vertex_fetch(Mesh* instance)
+		{
+			CHECK(instance, );
+
+			const int vertexCount = instance->vertexCount;
+			const int indexCount = instance->triangleCount * 3;
+			std::vector<int> indices(indexCount);
+			mesh_copy_indices(instance, indices.data());
+
+			std::vector<int> remap(vertexCount, -1);
+			std::vector<int> sources;
+			sources.reserve(vertexCount);
+			for (const int index : indices)
+			{
+				CHECK(index >= 0 && index < vertexCount, );
+				if (remap[index] < 0)
+				{
+					remap[index] = static_cast<int>(sources.size());
+					sources.push_back(index);
+				}
+			}
+			for (int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+			{
+				if (remap[vertexIndex] < 0)
+				{
+					remap[vertexIndex] = static_cast<int>(sources.size());
+					sources.push_back(vertexIndex);
+				}
+			}
+
+			bool ordered = true;
+			for (int vertexIndex = 0; vertexIndex < vertexCount && ordered; ++vertexIndex)
+			{
+				ordered = vertexIndex == sources[vertexIndex];
+			}
+			if (ordered)
+			{
+				return;
+			}
+			mesh_gather_vertices(instance, sources.data(), vertexCount);
+			mesh_remap_indices(instance, remap.data());
+		}
+	}
+}
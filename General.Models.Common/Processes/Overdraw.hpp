@@ -0,0 +1,20 @@
+﻿#ifndef GENERAL_MODELS_COMMON_OVERDRAW_HPP
+#define GENERAL_MODELS_COMMON_OVERDRAW_HPP
+
+namespace General
+{
+	namespace Models
+	{
+#define OVERDRAW_THRESHOLD 1.05f // the ACMR a cluster may lose against its cache-optimized order
+
+		/// <summary>
+		/// splits the cache-optimized triangle order into clusters and draws the clusters facing away from the mesh center first,
+		/// run optimize_vertex_cache before, triangles stay inside their submesh, does not allocate through models_*
+		/// </summary>
+		/// <param name="threshold">how much worse than the cache order the ACMR may get, 1 keeps the cache order</param>
+		EXPORT void optimize_overdraw(Mesh* instance, const float threshold);
+		EXPORT void optimize_vertex_fetch(Mesh* instance); // renumbers the vertices in first use order of the index buffer, unused vertices go last
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_OVERDRAW_HPP
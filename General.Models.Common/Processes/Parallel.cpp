@@ -0,0 +1,164 @@
+﻿#include "pch.h"
+#include "Parallel.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace General
+{
+	namespace Models
+	{
+		int parallel_thread_count()
+		{
+			const unsigned int count = std::thread::hardware_concurrency();
+			return count > 0 ? static_cast<int>(count) : 1;
+		}
+
+		void parallel_for(const int count, const std::function<void(int)>& body)
+		{
+			CHECK(body, );
+
+			const int threadCount = std::min(parallel_thread_count(), count);
+			if (threadCount <= 1)
+			{
+				for (int i = 0; i < count; ++i)
+				{
+					body(i);
+				}
+				return;
+			}
+
+			// items are taken one by one, meshes differ too much in size for fixed chunks
+			std::atomic<int> next(0);
+			auto worker = [&]()
+			{
+				for (int i = next++; i < count; i = next++)
+				{
+					body(i);
+				}
+			};
+
+			std::vector<std::thread> threads;
+			threads.reserve(threadCount - 1);
+			for (int i = 1; i < threadCount; ++i)
+			{
+				threads.emplace_back(worker);
+			}
+			worker();
+			for (std::thread& thread : threads)
+			{
+				thread.join();
+			}
+		}
+
+		// one queue per worker, the owner runs its tasks oldest first and idle workers steal the newest ones, the owner would reach them last
+		class WorkerPool
+		{
+		private:
+			struct Queue
+			{
+				std::mutex mutex;
+				std::deque<std::function<void()>> tasks;
+			};
+
+			std::vector<std::unique_ptr<Queue>> mQueues;
+			std::atomic<unsigned int> mNextQueue;
+
+			std::mutex mSleepMutex;
+			std::condition_variable mSleepCondition;
+			int mPendingCount; // guarded by mSleepMutex
+
+			static thread_local int worker_index;
+		public:
+			WorkerPool(const int threadCount) : mNextQueue(0), mPendingCount(0)
+			{
+				for (int i = 0; i < threadCount; ++i)
+				{
+					mQueues.push_back(std::make_unique<Queue>());
+				}
+				// detached, joining from a static destructor would deadlock under the loader lock when the library unloads
+				for (int i = 0; i < threadCount; ++i)
+				{
+					std::thread(&WorkerPool::run, this, i).detach();
+				}
+			}
+
+			void Submit(const std::function<void()>& task)
+			{
+				// a worker keeps what it spawns, other threads deal round robin
+				const int index = worker_index >= 0 ? worker_index : static_cast<int>(mNextQueue++ % mQueues.size());
+				{
+					std::lock_guard<std::mutex> lock(mQueues[index]->mutex);
+					mQueues[index]->tasks.push_back(task);
+				}
+				{
+					std::lock_guard<std::mutex> lock(mSleepMutex);
+					++mPendingCount;
+				}
+				mSleepCondition.notify_one();
+			}
+		private:
+			bool take(const int index, std::function<void()>& task)
+			{
+				const int queueCount = static_cast<int>(mQueues.size());
+				for (int offset = 0; offset < queueCount; ++offset)
+				{
+					Queue& queue = *mQueues[(index + offset) % queueCount];
+					std::lock_guard<std::mutex> lock(queue.mutex);
+					if (queue.tasks.empty())
+					{
+						continue;
+					}
+
+					if (0 == offset)
+					{
+						task = std::move(queue.tasks.front());
+						queue.tasks.pop_front();
+					}
+					else
+					{
+						task = std::move(queue.tasks.back());
+						queue.tasks.pop_back();
+					}
+					return true;
+				}
+				return false;
+			}
+
+			void run(const int index)
+			{
+				worker_index = index;
+				for (;;)
+				{
+					{
+						std::unique_lock<std::mutex> lock(mSleepMutex);
+						mSleepCondition.wait(lock, [this]() { return mPendingCount > 0; });
+						--mPendingCount; // claims one queued task
+					}
+
+					// the claimed task is in some queue, though another worker may have stolen it and left this one another
+					std::function<void()> task;
+					while (!this->take(index, task))
+					{
+						std::this_thread::yield();
+					}
+					task();
+				}
+			}
+		};
+
+		thread_local int WorkerPool::worker_index = -1;
+
+		void parallel_submit(const std::function<void()>& task)
+		{
+			CHECK(task, );
+
+			static WorkerPool* pool = new WorkerPool(parallel_thread_count()); // never destroyed, see WorkerPool
+			pool->Submit(task);
+		}
+	}
+}
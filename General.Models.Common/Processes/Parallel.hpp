@@ -0,0 +1,31 @@
+﻿#ifndef GENERAL_MODELS_COMMON_PARALLEL_HPP
+#define GENERAL_MODELS_COMMON_PARALLEL_HPP
+
+#include <functional>
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* Runs body(0) .. body(count - 1) on up to one thread per core,
+		* the calling thread included, and returns when all are done.
+		* Workers are not bound to any model, so bodies must not allocate
+		* through models_*, they work on scratch memory and write results
+		* in place or hand them back to the calling thread.
+		* ***************************************************************/
+		EXPORT int parallel_thread_count();
+		EXPORT void parallel_for(const int count, const std::function<void(int)>& body);
+
+		/****************************************************************
+		* Queues a task on the library worker pool, one thread per core,
+		* started on the first call and kept until the process exits.
+		* Every worker runs its own queue oldest first and steals from
+		* the others when it runs dry, tasks submitted by a task stay on
+		* its worker. The same binding rules as parallel_for apply.
+		* ***************************************************************/
+		EXPORT void parallel_submit(const std::function<void()>& task);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_PARALLEL_HPP
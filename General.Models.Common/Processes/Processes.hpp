@@ -0,0 +1,13 @@
+﻿#ifndef GENERAL_MODELS_COMMON_PROCESSES_HPP
+#define GENERAL_MODELS_COMMON_PROCESSES_HPP
+
+#include "Parallel.hpp"
+#include "Weld.hpp"
+#include "Bounds.hpp"
+#include "VertexCache.hpp"
+#include "Overdraw.hpp"
+#include "Simplify.hpp"
+#include "Meshlets.hpp"
+#include "Batch.hpp"
+
+#endif // GENERAL_MODELS_COMMON_PROCESSES_HPP
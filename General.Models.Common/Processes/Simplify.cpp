@@ -0,0 +1,554 @@
+﻿#include "pch.h"
+#include "Simplify.hpp"
+
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+		enum SimplifyVertexKind
+		{
+			SIMPLIFY_VERTEX_MANIFOLD, // collapses onto any neighbour
+			SIMPLIFY_VERTEX_BORDER, // collapses along the open border only
+			SIMPLIFY_VERTEX_SEAM, // two vertices at one position, collapses with its twin along the seam
+			SIMPLIFY_VERTEX_LOCKED, // never collapses
+		};
+
+		static const double SIMPLIFY_EDGE_WEIGHT = 10.0; // how much more border and seam edges resist than faces
+
+		struct Quadric // sum of squared distances to weighted planes, x'Ax + 2b'x + c
+		{
+			double a00, a11, a22;
+			double a10, a20, a21;
+			double b0, b1, b2;
+			double c;
+			double w;
+		};
+
+		static void quadric_add(Quadric& q, const Quadric& r)
+		{
+			q.a00 += r.a00; q.a11 += r.a11; q.a22 += r.a22;
+			q.a10 += r.a10; q.a20 += r.a20; q.a21 += r.a21;
+			q.b0 += r.b0; q.b1 += r.b1; q.b2 += r.b2;
+			q.c += r.c;
+			q.w += r.w;
+		}
+
+		static Quadric quadric_from_plane(const double* n, const double d, const double w)
+		{
+			Quadric q;
+			q.a00 = w * n[0] * n[0]; q.a11 = w * n[1] * n[1]; q.a22 = w * n[2] * n[2];
+			q.a10 = w * n[1] * n[0]; q.a20 = w * n[2] * n[0]; q.a21 = w * n[2] * n[1];
+			q.b0 = w * n[0] * d; q.b1 = w * n[1] * d; q.b2 = w * n[2] * d;
+			q.c = w * d * d;
+			q.w = w;
+			return q;
+		}
+
+		static double quadric_error(const Quadric& q, const double* p)
+		{
+			const double x = p[0], y = p[1], z = p[2];
+			const double r = x * (q.a00 * x + q.a10 * y + q.a20 * z) + y * (q.a10 * x + q.a11 * y + q.a21 * z) + z * (q.a20 * x + q.a21 * y + q.a22 * z) + 2.0 * (q.b0 * x + q.b1 * y + q.b2 * z) + q.c;
+			return fabs(r) / (q.w > .0 ? q.w : 1.0); // mean squared distance
+		}
+
+		static void cross(const double* a, const double* b, double* r)
+		{
+			r[0] = a[1] * b[2] - a[2] * b[1];
+			r[1] = a[2] * b[0] - a[0] * b[2];
+			r[2] = a[0] * b[1] - a[1] * b[0];
+		}
+
+		struct SimplifyEdges // outgoing edges of every vertex, rebuilt from the current triangles
+		{
+			std::vector<int> offsets;
+			std::vector<int> targets;
+
+			void build(const int vertexCount, const int* indices, const int indexCount, const int* remap)
+			{
+				offsets.assign(vertexCount + 1, 0);
+				targets.resize(indexCount);
+				for (int i = 0; i < indexCount; ++i)
+				{
+					++offsets[(remap ? remap[indices[i]] : indices[i]) + 1];
+				}
+				for (int i = 0; i < vertexCount; ++i)
+				{
+					offsets[i + 1] += offsets[i];
+				}
+				std::vector<int> cursors(offsets.begin(), offsets.end() - 1);
+				for (int i = 0; i < indexCount; ++i)
+				{
+					const int next = i % 3 == 2 ? i - 2 : i + 1;
+					const int from = remap ? remap[indices[i]] : indices[i];
+					targets[cursors[from]++] = remap ? remap[indices[next]] : indices[next];
+				}
+			}
+
+			bool has(const int from, const int to) const
+			{
+				for (int i = offsets[from]; i < offsets[from + 1]; ++i)
+				{
+					if (to == targets[i]) return true;
+				}
+				return false;
+			}
+		};
+
+		struct SimplifyCollapse
+		{
+			int from;
+			int to;
+			int twinFrom; // -1 unless a seam collapses
+			int twinTo;
+			double error;
+		};
+
+		struct Simplifier
+		{
+			int vertexCount;
+			std::vector<double> positions; // normalized into the unit cube
+			std::vector<int> remap; // the first vertex at the same position
+			std::vector<int> wedges; // ring of the vertices at the same position
+			std::vector<unsigned char> kinds;
+			std::vector<Quadric> quadrics; // by remap
+
+			SimplifyEdges edges; // between vertices
+			SimplifyEdges positionEdges; // between positions
+			std::vector<int> adjacencyOffsets; // triangles of every vertex
+			std::vector<int> adjacency;
+
+			const double* position(const int vertexIndex) const
+			{
+				return positions.data() + static_cast<size_t>(vertexIndex) * 3;
+			}
+
+			void buildPositions(const Mesh* mesh)
+			{
+				int stride;
+				const char* source = reinterpret_cast<const char*>(mesh_get_positions(mesh, &stride));
+				double minimum[3] = { HUGE_VAL, HUGE_VAL, HUGE_VAL };
+				double maximum[3] = { -HUGE_VAL, -HUGE_VAL, -HUGE_VAL };
+				positions.resize(static_cast<size_t>(vertexCount) * 3);
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					const Vector3* p = reinterpret_cast<const Vector3*>(source + static_cast<size_t>(stride) * v);
+					for (int i = 0; i < 3; ++i)
+					{
+						positions[v * 3 + i] = p->values[i];
+						minimum[i] = std::min(minimum[i], static_cast<double>(p->values[i]));
+						maximum[i] = std::max(maximum[i], static_cast<double>(p->values[i]));
+					}
+				}
+				const double extent = std::max(std::max(maximum[0] - minimum[0], maximum[1] - minimum[1]), maximum[2] - minimum[2]);
+				const double scale = extent > .0 ? 1.0 / extent : .0;
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					for (int i = 0; i < 3; ++i)
+					{
+						positions[v * 3 + i] = (positions[v * 3 + i] - minimum[i]) * scale;
+					}
+				}
+
+				// vertices at one position become a ring, the first of them represents the position
+				std::vector<int> order(vertexCount);
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					order[v] = v;
+				}
+				const double* p = positions.data();
+				std::sort(order.begin(), order.end(), [p](const int a, const int b)
+				{
+					return std::lexicographical_compare(p + a * 3, p + a * 3 + 3, p + b * 3, p + b * 3 + 3);
+				});
+				remap.resize(vertexCount);
+				wedges.resize(vertexCount);
+				for (int begin = 0, end; begin < vertexCount; begin = end)
+				{
+					for (end = begin + 1; end < vertexCount && std::equal(p + order[begin] * 3, p + order[begin] * 3 + 3, p + order[end] * 3); ++end);
+					for (int i = begin; i < end; ++i)
+					{
+						remap[order[i]] = order[begin];
+						wedges[order[i]] = order[i + 1 < end ? i + 1 : begin];
+					}
+				}
+			}
+
+			void buildTopology(const int* indices, const int indexCount)
+			{
+				edges.build(vertexCount, indices, indexCount, nullptr);
+				positionEdges.build(vertexCount, indices, indexCount, remap.data());
+
+				adjacencyOffsets.assign(vertexCount + 1, 0);
+				adjacency.resize(indexCount);
+				for (int i = 0; i < indexCount; ++i)
+				{
+					++adjacencyOffsets[indices[i] + 1];
+				}
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				std::vector<int> cursors(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (int i = 0; i < indexCount; ++i)
+				{
+					adjacency[cursors[indices[i]]++] = i / 3;
+				}
+			}
+
+			void classify()
+			{
+				std::vector<bool> borders(vertexCount, false);
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					const int from = remap[v];
+					for (int i = positionEdges.offsets[v]; i < positionEdges.offsets[v + 1]; ++i)
+					{
+						if (!positionEdges.has(positionEdges.targets[i], from)) borders[from] = true;
+					}
+				}
+
+				kinds.resize(vertexCount);
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					int wedgeCount = 1;
+					for (int w = wedges[v]; w != v; w = wedges[w]) ++wedgeCount;
+
+					const bool border = borders[remap[v]];
+					if (1 == wedgeCount) kinds[v] = border ? SIMPLIFY_VERTEX_BORDER : SIMPLIFY_VERTEX_MANIFOLD;
+					else if (2 == wedgeCount && !border) kinds[v] = SIMPLIFY_VERTEX_SEAM;
+					else kinds[v] = SIMPLIFY_VERTEX_LOCKED;
+				}
+			}
+
+			void buildQuadrics(const int* indices, const int indexCount)
+			{
+				quadrics.assign(vertexCount, Quadric());
+				for (int i = 0; i < indexCount; i += 3)
+				{
+					const double* p0 = position(indices[i]);
+					const double* p1 = position(indices[i + 1]);
+					const double* p2 = position(indices[i + 2]);
+					const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					double n[3];
+					cross(e1, e2, n);
+					const double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+					if (length <= .0)
+					{
+						continue;
+					}
+					for (int k = 0; k < 3; ++k) n[k] /= length;
+
+					const Quadric q = quadric_from_plane(n, -(n[0] * p0[0] + n[1] * p0[1] + n[2] * p0[2]), length * .5);
+					for (int k = 0; k < 3; ++k)
+					{
+						quadric_add(quadrics[remap[indices[i + k]]], q);
+					}
+
+					// border and seam edges get a plane through the edge perpendicular to the face, so they keep their shape
+					for (int k = 0; k < 3; ++k)
+					{
+						const int a = indices[i + k];
+						const int b = indices[i + (k + 1) % 3];
+						const bool border = !positionEdges.has(remap[b], remap[a]);
+						const bool seam = !border && !edges.has(b, a);
+						if (!border && !seam)
+						{
+							continue;
+						}
+
+						const double* pa = position(a);
+						const double* pb = position(b);
+						const double edge[3] = { pb[0] - pa[0], pb[1] - pa[1], pb[2] - pa[2] };
+						double m[3];
+						cross(edge, n, m);
+						const double edgeLength = sqrt(m[0] * m[0] + m[1] * m[1] + m[2] * m[2]);
+						if (edgeLength <= .0)
+						{
+							continue;
+						}
+						for (int j = 0; j < 3; ++j) m[j] /= edgeLength;
+
+						const Quadric e = quadric_from_plane(m, -(m[0] * pa[0] + m[1] * pa[1] + m[2] * pa[2]), edgeLength * edgeLength * SIMPLIFY_EDGE_WEIGHT);
+						quadric_add(quadrics[remap[a]], e);
+						quadric_add(quadrics[remap[b]], e);
+					}
+				}
+			}
+
+			/// <returns>false if from may not collapse onto to</returns>
+			bool check(SimplifyCollapse& collapse) const
+			{
+				const int from = collapse.from;
+				const int to = collapse.to;
+				collapse.twinFrom = collapse.twinTo = -1;
+				if (remap[from] == remap[to])
+				{
+					return false;
+				}
+
+				switch (kinds[from])
+				{
+				case SIMPLIFY_VERTEX_MANIFOLD:
+					return true;
+				case SIMPLIFY_VERTEX_BORDER:
+					return SIMPLIFY_VERTEX_MANIFOLD != kinds[to] && (!positionEdges.has(remap[to], remap[from]) || !positionEdges.has(remap[from], remap[to]));
+				case SIMPLIFY_VERTEX_SEAM:
+				{
+					// the edge must run along the seam, and the twin must have a matching edge on the other side
+					if (SIMPLIFY_VERTEX_MANIFOLD == kinds[to] || SIMPLIFY_VERTEX_BORDER == kinds[to] || !edges.has(from, to) || edges.has(to, from))
+					{
+						return false;
+					}
+					const int twinFrom = wedges[from];
+					for (int twinTo = wedges[to]; twinTo != to; twinTo = wedges[twinTo])
+					{
+						if (edges.has(twinTo, twinFrom) && !edges.has(twinFrom, twinTo))
+						{
+							collapse.twinFrom = twinFrom;
+							collapse.twinTo = twinTo;
+							return true;
+						}
+					}
+					return false;
+				}
+				default:
+					return false;
+				}
+			}
+
+			bool flips(const int* indices, const int from, const int to) const
+			{
+				const double* target = position(to);
+				for (int i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; ++i)
+				{
+					const int* triangle = indices + adjacency[i] * 3;
+					if (remap[triangle[0]] == remap[to] || remap[triangle[1]] == remap[to] || remap[triangle[2]] == remap[to])
+					{
+						continue; // collapses away
+					}
+
+					const int k = triangle[0] == from ? 0 : triangle[1] == from ? 1 : 2;
+					const double* p0 = position(from);
+					const double* p1 = position(triangle[(k + 1) % 3]);
+					const double* p2 = position(triangle[(k + 2) % 3]);
+					const double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+					const double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+					const double f1[3] = { p1[0] - target[0], p1[1] - target[1], p1[2] - target[2] };
+					const double f2[3] = { p2[0] - target[0], p2[1] - target[1], p2[2] - target[2] };
+					double before[3], after[3];
+					cross(e1, e2, before);
+					cross(f1, f2, after);
+					if (before[0] * after[0] + before[1] * after[1] + before[2] * after[2] <= .0)
+					{
+						return true;
+					}
+				}
+				return false;
+			}
+		};
+
+		/// <summary>simplifies the triangles of one submesh in place, edges shared with other submeshes count as borders</summary>
+		/// <param name="resultError">raised to the squared error of the collapses</param>
+		static int simplify_triangles(Simplifier& simplifier, const LodTarget target, int* indices, const int sourceIndexCount, double* resultError)
+		{
+			const int targetIndexCount = static_cast<int>(sourceIndexCount / 3 * std::max(target.ratio, .0f)) * 3;
+			if (targetIndexCount >= sourceIndexCount)
+			{
+				return sourceIndexCount;
+			}
+
+			const int vertexCount = simplifier.vertexCount;
+			simplifier.buildTopology(indices, sourceIndexCount);
+			simplifier.classify();
+			simplifier.buildQuadrics(indices, sourceIndexCount);
+
+			const double errorLimit = static_cast<double>(target.error) * target.error;
+			int indexCount = sourceIndexCount;
+			std::vector<SimplifyCollapse> collapses;
+			std::vector<int> collapseMap(vertexCount);
+			std::vector<bool> locked(vertexCount);
+			while (indexCount > targetIndexCount)
+			{
+				if (indexCount < sourceIndexCount)
+				{
+					simplifier.buildTopology(indices, indexCount);
+				}
+
+				// the cheaper allowed direction of every edge
+				collapses.clear();
+				for (int i = 0; i < indexCount; ++i)
+				{
+					const int a = indices[i];
+					const int b = indices[i % 3 == 2 ? i - 2 : i + 1];
+					SimplifyCollapse forward = { a, b, -1, -1, HUGE_VAL };
+					SimplifyCollapse backward = { b, a, -1, -1, HUGE_VAL };
+					if (simplifier.check(forward)) forward.error = quadric_error(simplifier.quadrics[simplifier.remap[a]], simplifier.position(b));
+					if (simplifier.check(backward)) backward.error = quadric_error(simplifier.quadrics[simplifier.remap[b]], simplifier.position(a));
+					const SimplifyCollapse& best = forward.error <= backward.error ? forward : backward;
+					if (best.error <= errorLimit) collapses.push_back(best);
+				}
+				if (collapses.empty())
+				{
+					break;
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const SimplifyCollapse& a, const SimplifyCollapse& b) { return a.error < b.error; });
+
+				// a collapse removes about two triangles, leave the expensive ones of this pass for the next with fresh quadrics
+				const size_t goal = std::max<size_t>(1, (indexCount - targetIndexCount) / 6);
+				const double passLimit = collapses[std::min(goal, collapses.size()) - 1].error * 1.5;
+				for (int v = 0; v < vertexCount; ++v)
+				{
+					collapseMap[v] = v;
+				}
+				locked.assign(vertexCount, false);
+				size_t collapseCount = 0;
+				for (const SimplifyCollapse& collapse : collapses)
+				{
+					if (collapseCount >= goal || collapse.error > passLimit)
+					{
+						break;
+					}
+					const int from = simplifier.remap[collapse.from];
+					const int to = simplifier.remap[collapse.to];
+					if (locked[from] || locked[to] || simplifier.flips(indices, collapse.from, collapse.to) || (collapse.twinFrom >= 0 && simplifier.flips(indices, collapse.twinFrom, collapse.twinTo)))
+					{
+						continue;
+					}
+
+					collapseMap[collapse.from] = collapse.to;
+					if (collapse.twinFrom >= 0) collapseMap[collapse.twinFrom] = collapse.twinTo;
+					quadric_add(simplifier.quadrics[to], simplifier.quadrics[from]);
+					locked[from] = locked[to] = true;
+					*resultError = std::max(*resultError, collapse.error);
+					++collapseCount;
+				}
+				if (0 == collapseCount)
+				{
+					break;
+				}
+
+				int write = 0;
+				for (int i = 0; i < indexCount; i += 3)
+				{
+					const int a = collapseMap[indices[i]];
+					const int b = collapseMap[indices[i + 1]];
+					const int c = collapseMap[indices[i + 2]];
+					const int* r = simplifier.remap.data();
+					if (r[a] == r[b] || r[b] == r[c] || r[c] == r[a])
+					{
+						continue;
+					}
+					indices[write++] = a;
+					indices[write++] = b;
+					indices[write++] = c;
+				}
+				indexCount = write;
+			}
+			return indexCount;
+		}
+
+		// submeshes receives the ranges of the result if not nullptr, one per submesh of the mesh
+		static int simplify_mesh(const Mesh* instance, const LodTarget target, int* indices, Submesh* submeshes, float* error)
+		{
+			const int submeshCount = mesh_get_submesh_count(instance);
+			for (int i = 0; i < submeshCount && submeshes; ++i)
+			{
+				submeshes[i] = mesh_get_submesh(instance, i);
+			}
+
+			const int sourceIndexCount = instance->triangleCount * 3;
+			mesh_copy_indices(instance, indices);
+			const int targetIndexCount = static_cast<int>(instance->triangleCount * std::max(target.ratio, .0f)) * 3;
+			if (targetIndexCount >= sourceIndexCount || !mesh_get_positions(instance, nullptr))
+			{
+				return sourceIndexCount;
+			}
+			for (int i = 0; i < sourceIndexCount; ++i)
+			{
+				CHECK(indices[i] >= 0 && indices[i] < instance->vertexCount, sourceIndexCount);
+			}
+
+			Simplifier simplifier;
+			simplifier.vertexCount = instance->vertexCount;
+			simplifier.buildPositions(instance);
+
+			// every submesh keeps its own share of the triangles, the ranges move down as the ones before them shrink
+			double resultError = .0;
+			int indexCount = 0;
+			for (int i = 0; i < submeshCount; ++i)
+			{
+				const Submesh submesh = mesh_get_submesh(instance, i);
+				int* range = indices + submesh.firstTriangle * 3;
+				const int rangeCount = simplify_triangles(simplifier, target, range, submesh.triangleCount * 3, &resultError);
+				memmove(indices + indexCount, range, sizeof(int) * rangeCount);
+				if (submeshes)
+				{
+					submeshes[i].firstTriangle = indexCount / 3;
+					submeshes[i].triangleCount = rangeCount / 3;
+				}
+				indexCount += rangeCount;
+			}
+
+			if (error) *error = static_cast<float>(sqrt(resultError));
+			return indexCount;
+		}
+
+		int mesh_simplify(const Mesh* instance, const LodTarget target, int* indices, float* error)
+		{
+			if (error) *error = .0f;
+			CHECK(instance && indices, 0);
+			return simplify_mesh(instance, target, indices, nullptr, error);
+		}
+
+		static void generate_lods(Mesh** meshes, const int meshCount, const LodTarget* targets, const int count, const std::atomic<bool>* cancelled)
+		{
+			// every level is simplified from the full mesh, so meshes and levels are independent jobs
+			const int jobCount = meshCount * count;
+			std::vector<std::vector<int>> results(jobCount);
+			std::vector<std::vector<Submesh>> resultSubmeshes(jobCount);
+			std::vector<float> errors(jobCount);
+			std::vector<char> done(jobCount, 0);
+			parallel_for(jobCount, [&](const int job)
+			{
+				if (cancelled && cancelled->load(std::memory_order_relaxed)) return;
+				const Mesh* mesh = meshes[job / count];
+				std::vector<int>& result = results[job];
+				result.resize(static_cast<size_t>(mesh->triangleCount) * 3);
+				resultSubmeshes[job].resize(mesh_get_submesh_count(mesh));
+				errors[job] = .0f;
+				result.resize(simplify_mesh(mesh, targets[job % count], result.data(), resultSubmeshes[job].data(), &errors[job]));
+				done[job] = 1;
+			});
+
+			// storing allocates through models_*, so it stays on the calling thread
+			for (int meshIndex = 0; meshIndex < meshCount; ++meshIndex)
+			{
+				Mesh* mesh = meshes[meshIndex];
+				if (std::count(done.begin() + meshIndex * count, done.begin() + (meshIndex + 1) * count, 0)) continue;
+				mesh_set_lod_count(mesh, 0);
+				mesh_set_lod_count(mesh, count);
+				for (int level = 0; level < count; ++level)
+				{
+					const std::vector<int>& result = results[meshIndex * count + level];
+					mesh_set_lod(mesh, level, errors[meshIndex * count + level], static_cast<int>(result.size() / 3), reinterpret_cast<const Triangle*>(result.data()));
+					if (mesh->submeshCount) mesh_set_lod_submeshes(mesh, level, resultSubmeshes[meshIndex * count + level].data());
+				}
+			}
+		}
+
+		void mesh_generate_lods(Mesh* instance, const LodTarget* targets, const int count)
+		{
+			CHECK(instance && (targets || 0 == count) && count >= 0, );
+			generate_lods(&instance, 1, targets, count, nullptr);
+		}
+
+		void model_generate_lods(Model* instance, const LodTarget* targets, const int count, const std::atomic<bool>* cancelled)
+		{
+			CHECK(instance && (targets || 0 == count) && count >= 0, );
+			generate_lods(instance->meshes, instance->meshCount, targets, count, cancelled);
+		}
+	}
+}
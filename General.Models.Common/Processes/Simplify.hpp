@@ -0,0 +1,36 @@
+﻿#ifndef GENERAL_MODELS_COMMON_SIMPLIFY_HPP
+#define GENERAL_MODELS_COMMON_SIMPLIFY_HPP
+
+#include <atomic>
+
+namespace General
+{
+	namespace Models
+	{
+		struct LodTarget // simplification stops at whichever limit it reaches first
+		{
+			float ratio; // triangles to keep relative to the full mesh, 0 to only limit the error
+			float error; // deviation allowed relative to the mesh extent, 1 to only limit the triangle count
+		};
+
+		/****************************************************************
+		* Quadric error edge collapse. Vertices only collapse onto other
+		* existing vertices, so every level keeps the attributes and the
+		* skin of the vertices it uses. Border vertices only move along
+		* the border, vertices on uv or normal seams collapse together
+		* with their twin along the seam, anything more complex is kept.
+		* Every submesh is simplified on its own and keeps its material.
+		* ***************************************************************/
+
+		/// <param name="indices">receives up to triangleCount * 3 indices</param>
+		/// <param name="error">receives the deviation of the result relative to the mesh extent, may be nullptr</param>
+		/// <returns>the index count of the simplified triangles</returns>
+		EXPORT int mesh_simplify(const Mesh* instance, const LodTarget target, int* indices, float* error);
+		EXPORT void mesh_generate_lods(Mesh* instance, const LodTarget* targets, const int count); // replaces Mesh::lods, one level per target
+		/// <summary>mesh_generate_lods for every mesh, simplifies all meshes and levels in parallel</summary>
+		/// <param name="cancelled">nullptr, or a flag that makes the meshes not finished yet keep their old levels once it is set</param>
+		EXPORT void model_generate_lods(Model* instance, const LodTarget* targets, const int count, const std::atomic<bool>* cancelled);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_SIMPLIFY_HPP
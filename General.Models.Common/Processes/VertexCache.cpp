@@ -0,0 +1,247 @@
+﻿#include "pch.h"
+#include "VertexCache.hpp"
+
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+		VertexCacheStats mesh_analyze_vertex_cache(const Mesh* instance, const int cacheSize)
+		{
+			VertexCacheStats stats = { };
+			CHECK(instance && cacheSize > 0, stats);
+
+			const int indexCount = instance->triangleCount * 3;
+			std::vector<int> indices(indexCount);
+			mesh_copy_indices(instance, indices.data());
+
+			// a vertex is cached while fewer than cacheSize misses happened after its own one
+			std::vector<int> stamps(instance->vertexCount, -1);
+			for (int i = 0; i < indexCount; ++i)
+			{
+				const int vertexIndex = indices[i];
+				if (vertexIndex < 0 || vertexIndex >= instance->vertexCount)
+				{
+					continue;
+				}
+
+				int& stamp = stamps[vertexIndex];
+				if (stamp < 0)
+				{
+					++stats.vertexCount;
+				}
+				if (stamp < 0 || stats.transformCount - stamp > cacheSize)
+				{
+					stamp = stats.transformCount++;
+				}
+			}
+
+			stats.triangleCount = instance->triangleCount;
+			stats.acmr = stats.triangleCount ? static_cast<float>(stats.transformCount) / stats.triangleCount : .0f;
+			stats.atvr = stats.vertexCount ? static_cast<float>(stats.transformCount) / stats.vertexCount : .0f;
+			return stats;
+		}
+
+		void vertex_cache_stats_add(VertexCacheStats* instance, const VertexCacheStats* stats)
+		{
+			CHECK(instance && stats, );
+
+			instance->triangleCount += stats->triangleCount;
+			instance->vertexCount += stats->vertexCount;
+			instance->transformCount += stats->transformCount;
+			instance->acmr = instance->triangleCount ? static_cast<float>(instance->transformCount) / instance->triangleCount : .0f;
+			instance->atvr = instance->vertexCount ? static_cast<float>(instance->transformCount) / instance->vertexCount : .0f;
+		}
+
+		// the constants of Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+		static const int FORSYTH_CACHE_SIZE = 32;
+		static const float FORSYTH_LAST_TRIANGLE_SCORE = .75f;
+		static const float FORSYTH_CACHE_DECAY_POWER = 1.5f;
+		static const float FORSYTH_VALENCE_BOOST_SCALE = 2.0f;
+		static const float FORSYTH_VALENCE_BOOST_POWER = .5f;
+		static const int FORSYTH_VALENCE_TABLE_SIZE = 32;
+
+		struct ForsythScores
+		{
+			float cache[FORSYTH_CACHE_SIZE];
+			float valence[FORSYTH_VALENCE_TABLE_SIZE];
+
+			ForsythScores()
+			{
+				for (int i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+				{
+					// the three vertices of the last triangle get a fixed score so the next one does not reuse all of them
+					cache[i] = i < 3 ? FORSYTH_LAST_TRIANGLE_SCORE : powf(1.0f - static_cast<float>(i - 3) / (FORSYTH_CACHE_SIZE - 3), FORSYTH_CACHE_DECAY_POWER);
+				}
+				valence[0] = .0f;
+				for (int i = 1; i < FORSYTH_VALENCE_TABLE_SIZE; ++i)
+				{
+					valence[i] = FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(i), -FORSYTH_VALENCE_BOOST_POWER);
+				}
+			}
+
+			float score(const int cachePosition, const int remaining) const
+			{
+				if (0 == remaining)
+				{
+					return -1.0f; // nothing left to draw with this vertex
+				}
+
+				const float valenceScore = remaining < FORSYTH_VALENCE_TABLE_SIZE ? valence[remaining] : FORSYTH_VALENCE_BOOST_SCALE * powf(static_cast<float>(remaining), -FORSYTH_VALENCE_BOOST_POWER);
+				return (cachePosition < 0 ? .0f : cache[cachePosition]) + valenceScore;
+			}
+		};
+
+		// reorders the triangleCount triangles at indices into optimized, the indices are already validated
+		static void optimize_triangles(const int* indices, const int triangleCount, const int vertexCount, int* optimized)
+		{
+			static const ForsythScores scores;
+			const int indexCount = triangleCount * 3;
+			if (triangleCount < 2)
+			{
+				memcpy(optimized, indices, sizeof(int) * indexCount);
+				return;
+			}
+
+			// triangles of every vertex, the first remaining[v] ones are not emitted yet
+			std::vector<int> offsets(vertexCount + 1, 0);
+			for (int i = 0; i < indexCount; ++i)
+			{
+				++offsets[indices[i] + 1];
+			}
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				offsets[i + 1] += offsets[i];
+			}
+			std::vector<int> adjacency(indexCount);
+			std::vector<int> remaining(vertexCount, 0);
+			for (int triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+			{
+				for (int i = 0; i < 3; ++i)
+				{
+					const int vertexIndex = indices[triangleIndex * 3 + i];
+					adjacency[offsets[vertexIndex] + remaining[vertexIndex]++] = triangleIndex;
+				}
+			}
+
+			std::vector<int> cachePositions(vertexCount, -1);
+			std::vector<float> vertexScores(vertexCount);
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				vertexScores[i] = scores.score(-1, remaining[i]);
+			}
+
+			std::vector<float> triangleScores(triangleCount);
+			std::vector<bool> emitted(triangleCount, false);
+			int best = 0;
+			for (int triangleIndex = 0; triangleIndex < triangleCount; ++triangleIndex)
+			{
+				const int* triangle = indices + triangleIndex * 3;
+				triangleScores[triangleIndex] = vertexScores[triangle[0]] + vertexScores[triangle[1]] + vertexScores[triangle[2]];
+				if (triangleScores[triangleIndex] > triangleScores[best]) best = triangleIndex;
+			}
+
+			int cache[FORSYTH_CACHE_SIZE + 3];
+			int cacheCount = 0;
+			int cursor = 0; // every triangle before it is emitted
+			for (int outputIndex = 0; outputIndex < triangleCount; ++outputIndex)
+			{
+				if (best < 0)
+				{
+					// the cache ran dry, continue with the first triangle left in authoring order
+					while (emitted[cursor]) ++cursor;
+					best = cursor;
+				}
+
+				const int* triangle = indices + best * 3;
+				memcpy(optimized + outputIndex * 3, triangle, sizeof(int) * 3);
+				emitted[best] = true;
+
+				int newCache[FORSYTH_CACHE_SIZE + 3];
+				int newCount = 0;
+				for (int i = 0; i < 3; ++i)
+				{
+					const int vertexIndex = triangle[i];
+					int* begin = adjacency.data() + offsets[vertexIndex];
+					int* end = begin + remaining[vertexIndex];
+					int* found = std::find(begin, end, best);
+					std::swap(*found, *(end - 1));
+					--remaining[vertexIndex];
+					if (0 == i || (vertexIndex != newCache[newCount - 1] && vertexIndex != newCache[0])) newCache[newCount++] = vertexIndex; // degenerate triangles repeat a vertex
+				}
+				for (int i = 0; i < cacheCount; ++i)
+				{
+					const int vertexIndex = cache[i];
+					if (vertexIndex != triangle[0] && vertexIndex != triangle[1] && vertexIndex != triangle[2])
+					{
+						newCache[newCount++] = vertexIndex;
+					}
+				}
+
+				// rescore the cached vertices and the triangles they still take part in, then pick the best of those
+				for (int i = 0; i < newCount; ++i)
+				{
+					const int vertexIndex = newCache[i];
+					cachePositions[vertexIndex] = i < FORSYTH_CACHE_SIZE ? i : -1;
+					const float score = scores.score(cachePositions[vertexIndex], remaining[vertexIndex]);
+					const float delta = score - vertexScores[vertexIndex];
+					vertexScores[vertexIndex] = score;
+
+					const int* adjacent = adjacency.data() + offsets[vertexIndex];
+					for (int j = 0; j < remaining[vertexIndex]; ++j)
+					{
+						triangleScores[adjacent[j]] += delta;
+					}
+				}
+				best = -1;
+				float bestScore = -1.0f;
+				for (int i = 0; i < newCount && i < FORSYTH_CACHE_SIZE; ++i)
+				{
+					const int vertexIndex = newCache[i];
+					const int* adjacent = adjacency.data() + offsets[vertexIndex];
+					for (int j = 0; j < remaining[vertexIndex]; ++j)
+					{
+						if (triangleScores[adjacent[j]] > bestScore)
+						{
+							bestScore = triangleScores[adjacent[j]];
+							best = adjacent[j];
+						}
+					}
+				}
+
+				cacheCount = std::min(newCount, FORSYTH_CACHE_SIZE);
+				memcpy(cache, newCache, sizeof(int) * cacheCount);
+			}
+		}
+
+		void optimize_vertex_cache(Mesh* instance)
+		{
+			CHECK(instance, );
+
+			const int triangleCount = instance->triangleCount;
+			const int vertexCount = instance->vertexCount;
+			if (triangleCount < 2)
+			{
+				return;
+			}
+
+			std::vector<int> indices(triangleCount * 3);
+			mesh_copy_indices(instance, indices.data());
+			for (const int index : indices)
+			{
+				CHECK(index >= 0 && index < vertexCount, );
+			}
+
+			// every submesh is its own draw call, triangles never move across their ranges
+			std::vector<int> optimized(indices.size());
+			for (int i = 0; i < mesh_get_submesh_count(instance); ++i)
+			{
+				const Submesh submesh = mesh_get_submesh(instance, i);
+				const int offset = submesh.firstTriangle * 3;
+				optimize_triangles(indices.data() + offset, submesh.triangleCount, vertexCount, optimized.data() + offset);
+			}
+			mesh_write_indices(instance, optimized.data());
+		}
+	}
+}
@@ -0,0 +1,26 @@
+﻿#ifndef GENERAL_MODELS_COMMON_VERTEX_CACHE_HPP
+#define GENERAL_MODELS_COMMON_VERTEX_CACHE_HPP
+
+namespace General
+{
+	namespace Models
+	{
+#define VERTEX_CACHE_SIZE 16 // FIFO entries of the simulated post-transform cache
+
+		struct VertexCacheStats
+		{
+			int triangleCount;
+			int vertexCount; // vertices referenced by at least one triangle
+			int transformCount; // cache misses, the vertices the GPU shades
+
+			float acmr; // average cache miss ratio, transformCount / triangleCount, 0.5 at best and 3 at worst
+			float atvr; // average transformed vertex ratio, transformCount / vertexCount, 1 at best
+		};
+
+		EXPORT VertexCacheStats mesh_analyze_vertex_cache(const Mesh* instance, const int cacheSize);
+		EXPORT void vertex_cache_stats_add(VertexCacheStats* instance, const VertexCacheStats* stats); // sums the counts and updates the ratios
+		EXPORT void optimize_vertex_cache(Mesh* instance); // reorders the triangles for post-transform cache reuse with Forsyth's linear-speed algorithm inside every submesh, does not allocate through models_*
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_VERTEX_CACHE_HPP
@@ -0,0 +1,320 @@
+﻿#include "pch.h"
+#include "Weld.hpp"
+
+#include <math.h>
+
+namespace General
+{
+	namespace Models
+	{
+#define WELD_CHUNK_SIZE 4096 // vertices hashed by one parallel job
+
+		template <typename T> static void gather_array(const Mesh* instance, T** array, const int* sources, const int count)
+		{
+			if (nullptr == *array)
+			{
+				return;
+			}
+
+			T* gathered = models_copy_array<T>(instance, nullptr, count);
+			const T* source = *array;
+			for (int i = 0; i < count; ++i)
+			{
+				gathered[i] = source[sources[i]];
+			}
+			models_free(*array);
+			*array = gathered;
+		}
+
+		static void gather_skin(Mesh* instance, const int* sources, const int count)
+		{
+			const SkinTable* skin = instance->skin;
+			int influenceCount = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				if (sources[i] < skin->vertexCount) influenceCount += skin->offsets[sources[i] + 1] - skin->offsets[sources[i]];
+			}
+
+			SkinTable* gathered = create_skin_table(count, influenceCount, instance);
+			int cursor = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				gathered->offsets[i] = cursor;
+				if (sources[i] >= skin->vertexCount)
+				{
+					continue;
+				}
+
+				const int begin = skin->offsets[sources[i]];
+				const int length = skin->offsets[sources[i] + 1] - begin;
+				memcpy(gathered->influences + cursor, skin->influences + begin, sizeof(SkinInfluence) * length);
+				cursor += length;
+			}
+			gathered->offsets[count] = cursor;
+
+			destroy_skin_table(instance->skin);
+			instance->skin = gathered;
+			mesh_write_skin(instance);
+		}
+
+		void mesh_gather_vertices(Mesh* instance, const int* sources, const int count)
+		{
+			CHECK(instance && (sources || 0 == count) && count >= 0, );
+
+			for (int i = 0; i < count; ++i)
+			{
+				CHECK(sources[i] >= 0 && sources[i] < instance->vertexCount, );
+			}
+
+			gather_array(instance, &instance->vertices, sources, count);
+			gather_array(instance, &instance->positions, sources, count);
+			gather_array(instance, &instance->normals, sources, count);
+			for (int i = 0; i < 4; ++i)
+			{
+				gather_array(instance, instance->uvs + i, sources, count);
+			}
+
+			if (instance->weightCollectionCount && !instance->skin)
+			{
+				mesh_build_skin(instance);
+			}
+			if (instance->skin)
+			{
+				gather_skin(instance, sources, count);
+			}
+			instance->vertexCount = count;
+			instance->boundsValid = false;
+		}
+
+		void mesh_remap_indices(Mesh* instance, const int* remap)
+		{
+			CHECK(instance && remap, );
+
+			for (int level = 0; level < instance->lodCount; ++level)
+			{
+				const MeshLod* lod = instance->lods + level;
+				int* indices = lod->triangles ? lod->triangles->indices : nullptr;
+				for (int i = 0; i < lod->triangleCount * 3; ++i)
+				{
+					indices[i] = remap[indices[i]];
+				}
+			}
+
+			if (instance->meshlets)
+			{
+				MeshletTable* meshlets = instance->meshlets;
+				for (int i = 0; i < meshlets->vertexCount; ++i)
+				{
+					meshlets->vertices[i] = remap[meshlets->vertices[i]];
+				}
+			}
+
+			const int indexCount = instance->triangleCount * 3;
+			if (INDEX_FORMAT_32 == instance->indexFormat)
+			{
+				int* indices = instance->triangles ? instance->triangles->indices : nullptr;
+				for (int i = 0; i < indexCount; ++i)
+				{
+					indices[i] = remap[indices[i]];
+				}
+				return;
+			}
+
+			// mesh_set_index widens the whole mesh the first time a value does not fit
+			for (int i = 0; i < indexCount; ++i)
+			{
+				mesh_set_index(instance, i, remap[mesh_get_index(instance, i)]);
+			}
+		}
+
+		void unweld_mesh(Mesh* instance)
+		{
+			CHECK(instance, );
+
+			const int cornerCount = instance->triangleCount * 3;
+			std::vector<int> corners(cornerCount);
+			mesh_copy_indices(instance, corners.data());
+			mesh_gather_vertices(instance, corners.data(), cornerCount);
+			for (int i = 0; i < cornerCount; ++i)
+			{
+				mesh_set_index(instance, i, i); // keeps the index format unless the corners need wider indices
+			}
+		}
+
+		struct WeldChannel
+		{
+			const float* values;
+			int stride; // in floats
+			int size;
+		};
+
+		struct WeldVertices
+		{
+			int channelCount;
+			WeldChannel channels[6];
+			const SkinTable* skin;
+			float scale; // 1 / epsilon, 0 to compare the exact bits
+
+			// the nearest multiple of epsilon, neighbouring cells are not searched, see weld_mesh
+			unsigned int quantize(const float value) const
+			{
+				if (scale > .0f)
+				{
+					return static_cast<unsigned int>(static_cast<long long>(floorf(value * scale + .5f)));
+				}
+				unsigned int bits;
+				const float v = .0f == value ? .0f : value; // -0 equals 0
+				memcpy(&bits, &v, sizeof(bits));
+				return bits;
+			}
+
+			unsigned int hash(const int vertexIndex) const
+			{
+				unsigned int h = 2166136261u;
+				for (int c = 0; c < channelCount; ++c)
+				{
+					const float* values = channels[c].values + static_cast<size_t>(channels[c].stride) * vertexIndex;
+					for (int i = 0; i < channels[c].size; ++i)
+					{
+						h = (h ^ quantize(values[i])) * 16777619u;
+					}
+				}
+				if (skin && vertexIndex < skin->vertexCount)
+				{
+					for (int i = skin->offsets[vertexIndex]; i < skin->offsets[vertexIndex + 1]; ++i)
+					{
+						h = (h ^ static_cast<unsigned int>(skin->influences[i].collection)) * 16777619u;
+						h = (h ^ quantize(skin->influences[i].weight)) * 16777619u;
+					}
+				}
+				return h ^ (h >> 15);
+			}
+
+			bool equals(const int a, const int b) const
+			{
+				for (int c = 0; c < channelCount; ++c)
+				{
+					const float* va = channels[c].values + static_cast<size_t>(channels[c].stride) * a;
+					const float* vb = channels[c].values + static_cast<size_t>(channels[c].stride) * b;
+					for (int i = 0; i < channels[c].size; ++i)
+					{
+						if (quantize(va[i]) != quantize(vb[i])) return false;
+					}
+				}
+				if (nullptr == skin)
+				{
+					return true;
+				}
+
+				const int countA = a < skin->vertexCount ? skin->offsets[a + 1] - skin->offsets[a] : 0;
+				const int countB = b < skin->vertexCount ? skin->offsets[b + 1] - skin->offsets[b] : 0;
+				if (countA != countB)
+				{
+					return false;
+				}
+				for (int i = 0; i < countA; ++i)
+				{
+					const SkinInfluence& ia = skin->influences[skin->offsets[a] + i];
+					const SkinInfluence& ib = skin->influences[skin->offsets[b] + i];
+					if (ia.collection != ib.collection || quantize(ia.weight) != quantize(ib.weight)) return false;
+				}
+				return true;
+			}
+		};
+
+		static void add_weld_channel(WeldVertices& vertices, const void* values, const int stride, const int size)
+		{
+			if (values)
+			{
+				WeldChannel& channel = vertices.channels[vertices.channelCount++];
+				channel.values = static_cast<const float*>(values);
+				channel.stride = stride;
+				channel.size = size;
+			}
+		}
+
+		int weld_mesh(Mesh* instance, const float epsilon)
+		{
+			CHECK(instance, 0);
+
+			const int vertexCount = instance->vertexCount;
+			if (vertexCount < 2)
+			{
+				return vertexCount;
+			}
+			if (instance->weightCollectionCount && !instance->skin)
+			{
+				mesh_build_skin(instance);
+			}
+
+			WeldVertices vertices = { };
+			vertices.skin = instance->skin;
+			vertices.scale = epsilon > .0f ? 1.0f / epsilon : .0f;
+			if (instance->vertices)
+			{
+				add_weld_channel(vertices, instance->vertices, sizeof(Vertex) / sizeof(float), sizeof(Vertex) / sizeof(float));
+			}
+			add_weld_channel(vertices, instance->positions, 3, 3);
+			add_weld_channel(vertices, instance->normals, 3, 3);
+			for (int i = 0; i < 4; ++i)
+			{
+				add_weld_channel(vertices, instance->uvs[i], 2, 2);
+			}
+
+			// every hash only reads its own vertex, so chunks of them run on all cores
+			std::vector<unsigned int> hashes(vertexCount);
+			parallel_for((vertexCount + WELD_CHUNK_SIZE - 1) / WELD_CHUNK_SIZE, [&](const int chunk)
+			{
+				const int end = std::min(vertexCount, (chunk + 1) * WELD_CHUNK_SIZE);
+				for (int i = chunk * WELD_CHUNK_SIZE; i < end; ++i)
+				{
+					hashes[i] = vertices.hash(i);
+				}
+			});
+
+			int slotCount = 1;
+			while (slotCount < vertexCount * 2)
+			{
+				slotCount <<= 1;
+			}
+			const unsigned int mask = static_cast<unsigned int>(slotCount - 1);
+			std::vector<int> slots(slotCount, -1); // the first vertex of every unique tuple
+			std::vector<int> remap(vertexCount);
+			std::vector<int> sources;
+			sources.reserve(vertexCount);
+			for (int i = 0; i < vertexCount; ++i)
+			{
+				unsigned int slot = hashes[i] & mask;
+				while (-1 != slots[slot])
+				{
+					const int first = slots[slot];
+					if (hashes[first] == hashes[i] && vertices.equals(first, i))
+					{
+						break;
+					}
+					slot = (slot + 1) & mask;
+				}
+
+				if (-1 == slots[slot])
+				{
+					slots[slot] = i;
+					remap[i] = static_cast<int>(sources.size());
+					sources.push_back(i);
+				}
+				else
+				{
+					remap[i] = remap[slots[slot]];
+				}
+			}
+
+			const int uniqueCount = static_cast<int>(sources.size());
+			if (uniqueCount == vertexCount)
+			{
+				return vertexCount;
+			}
+			mesh_gather_vertices(instance, sources.data(), uniqueCount);
+			mesh_remap_indices(instance, remap.data());
+			return uniqueCount;
+		}
+	}
+}
@@ -0,0 +1,22 @@
+﻿#ifndef GENERAL_MODELS_COMMON_WELD_HPP
+#define GENERAL_MODELS_COMMON_WELD_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		EXPORT void mesh_gather_vertices(Mesh* instance, const int* sources, const int count); // vertex i of the result copies vertex sources[i] with its skin, indices are left untouched
+		EXPORT void mesh_remap_indices(Mesh* instance, const int* remap); // every index i of the mesh, its lods and meshlets becomes remap[i], widens 16-bit indices if needed
+
+		EXPORT void unweld_mesh(Mesh* instance); // gives every triangle corner its own vertex, corner i of triangle t becomes vertex t * 3 + i
+		/// <summary>
+		/// merges vertices whose position, normal, uvs and skin influences all round to the same multiples of epsilon. Values
+		/// closer than epsilon that round to neighbouring multiples stay apart, so this is not a merge of everything within epsilon
+		/// </summary>
+		/// <param name="epsilon">0 merges exact duplicates only</param>
+		/// <returns>the new vertex count</returns>
+		EXPORT int weld_mesh(Mesh* instance, const float epsilon);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_WELD_HPP
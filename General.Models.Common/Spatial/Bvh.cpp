@@ -0,0 +1,810 @@
+﻿#include "pch.h"
+#include "Bvh.hpp"
+
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BVH_SSE
+#endif
+
+namespace General
+{
+	namespace Models
+	{
+#define BVH_BIN_COUNT 16
+#define BVH_MAX_LEAF_SIZE 4
+#define BVH_BATCH_SIZE 64 // queries of one parallel job
+#define BVH_CHUNK_SIZE 4096 // triangles of one parallel job while preparing the build
+
+		struct BvhBox
+		{
+			float minimum[3];
+			float maximum[3];
+
+			void reset()
+			{
+				minimum[0] = minimum[1] = minimum[2] = HUGE_VALF;
+				maximum[0] = maximum[1] = maximum[2] = -HUGE_VALF;
+			}
+
+			void grow(const float* point)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					minimum[k] = std::min(minimum[k], point[k]);
+					maximum[k] = std::max(maximum[k], point[k]);
+				}
+			}
+
+			void grow(const BvhBox& box)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					minimum[k] = std::min(minimum[k], box.minimum[k]);
+					maximum[k] = std::max(maximum[k], box.maximum[k]);
+				}
+			}
+
+			float area() const // half of the surface
+			{
+				if (minimum[0] > maximum[0])
+				{
+					return .0f;
+				}
+				const float x = maximum[0] - minimum[0], y = maximum[1] - minimum[1], z = maximum[2] - minimum[2];
+				return x * y + y * z + z * x;
+			}
+		};
+
+		struct BvhBuildNode // binary, collapsed into BvhNode once complete
+		{
+			BvhBox box;
+			int left;
+			int right;
+			int first; // into BvhBuilder::order
+			int count; // 0 for inner nodes
+		};
+
+		struct BvhBuildTask
+		{
+			int begin;
+			int end;
+			int node; // placeholder in the top tree
+		};
+
+		struct BvhBuilder
+		{
+			std::vector<BvhBox> boxes;
+			std::vector<float> centroids; // 3 per triangle
+			std::vector<int> order; // triangles sorted into the leaves, every node owns a range of it
+
+			void measure(const int begin, const int end, BvhBox& box, BvhBox& centroidBox) const
+			{
+				box.reset();
+				centroidBox.reset();
+				for (int i = begin; i < end; ++i)
+				{
+					box.grow(boxes[order[i]]);
+					centroidBox.grow(centroids.data() + order[i] * 3);
+				}
+			}
+
+			/// <returns>where the range splits, -1 to make it a leaf</returns>
+			int split(const int begin, const int end, const BvhBox& box, const BvhBox& centroidBox)
+			{
+				const int count = end - begin;
+				int axis = 0;
+				for (int k = 1; k < 3; ++k)
+				{
+					if (centroidBox.maximum[k] - centroidBox.minimum[k] > centroidBox.maximum[axis] - centroidBox.minimum[axis]) axis = k;
+				}
+				const float extent = centroidBox.maximum[axis] - centroidBox.minimum[axis];
+				if (extent <= .0f)
+				{
+					return count > BVH_MAX_LEAF_SIZE ? begin + count / 2 : -1; // all centroids coincide, any split is as good
+				}
+
+				const float low = centroidBox.minimum[axis];
+				const float scale = BVH_BIN_COUNT / extent;
+				auto bin_of = [&](const int triangle)
+				{
+					return std::min(BVH_BIN_COUNT - 1, static_cast<int>((centroids[triangle * 3 + axis] - low) * scale));
+				};
+
+				int binCounts[BVH_BIN_COUNT] = { };
+				BvhBox binBoxes[BVH_BIN_COUNT];
+				for (BvhBox& binBox : binBoxes) binBox.reset();
+				for (int i = begin; i < end; ++i)
+				{
+					const int bin = bin_of(order[i]);
+					++binCounts[bin];
+					binBoxes[bin].grow(boxes[order[i]]);
+				}
+
+				// sweeps from the right first, so the left sweep can evaluate every plane between two bins
+				float rightAreas[BVH_BIN_COUNT];
+				int rightCounts[BVH_BIN_COUNT];
+				BvhBox accumulated;
+				accumulated.reset();
+				int accumulatedCount = 0;
+				for (int bin = BVH_BIN_COUNT - 1; bin > 0; --bin)
+				{
+					accumulated.grow(binBoxes[bin]);
+					accumulatedCount += binCounts[bin];
+					rightAreas[bin] = accumulated.area();
+					rightCounts[bin] = accumulatedCount;
+				}
+
+				int bestBin = -1;
+				float bestCost = HUGE_VALF;
+				accumulated.reset();
+				accumulatedCount = 0;
+				for (int bin = 0; bin < BVH_BIN_COUNT - 1; ++bin)
+				{
+					accumulated.grow(binBoxes[bin]);
+					accumulatedCount += binCounts[bin];
+					if (0 == accumulatedCount || 0 == rightCounts[bin + 1])
+					{
+						continue;
+					}
+					const float cost = accumulatedCount * accumulated.area() + rightCounts[bin + 1] * rightAreas[bin + 1];
+					if (cost < bestCost)
+					{
+						bestCost = cost;
+						bestBin = bin;
+					}
+				}
+
+				// a traversal step costs as much as one triangle test
+				const float area = box.area();
+				const float splitCost = area > .0f ? 1.0f + bestCost / area : 1.0f;
+				if (count <= BVH_MAX_LEAF_SIZE && (bestBin < 0 || count <= splitCost))
+				{
+					return -1;
+				}
+				if (bestBin < 0)
+				{
+					const int middle = begin + count / 2;
+					std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [&](const int a, const int b) { return centroids[a * 3 + axis] < centroids[b * 3 + axis]; });
+					return middle;
+				}
+				return static_cast<int>(std::partition(order.begin() + begin, order.begin() + end, [&](const int triangle) { return bin_of(triangle) <= bestBin; }) - order.begin());
+			}
+
+			/// <param name="tasks">collects the ranges of at most grain triangles instead of building them, nullptr to build everything</param>
+			int build(std::vector<BvhBuildNode>& nodes, const int begin, const int end, std::vector<BvhBuildTask>* tasks, const int grain)
+			{
+				BvhBuildNode node;
+				BvhBox centroidBox;
+				measure(begin, end, node.box, centroidBox);
+				node.left = node.right = -1;
+				node.first = begin;
+				node.count = end - begin;
+				const int index = static_cast<int>(nodes.size());
+				nodes.push_back(node);
+
+				if (tasks && end - begin <= grain)
+				{
+					tasks->push_back({ begin, end, index });
+					return index;
+				}
+
+				const int middle = split(begin, end, node.box, centroidBox);
+				if (middle < 0)
+				{
+					return index;
+				}
+				const int left = build(nodes, begin, middle, tasks, grain);
+				const int right = build(nodes, middle, end, tasks, grain);
+				nodes[index].left = left;
+				nodes[index].right = right;
+				nodes[index].count = 0;
+				return index;
+			}
+		};
+
+		static void set_bvh_slot(BvhNode& node, const int slot, const BvhBox& box, const int child, const int count)
+		{
+			node.minimumX[slot] = box.minimum[0];
+			node.minimumY[slot] = box.minimum[1];
+			node.minimumZ[slot] = box.minimum[2];
+			node.maximumX[slot] = box.maximum[0];
+			node.maximumY[slot] = box.maximum[1];
+			node.maximumZ[slot] = box.maximum[2];
+			node.children[slot] = child;
+			node.counts[slot] = count;
+		}
+
+		/// <summary>pulls up to four descendants of a binary node into one node, always opening the widest inner one</summary>
+		static int collapse_bvh(const std::vector<BvhBuildNode>& source, const int root, std::vector<BvhNode>& nodes)
+		{
+			int members[4];
+			int memberCount = 0;
+			if (source[root].count > 0)
+			{
+				members[memberCount++] = root;
+			}
+			else
+			{
+				members[memberCount++] = source[root].left;
+				members[memberCount++] = source[root].right;
+			}
+			while (memberCount < 4)
+			{
+				int widest = -1;
+				for (int k = 0; k < memberCount; ++k)
+				{
+					const BvhBuildNode& member = source[members[k]];
+					if (0 == member.count && (widest < 0 || member.box.area() > source[members[widest]].box.area())) widest = k;
+				}
+				if (widest < 0)
+				{
+					break;
+				}
+				const BvhBuildNode& opened = source[members[widest]];
+				members[widest] = opened.left;
+				members[memberCount++] = opened.right;
+			}
+
+			const int index = static_cast<int>(nodes.size());
+			nodes.push_back(BvhNode());
+			BvhNode node;
+			BvhBox empty;
+			empty.reset();
+			for (int k = 0; k < 4; ++k)
+			{
+				if (k >= memberCount)
+				{
+					set_bvh_slot(node, k, empty, -1, 0);
+					continue;
+				}
+				const BvhBuildNode& member = source[members[k]];
+				set_bvh_slot(node, k, member.box, member.count ? member.first : collapse_bvh(source, members[k], nodes), member.count);
+			}
+			nodes[index] = node;
+			return index;
+		}
+
+		static Bvh* build_bvh(const std::vector<Vector3>& vertices, const std::vector<BvhTriangle>& triangles)
+		{
+			const int triangleCount = static_cast<int>(triangles.size());
+			BvhBuilder builder;
+			builder.boxes.resize(triangleCount);
+			builder.centroids.resize(static_cast<size_t>(triangleCount) * 3);
+			builder.order.resize(triangleCount);
+			parallel_for((triangleCount + BVH_CHUNK_SIZE - 1) / BVH_CHUNK_SIZE, [&](const int chunk)
+			{
+				const int end = std::min(triangleCount, (chunk + 1) * BVH_CHUNK_SIZE);
+				for (int t = chunk * BVH_CHUNK_SIZE; t < end; ++t)
+				{
+					BvhBox& box = builder.boxes[t];
+					box.reset();
+					for (int i = 0; i < 3; ++i) box.grow(vertices[t * 3 + i].values);
+					for (int k = 0; k < 3; ++k) builder.centroids[t * 3 + k] = (box.minimum[k] + box.maximum[k]) * .5f;
+					builder.order[t] = t;
+				}
+			});
+
+			// the top of the tree is split on this thread until the ranges are small enough to build one per job
+			std::vector<BvhBuildNode> binary;
+			std::vector<BvhBuildTask> tasks;
+			const int threadCount = parallel_thread_count();
+			const int grain = std::max(1024, triangleCount / (threadCount * 8));
+			if (triangleCount > 0)
+			{
+				builder.build(binary, 0, triangleCount, threadCount > 1 ? &tasks : nullptr, grain);
+			}
+			std::vector<std::vector<BvhBuildNode>> subtrees(tasks.size());
+			parallel_for(static_cast<int>(tasks.size()), [&](const int i)
+			{
+				builder.build(subtrees[i], tasks[i].begin, tasks[i].end, nullptr, 0);
+			});
+			for (size_t i = 0; i < tasks.size(); ++i)
+			{
+				const int offset = static_cast<int>(binary.size());
+				for (BvhBuildNode node : subtrees[i])
+				{
+					if (0 == node.count)
+					{
+						node.left += offset;
+						node.right += offset;
+					}
+					binary.push_back(node);
+				}
+				binary[tasks[i].node] = binary[offset];
+			}
+
+			std::vector<BvhNode> nodes;
+			if (triangleCount > 0)
+			{
+				collapse_bvh(binary, 0, nodes);
+			}
+
+			Bvh* instance = models_alloc_struct<Bvh>();
+			instance->nodeCount = static_cast<int>(nodes.size());
+			instance->nodes = models_copy_array(nodes.data(), nodes.size());
+			instance->triangleCount = triangleCount;
+			instance->triangles = models_copy_array<BvhTriangle>(nullptr, triangleCount);
+			instance->vertices = models_copy_array<Vector3>(nullptr, static_cast<size_t>(triangleCount) * 3);
+			for (int i = 0; i < triangleCount; ++i)
+			{
+				const int source = builder.order[i];
+				instance->triangles[i] = triangles[source];
+				memcpy(instance->vertices + i * 3, vertices.data() + source * 3, sizeof(Vector3) * 3);
+			}
+			return instance;
+		}
+
+		static void read_positions(const Mesh* mesh, std::vector<Vector3>& positions)
+		{
+			int stride;
+			const char* source = reinterpret_cast<const char*>(mesh_get_positions(mesh, &stride));
+			positions.resize(source ? mesh->vertexCount : 0);
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				positions[i] = *reinterpret_cast<const Vector3*>(source + stride * i);
+			}
+		}
+
+		static bool append_triangles(const Mesh* mesh, const std::vector<Vector3>& positions, const int node, const int meshIndex, std::vector<Vector3>& vertices, std::vector<BvhTriangle>& triangles)
+		{
+			std::vector<int> indices(static_cast<size_t>(mesh->triangleCount) * 3);
+			mesh_copy_indices(mesh, indices.data());
+			for (const int index : indices)
+			{
+				CHECK(index >= 0 && index < static_cast<int>(positions.size()), false);
+			}
+			for (int t = 0; t < mesh->triangleCount; ++t)
+			{
+				for (int i = 0; i < 3; ++i) vertices.push_back(positions[indices[t * 3 + i]]);
+				triangles.push_back({ node, meshIndex, t });
+			}
+			return true;
+		}
+
+		Bvh* create_mesh_bvh(const Mesh* mesh)
+		{
+			CHECK(mesh, nullptr);
+
+			std::vector<Vector3> positions;
+			read_positions(mesh, positions);
+			std::vector<Vector3> vertices;
+			std::vector<BvhTriangle> triangles;
+			CHECK(append_triangles(mesh, positions, -1, 0, vertices, triangles), nullptr);
+			return build_bvh(vertices, triangles);
+		}
+
+		Bvh* create_model_bvh(const Model* model)
+		{
+			CHECK(model && model->nodeTable, nullptr);
+
+			const NodeTable* table = model->nodeTable;
+			std::vector<Matrix> worlds(table->count);
+			model_compute_matrices(model, nullptr, worlds.data());
+
+			std::unordered_map<const Mesh*, int> meshIndices;
+			for (int i = 0; i < model->meshCount; ++i)
+			{
+				meshIndices.emplace(model->meshes[i], i);
+			}
+
+			std::vector<Vector3> positions;
+			std::vector<Vector3> vertices;
+			std::vector<BvhTriangle> triangles;
+			for (int node = 0; node < table->count; ++node)
+			{
+				const Mesh* mesh = table->nodes[node]->mesh;
+				if (!mesh)
+				{
+					continue;
+				}
+
+				read_positions(mesh, positions);
+				if (!positions.empty()) math_transform_points(&worlds[node], positions.data(), positions.data(), static_cast<int>(positions.size()));
+				const auto found = meshIndices.find(mesh);
+				CHECK(append_triangles(mesh, positions, node, found == meshIndices.end() ? -1 : found->second, vertices, triangles), nullptr);
+			}
+			return build_bvh(vertices, triangles);
+		}
+
+		void destroy_bvh(Bvh* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->nodes) models_free(instance->nodes);
+			if (instance->triangles) models_free(instance->triangles);
+			if (instance->vertices) models_free(instance->vertices);
+			models_free(instance);
+		}
+
+		struct BvhStackItem
+		{
+			int node;
+			float distance; // lower bound of anything inside, skipped once the best result is closer
+		};
+
+		/// <returns>bit k set if the ray enters box k before limit, entries[k] is where</returns>
+		static int bvh_ray_boxes(const BvhNode& node, const float* origin, const float* inverse, const float limit, float* entries)
+		{
+#ifdef BVH_SSE
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+			const __m128 ix = _mm_set1_ps(inverse[0]), iy = _mm_set1_ps(inverse[1]), iz = _mm_set1_ps(inverse[2]);
+			const __m128 x0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumX), ox), ix), x1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maximumX), ox), ix);
+			const __m128 y0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumY), oy), iy), y1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maximumY), oy), iy);
+			const __m128 z0 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumZ), oz), iz), z1 = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(node.maximumZ), oz), iz);
+			const __m128 enter = _mm_max_ps(_mm_max_ps(_mm_min_ps(x0, x1), _mm_min_ps(y0, y1)), _mm_max_ps(_mm_min_ps(z0, z1), zero));
+			const __m128 leave = _mm_min_ps(_mm_min_ps(_mm_max_ps(x0, x1), _mm_max_ps(y0, y1)), _mm_min_ps(_mm_max_ps(z0, z1), _mm_set1_ps(limit)));
+			_mm_storeu_ps(entries, enter);
+			return _mm_movemask_ps(_mm_cmple_ps(enter, leave));
+#else
+			int mask = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				const float x0 = (node.minimumX[k] - origin[0]) * inverse[0], x1 = (node.maximumX[k] - origin[0]) * inverse[0];
+				const float y0 = (node.minimumY[k] - origin[1]) * inverse[1], y1 = (node.maximumY[k] - origin[1]) * inverse[1];
+				const float z0 = (node.minimumZ[k] - origin[2]) * inverse[2], z1 = (node.maximumZ[k] - origin[2]) * inverse[2];
+				const float enter = std::max(std::max(std::min(x0, x1), std::min(y0, y1)), std::max(std::min(z0, z1), .0f));
+				const float leave = std::min(std::min(std::max(x0, x1), std::max(y0, y1)), std::min(std::max(z0, z1), limit));
+				entries[k] = enter;
+				if (enter <= leave) mask |= 1 << k;
+			}
+			return mask;
+#endif
+		}
+
+		/// <returns>bit k set if box k is closer than limit, distances[k] is the squared distance</returns>
+		static int bvh_point_boxes(const BvhNode& node, const float* point, const float limit, float* distances)
+		{
+#ifdef BVH_SSE
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 px = _mm_set1_ps(point[0]), py = _mm_set1_ps(point[1]), pz = _mm_set1_ps(point[2]);
+			const __m128 dx = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumX), px), _mm_sub_ps(px, _mm_loadu_ps(node.maximumX))), zero);
+			const __m128 dy = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumY), py), _mm_sub_ps(py, _mm_loadu_ps(node.maximumY))), zero);
+			const __m128 dz = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.minimumZ), pz), _mm_sub_ps(pz, _mm_loadu_ps(node.maximumZ))), zero);
+			const __m128 squared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			_mm_storeu_ps(distances, squared);
+			return _mm_movemask_ps(_mm_cmple_ps(squared, _mm_set1_ps(limit)));
+#else
+			int mask = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				const float dx = std::max(std::max(node.minimumX[k] - point[0], point[0] - node.maximumX[k]), .0f);
+				const float dy = std::max(std::max(node.minimumY[k] - point[1], point[1] - node.maximumY[k]), .0f);
+				const float dz = std::max(std::max(node.minimumZ[k] - point[2], point[2] - node.maximumZ[k]), .0f);
+				distances[k] = dx * dx + dy * dy + dz * dz;
+				if (distances[k] <= limit) mask |= 1 << k;
+			}
+			return mask;
+#endif
+		}
+
+		static int bvh_box_boxes(const BvhNode& node, const float* minimum, const float* maximum)
+		{
+#ifdef BVH_SSE
+			const __m128 x = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minimumX), _mm_set1_ps(maximum[0])), _mm_cmpge_ps(_mm_loadu_ps(node.maximumX), _mm_set1_ps(minimum[0])));
+			const __m128 y = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minimumY), _mm_set1_ps(maximum[1])), _mm_cmpge_ps(_mm_loadu_ps(node.maximumY), _mm_set1_ps(minimum[1])));
+			const __m128 z = _mm_and_ps(_mm_cmple_ps(_mm_loadu_ps(node.minimumZ), _mm_set1_ps(maximum[2])), _mm_cmpge_ps(_mm_loadu_ps(node.maximumZ), _mm_set1_ps(minimum[2])));
+			return _mm_movemask_ps(_mm_and_ps(_mm_and_ps(x, y), z));
+#else
+			int mask = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				if (node.minimumX[k] <= maximum[0] && node.maximumX[k] >= minimum[0] && node.minimumY[k] <= maximum[1] && node.maximumY[k] >= minimum[1] &&
+					node.minimumZ[k] <= maximum[2] && node.maximumZ[k] >= minimum[2]) mask |= 1 << k;
+			}
+			return mask;
+#endif
+		}
+
+		/// <summary>pushes the inner children of mask, the nearest last so it is visited first</summary>
+		static void push_bvh_children(const BvhNode& node, int mask, const float* distances, const float limit, std::vector<BvhStackItem>& stack)
+		{
+			int slots[4];
+			int count = 0;
+			for (int k = 0; k < 4; ++k)
+			{
+				if ((mask & (1 << k)) && 0 == node.counts[k] && node.children[k] >= 0 && distances[k] <= limit) slots[count++] = k;
+			}
+			for (int i = 1; i < count; ++i)
+			{
+				for (int j = i; j > 0 && distances[slots[j - 1]] < distances[slots[j]]; --j) std::swap(slots[j - 1], slots[j]);
+			}
+			for (int i = 0; i < count; ++i)
+			{
+				stack.push_back({ node.children[slots[i]], distances[slots[i]] });
+			}
+		}
+
+		static inline void subtract(const Vector3& a, const Vector3& b, float* r)
+		{
+			r[0] = a.x - b.x; r[1] = a.y - b.y; r[2] = a.z - b.z;
+		}
+
+		static inline void cross(const float* a, const float* b, float* r)
+		{
+			r[0] = a[1] * b[2] - a[2] * b[1];
+			r[1] = a[2] * b[0] - a[0] * b[2];
+			r[2] = a[0] * b[1] - a[1] * b[0];
+		}
+
+		static inline float dot(const float* a, const float* b)
+		{
+			return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+		}
+
+		static void bvh_set_hit(const Bvh* instance, const int index, const float distance, const float u, const float v, BvhHit& hit)
+		{
+			const BvhTriangle& triangle = instance->triangles[index];
+			hit.node = triangle.node;
+			hit.mesh = triangle.mesh;
+			hit.triangle = triangle.triangle;
+			hit.distance = distance;
+			hit.u = u;
+			hit.v = v;
+		}
+
+		static void intersect_ray(const Bvh* instance, const BvhRay& ray, BvhHit& hit, std::vector<BvhStackItem>& stack)
+		{
+			hit = { -1, -1, -1, .0f, .0f, .0f };
+			float best = ray.maxDistance > .0f ? ray.maxDistance : HUGE_VALF;
+			const float* origin = ray.origin.values;
+			const float* direction = ray.direction.values;
+			float inverse[3];
+			for (int k = 0; k < 3; ++k)
+			{
+				inverse[k] = .0f != direction[k] ? 1.0f / direction[k] : 1e30f;
+			}
+
+			stack.clear();
+			if (instance->nodeCount) stack.push_back({ 0, .0f });
+			while (!stack.empty())
+			{
+				const BvhStackItem item = stack.back();
+				stack.pop_back();
+				if (item.distance > best)
+				{
+					continue;
+				}
+
+				const BvhNode& node = instance->nodes[item.node];
+				float entries[4];
+				const int mask = bvh_ray_boxes(node, origin, inverse, best, entries);
+				for (int k = 0; k < 4; ++k)
+				{
+					if (!(mask & (1 << k)) || 0 == node.counts[k])
+					{
+						continue;
+					}
+
+					// Moller-Trumbore, both faces count
+					for (int i = node.children[k]; i < node.children[k] + node.counts[k]; ++i)
+					{
+						const Vector3* p = instance->vertices + i * 3;
+						float e1[3], e2[3], s[3], h[3], q[3];
+						subtract(p[1], p[0], e1);
+						subtract(p[2], p[0], e2);
+						cross(direction, e2, h);
+						const float determinant = dot(e1, h);
+						if (fabsf(determinant) < 1e-20f)
+						{
+							continue;
+						}
+						const float inverseDeterminant = 1.0f / determinant;
+						s[0] = origin[0] - p[0].x; s[1] = origin[1] - p[0].y; s[2] = origin[2] - p[0].z;
+						const float u = dot(s, h) * inverseDeterminant;
+						if (u < .0f || u > 1.0f)
+						{
+							continue;
+						}
+						cross(s, e1, q);
+						const float v = dot(direction, q) * inverseDeterminant;
+						if (v < .0f || u + v > 1.0f)
+						{
+							continue;
+						}
+						const float t = dot(e2, q) * inverseDeterminant;
+						if (t >= .0f && t < best)
+						{
+							best = t;
+							bvh_set_hit(instance, i, t, u, v, hit);
+						}
+					}
+				}
+				push_bvh_children(node, mask, entries, best, stack);
+			}
+		}
+
+		/// <summary>Ericson's closest point on a triangle, as weights of the edges p1 - p0 and p2 - p0</summary>
+		/// <returns>the squared distance</returns>
+		static float closest_on_triangle(const float* point, const Vector3* p, float& u, float& v)
+		{
+			float ab[3], ac[3], ap[3], bp[3], cp[3];
+			subtract(p[1], p[0], ab);
+			subtract(p[2], p[0], ac);
+			for (int k = 0; k < 3; ++k)
+			{
+				ap[k] = point[k] - p[0].values[k];
+				bp[k] = point[k] - p[1].values[k];
+				cp[k] = point[k] - p[2].values[k];
+			}
+
+			const float d1 = dot(ab, ap), d2 = dot(ac, ap);
+			const float d3 = dot(ab, bp), d4 = dot(ac, bp);
+			const float d5 = dot(ab, cp), d6 = dot(ac, cp);
+			const float vc = d1 * d4 - d3 * d2, vb = d5 * d2 - d1 * d6, va = d3 * d6 - d5 * d4;
+			if (d1 <= .0f && d2 <= .0f) { u = .0f; v = .0f; }
+			else if (d3 >= .0f && d4 <= d3) { u = 1.0f; v = .0f; }
+			else if (vc <= .0f && d1 >= .0f && d3 <= .0f) { u = d1 / (d1 - d3); v = .0f; }
+			else if (d6 >= .0f && d5 <= d6) { u = .0f; v = 1.0f; }
+			else if (vb <= .0f && d2 >= .0f && d6 <= .0f) { u = .0f; v = d2 / (d2 - d6); }
+			else if (va <= .0f && d4 - d3 >= .0f && d5 - d6 >= .0f) { v = (d4 - d3) / ((d4 - d3) + (d5 - d6)); u = 1.0f - v; }
+			else
+			{
+				const float denominator = 1.0f / (va + vb + vc);
+				u = vb * denominator;
+				v = vc * denominator;
+			}
+
+			float squared = .0f;
+			for (int k = 0; k < 3; ++k)
+			{
+				const float d = point[k] - (p[0].values[k] + ab[k] * u + ac[k] * v);
+				squared += d * d;
+			}
+			return squared;
+		}
+
+		static void closest_point(const Bvh* instance, const Vector3& point, const float maxDistance, BvhHit& hit, std::vector<BvhStackItem>& stack)
+		{
+			hit = { -1, -1, -1, .0f, .0f, .0f };
+			float best = maxDistance > .0f ? maxDistance * maxDistance : HUGE_VALF;
+
+			stack.clear();
+			if (instance->nodeCount) stack.push_back({ 0, .0f });
+			while (!stack.empty())
+			{
+				const BvhStackItem item = stack.back();
+				stack.pop_back();
+				if (item.distance > best)
+				{
+					continue;
+				}
+
+				const BvhNode& node = instance->nodes[item.node];
+				float distances[4];
+				const int mask = bvh_point_boxes(node, point.values, best, distances);
+				for (int k = 0; k < 4; ++k)
+				{
+					if (!(mask & (1 << k)) || 0 == node.counts[k])
+					{
+						continue;
+					}
+					for (int i = node.children[k]; i < node.children[k] + node.counts[k]; ++i)
+					{
+						float u, v;
+						const float squared = closest_on_triangle(point.values, instance->vertices + i * 3, u, v);
+						if (squared <= best && (hit.triangle < 0 || squared < best))
+						{
+							best = squared;
+							bvh_set_hit(instance, i, squared, u, v, hit);
+						}
+					}
+				}
+				push_bvh_children(node, mask, distances, best, stack);
+			}
+			if (hit.triangle >= 0) hit.distance = sqrtf(hit.distance);
+		}
+
+		/// <summary>separating axis test of Akenine-Moller, the box is given by its center and half extents</summary>
+		static bool triangle_overlaps_box(const Vector3* p, const float* center, const float* half)
+		{
+			float v[3][3], e[3][3];
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int k = 0; k < 3; ++k) v[i][k] = p[i].values[k] - center[k];
+			}
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int k = 0; k < 3; ++k) e[i][k] = v[(i + 1) % 3][k] - v[i][k];
+			}
+
+			auto separates = [&](const float* axis)
+			{
+				const float p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+				const float radius = half[0] * fabsf(axis[0]) + half[1] * fabsf(axis[1]) + half[2] * fabsf(axis[2]);
+				return std::min(std::min(p0, p1), p2) > radius || std::max(std::max(p0, p1), p2) < -radius;
+			};
+
+			for (int i = 0; i < 3; ++i)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					float unit[3] = { }, axis[3];
+					unit[k] = 1.0f;
+					cross(unit, e[i], axis);
+					if (separates(axis)) return false;
+				}
+			}
+			for (int k = 0; k < 3; ++k)
+			{
+				float axis[3] = { };
+				axis[k] = 1.0f;
+				if (separates(axis)) return false;
+			}
+			float normal[3];
+			cross(e[0], e[1], normal);
+			return !separates(normal);
+		}
+
+		void bvh_intersect_rays(const Bvh* instance, const BvhRay* rays, BvhHit* hits, const int count)
+		{
+			CHECK(instance && (rays || 0 == count) && (hits || 0 == count) && count >= 0, );
+
+			parallel_for((count + BVH_BATCH_SIZE - 1) / BVH_BATCH_SIZE, [&](const int batch)
+			{
+				std::vector<BvhStackItem> stack;
+				const int end = std::min(count, (batch + 1) * BVH_BATCH_SIZE);
+				for (int i = batch * BVH_BATCH_SIZE; i < end; ++i)
+				{
+					intersect_ray(instance, rays[i], hits[i], stack);
+				}
+			});
+		}
+
+		void bvh_closest_points(const Bvh* instance, const Vector3* points, const float maxDistance, BvhHit* hits, const int count)
+		{
+			CHECK(instance && (points || 0 == count) && (hits || 0 == count) && count >= 0, );
+
+			parallel_for((count + BVH_BATCH_SIZE - 1) / BVH_BATCH_SIZE, [&](const int batch)
+			{
+				std::vector<BvhStackItem> stack;
+				const int end = std::min(count, (batch + 1) * BVH_BATCH_SIZE);
+				for (int i = batch * BVH_BATCH_SIZE; i < end; ++i)
+				{
+					closest_point(instance, points[i], maxDistance, hits[i], stack);
+				}
+			});
+		}
+
+		int bvh_overlap_box(const Bvh* instance, const Vector3 minimum, const Vector3 maximum, BvhHit* hits, const int capacity)
+		{
+			CHECK(instance && (hits || 0 == capacity) && capacity >= 0, 0);
+
+			const float center[3] = { (minimum.x + maximum.x) * .5f, (minimum.y + maximum.y) * .5f, (minimum.z + maximum.z) * .5f };
+			const float half[3] = { (maximum.x - minimum.x) * .5f, (maximum.y - minimum.y) * .5f, (maximum.z - minimum.z) * .5f };
+			int found = 0;
+			std::vector<int> stack;
+			if (instance->nodeCount) stack.push_back(0);
+			while (!stack.empty())
+			{
+				const BvhNode& node = instance->nodes[stack.back()];
+				stack.pop_back();
+				const int mask = bvh_box_boxes(node, minimum.values, maximum.values);
+				for (int k = 0; k < 4; ++k)
+				{
+					if (!(mask & (1 << k)) || node.children[k] < 0)
+					{
+						continue;
+					}
+					if (0 == node.counts[k])
+					{
+						stack.push_back(node.children[k]);
+						continue;
+					}
+					for (int i = node.children[k]; i < node.children[k] + node.counts[k]; ++i)
+					{
+						if (!triangle_overlaps_box(instance->vertices + i * 3, center, half))
+						{
+							continue;
+						}
+						if (found < capacity) bvh_set_hit(instance, i, .0f, .0f, .0f, hits[found]);
+						++found;
+					}
+				}
+			}
+			return found;
+		}
+	}
+}
@@ -0,0 +1,74 @@
+﻿#ifndef GENERAL_MODELS_COMMON_BVH_HPP
+#define GENERAL_MODELS_COMMON_BVH_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		/****************************************************************
+		* Four-wide bounding volume hierarchy over triangles, built with
+		* the binned surface area heuristic. The boxes of the children
+		* are stored as structure of arrays, so a query tests all four of
+		* them with one SSE operation. Queries take arrays and split them
+		* into batches that run in parallel.
+		* ***************************************************************/
+
+		struct BvhNode
+		{
+			float minimumX[4];
+			float minimumY[4];
+			float minimumZ[4];
+			float maximumX[4];
+			float maximumY[4];
+			float maximumZ[4];
+			int children[4]; // node index of an inner child, first item of Bvh::triangles for a leaf, -1 for an empty slot
+			int counts[4]; // triangles of a leaf, 0 for inner children and empty slots
+		};
+
+		struct BvhTriangle
+		{
+			int node; // index into Model::nodeTable, -1 for a bvh over a single mesh
+			int mesh; // index into Model::meshes, 0 for a bvh over a single mesh
+			int triangle;
+		};
+
+		struct Bvh
+		{
+			int nodeCount;
+			BvhNode* nodes; // nodes[0] is the root
+
+			int triangleCount;
+			BvhTriangle* triangles; // in leaf order
+			Vector3* vertices; // 3 per triangle in leaf order, in the space of the bvh
+		};
+
+		struct BvhRay
+		{
+			Vector3 origin;
+			Vector3 direction; // distances are measured in multiples of its length
+			float maxDistance; // 0 for no limit
+		};
+
+		struct BvhHit
+		{
+			int node;
+			int mesh;
+			int triangle; // -1 if nothing was found
+			float distance; // along the ray, or from the query point
+			float u; // the hit point is p0 + u * (p1 - p0) + v * (p2 - p0)
+			float v;
+		};
+
+		EXPORT Bvh* create_mesh_bvh(const Mesh* mesh); // in mesh space
+		EXPORT Bvh* create_model_bvh(const Model* model); // in model space over every node drawing a mesh, needs Model::nodeTable
+		EXPORT void destroy_bvh(Bvh* instance);
+
+		EXPORT void bvh_intersect_rays(const Bvh* instance, const BvhRay* rays, BvhHit* hits, const int count); // the closest hit of every ray, both faces count
+		/// <param name="maxDistance">0 for no limit</param>
+		EXPORT void bvh_closest_points(const Bvh* instance, const Vector3* points, const float maxDistance, BvhHit* hits, const int count);
+		/// <returns>the count of triangles overlapping the box, only the first capacity of them are written to hits</returns>
+		EXPORT int bvh_overlap_box(const Bvh* instance, const Vector3 minimum, const Vector3 maximum, BvhHit* hits, const int capacity);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_BVH_HPP
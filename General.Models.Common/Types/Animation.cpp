@@ -8,29 +8,29 @@ namespace General
 	{
 		void scale_animation_curve_frame_data(AnimationCurveFrameData* data, const float scaling)
 		{
-			__m128 result = _mm_mul_ps(_mm_load_ps(data->values), _mm_load1_ps(&scaling));
-			memcpy(data->values, &result, sizeof(float) * 4);
+			// frame data is only 4-byte aligned inside the packed frames
+			_mm_storeu_ps(data->values, _mm_mul_ps(_mm_loadu_ps(data->values), _mm_set1_ps(scaling)));
 		}
 
 		AnimationCurveNode* create_animation_curve_node(const Node* target, const AnimationCurveNodeType type, const int frameCount, const AnimationCurveFrame* frames)
 		{
-			AnimationCurveNode* instance = g_alloc_struct<AnimationCurveNode>();
+			AnimationCurveNode* instance = models_alloc_struct<AnimationCurveNode>();
 			*const_cast<AnimationCurveNodeType*>(&instance->type) = type;
 			*const_cast<const Node**>(&instance->target) = target;
 			*const_cast<int*>(&instance->frameCount) = frameCount;
-			*const_cast<const AnimationCurveFrame**>(&instance->frames) = g_copy_array(frames, frameCount);
+			*const_cast<const AnimationCurveFrame**>(&instance->frames) = models_copy_array(instance, frames, frameCount);
 			return instance;
 		}
 
 		void destroy_animation_curve_node(AnimationCurveNode* instance)
 		{
-			if (instance->frames) free(const_cast<AnimationCurveFrame*>(instance->frames));
-			g_free_struct(instance);
+			if (instance->frames) models_free(const_cast<AnimationCurveFrame*>(instance->frames));
+			models_free(instance);
 		}
 
 		AnimationCurve* create_animation_curve()
 		{
-			return g_alloc_struct<AnimationCurve>();
+			return models_alloc_struct<AnimationCurve>();
 		}
 
 		void animation_curve_add_node(AnimationCurve* instance, AnimationCurveNode* node)
@@ -38,7 +38,7 @@ namespace General
 			CHECK(node, );
 
 			int index = instance->nodeCount;
-			g_resize_array(const_cast<AnimationCurveNode***>(&instance->nodes), const_cast<int*>(&instance->nodeCount), index + 1);
+			models_resize_array(instance, const_cast<AnimationCurveNode***>(&instance->nodes), const_cast<int*>(&instance->nodeCount), index + 1);
 			*const_cast<AnimationCurveNode**>(instance->nodes + index) = node;
 		}
 
@@ -51,15 +51,15 @@ namespace General
 				{
 					destroy_animation_curve_node(*node);
 				}
-				free(const_cast<AnimationCurveNode**>(instance->nodes));
+				models_free(const_cast<AnimationCurveNode**>(instance->nodes));
 			}
-			free(instance);
+			models_free(instance);
 		}
 
 		Animation* create_animation(const char* name, const float fps)
 		{
-			Animation* instance = g_alloc_struct<Animation>();
-			instance->name = g_copy_string(name);
+			Animation* instance = models_alloc_struct<Animation>();
+			instance->name = models_copy_string_in(models_arena_of(instance), name);
 			*const_cast<AnimationCurve**>(&instance->curve) = create_animation_curve();
 			*const_cast<float*>(&instance->fps) = fps;
 			return instance;
@@ -68,8 +68,8 @@ namespace General
 		void destroy_animation(Animation* instance)
 		{
 			if (instance->curve) destroy_animation_curve(const_cast<AnimationCurve*>(instance->curve));
-			if (instance->name) free(const_cast<char*>(instance->name));
-			g_free_struct(instance);
+			if (instance->name) models_free(const_cast<char*>(instance->name));
+			models_free(instance);
 		}
 	}
 }
\ No newline at end of file
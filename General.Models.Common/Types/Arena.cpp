@@ -0,0 +1,254 @@
+﻿#include "pch.h"
+#include "Arena.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+#ifndef ARENA_DEFAULT_BLOCK_SIZE
+#define ARENA_DEFAULT_BLOCK_SIZE (1llu << 20)
+#endif
+
+#ifndef ARENA_ALIGNMENT
+#define ARENA_ALIGNMENT 16llu
+#endif
+
+		static thread_local Model* bound_model = nullptr;
+
+		static inline size_t align_size(const size_t size)
+		{
+			return (size + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1);
+		}
+
+		static inline char* block_data(ArenaBlock* block)
+		{
+			return reinterpret_cast<char*>(block) + align_size(sizeof(ArenaBlock));
+		}
+
+		static ArenaBlock* create_arena_block(const size_t size)
+		{
+			ArenaBlock* block = (ArenaBlock*)malloc(align_size(sizeof(ArenaBlock)) + size);
+			CHECK(block, nullptr);
+			block->next = nullptr;
+			block->size = size;
+			block->used = 0;
+			return block;
+		}
+
+		Arena* create_arena(const size_t blockSize)
+		{
+			Arena* instance = g_alloc_struct<Arena>();
+			instance->blockSize = blockSize ? align_size(blockSize) : ARENA_DEFAULT_BLOCK_SIZE;
+			return instance;
+		}
+
+		void* arena_alloc(Arena* instance, const size_t size)
+		{
+			CHECK(instance, nullptr);
+
+			const size_t alignedSize = align_size(size ? size : 1);
+			ArenaBlock* head = instance->blocks;
+			if (head && head->used + alignedSize <= head->size)
+			{
+				void* pointer = block_data(head) + head->used;
+				head->used += alignedSize;
+				memset(pointer, 0, size);
+				return pointer;
+			}
+
+			ArenaBlock* block = create_arena_block(alignedSize > instance->blockSize ? alignedSize : instance->blockSize);
+			CHECK(block, nullptr);
+			if (head && alignedSize > instance->blockSize)
+			{
+				// keep carving the current block, the oversized allocation gets a dedicated one
+				block->next = head->next;
+				head->next = block;
+			}
+			else
+			{
+				block->next = head;
+				instance->blocks = block;
+			}
+			++instance->blockCount;
+
+			block->used = alignedSize;
+			memset(block_data(block), 0, size);
+			return block_data(block);
+		}
+
+		struct ArenaAllocation // precedes the data of every resizable allocation
+		{
+			Arena* arena; // the allocation was carved from, nullptr for the heap
+			size_t capacity;
+		};
+		static_assert(sizeof(ArenaAllocation) <= ARENA_ALIGNMENT, "the allocation header must fit in the alignment");
+
+		static inline ArenaAllocation* allocation_header(void* pointer)
+		{
+			return reinterpret_cast<ArenaAllocation*>(static_cast<char*>(pointer) - ARENA_ALIGNMENT);
+		}
+
+		void* arena_resize(Arena* instance, void* pointer, const size_t oldSize, const size_t newSize)
+		{
+			CHECK(instance, nullptr);
+
+			// resizable allocations keep their capacity in a header, so repeated growth is amortized instead of copied every time
+			if (pointer)
+			{
+				size_t* capacity = &allocation_header(pointer)->capacity;
+				if (newSize <= *capacity)
+				{
+					if (newSize > oldSize) memset(static_cast<char*>(pointer) + oldSize, 0, newSize - oldSize);
+					return newSize ? pointer : nullptr;
+				}
+
+				ArenaBlock* head = instance->blocks;
+				const size_t growth = align_size(newSize) - align_size(*capacity);
+				if (head && static_cast<char*>(pointer) + align_size(*capacity) == block_data(head) + head->used && head->used + growth <= head->size)
+				{
+					head->used += growth;
+					memset(static_cast<char*>(pointer) + oldSize, 0, newSize - oldSize);
+					*capacity = align_size(newSize);
+					return pointer;
+				}
+			}
+			CHECK(newSize, nullptr);
+
+			const size_t capacity = pointer && allocation_header(pointer)->capacity * 2 > newSize ? allocation_header(pointer)->capacity * 2 : align_size(newSize);
+			char* allocation = static_cast<char*>(arena_alloc(instance, ARENA_ALIGNMENT + capacity));
+			CHECK(allocation, nullptr);
+			allocation += ARENA_ALIGNMENT;
+			allocation_header(allocation)->arena = instance;
+			allocation_header(allocation)->capacity = capacity;
+			if (pointer && oldSize) memcpy(allocation, pointer, oldSize < newSize ? oldSize : newSize);
+			return allocation;
+		}
+
+		bool arena_contains(const Arena* instance, const void* pointer)
+		{
+			if (nullptr == instance || nullptr == pointer)
+			{
+				return false;
+			}
+
+			const char* address = static_cast<const char*>(pointer);
+			for (ArenaBlock* block = instance->blocks; block; block = block->next)
+			{
+				if (address >= block_data(block) && address < block_data(block) + block->size)
+				{
+					return true;
+				}
+			}
+			return false;
+		}
+
+		void destroy_arena(Arena* instance)
+		{
+			CHECK(instance, );
+
+			ArenaBlock* block = instance->blocks;
+			while (block)
+			{
+				ArenaBlock* next = block->next;
+				free(block);
+				block = next;
+			}
+			g_free_struct(instance);
+		}
+
+		Model* model_bind(Model* model)
+		{
+			Model* previous = bound_model;
+			bound_model = model;
+			return previous;
+		}
+
+		Model* model_bound()
+		{
+			return bound_model;
+		}
+
+		static inline Arena* bound_arena()
+		{
+			return bound_model ? bound_model->arena : nullptr;
+		}
+
+		Arena* models_arena_of(const void* owner)
+		{
+			return owner ? allocation_header(const_cast<void*>(owner))->arena : bound_arena();
+		}
+
+		// heap allocations carry the same header as arena ones, so their owner is known without binding the model
+		static void* heap_resize(void* pointer, const size_t oldSize, const size_t newSize)
+		{
+			ArenaAllocation* header = pointer ? allocation_header(pointer) : nullptr;
+			if (0 == newSize)
+			{
+				free(header);
+				return nullptr;
+			}
+
+			header = static_cast<ArenaAllocation*>(realloc(header, ARENA_ALIGNMENT + newSize));
+			CHECK(header, nullptr);
+			header->arena = nullptr;
+			header->capacity = newSize;
+
+			char* resized = reinterpret_cast<char*>(header) + ARENA_ALIGNMENT;
+			if (newSize > oldSize) memset(resized + oldSize, 0, newSize - oldSize);
+			return resized;
+		}
+
+		void* models_alloc(const size_t size)
+		{
+			return models_resize(nullptr, 0, size ? size : 1);
+		}
+
+		void* models_resize(void* pointer, const size_t oldSize, const size_t newSize)
+		{
+			return models_resize_in(bound_arena(), pointer, oldSize, newSize);
+		}
+
+		void* models_resize_in(Arena* arena, void* pointer, const size_t oldSize, const size_t newSize)
+		{
+			if (nullptr == pointer && 0 == newSize)
+			{
+				return nullptr;
+			}
+
+			if (pointer) arena = allocation_header(pointer)->arena; // a block never moves to another arena
+			return arena ? arena_resize(arena, pointer, oldSize, newSize) : heap_resize(pointer, oldSize, newSize);
+		}
+
+		void models_free(void* pointer)
+		{
+			CHECK(pointer, );
+
+			if (nullptr == allocation_header(pointer)->arena)
+			{
+				free(allocation_header(pointer)); // arena allocations, interned strings included, are released together with their arena
+			}
+		}
+
+		char* models_copy_string(const char* value)
+		{
+			return models_copy_string_in(bound_arena(), value);
+		}
+
+		char* models_copy_string_in(Arena* arena, const char* value)
+		{
+			CHECK(value, nullptr);
+
+			// only the pool of the model owning the arena lives as long as the string
+			if (bound_model && bound_model->names && bound_model->arena == arena)
+			{
+				StringPool* names = bound_model->names;
+				return const_cast<char*>(string_pool_get(names, string_pool_intern(names, value)));
+			}
+
+			const size_t size = strlen(value) + 1;
+			char* string = static_cast<char*>(models_resize_in(arena, nullptr, 0, size));
+			if (string) memcpy(string, value, size);
+			return string;
+		}
+	}
+}
@@ -0,0 +1,107 @@
+﻿#ifndef GENERAL_MODELS_COMMON_ARENA_HPP
+#define GENERAL_MODELS_COMMON_ARENA_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct Model;
+
+		struct ArenaBlock
+		{
+			ArenaBlock* next;
+			size_t size;
+			size_t used;
+		};
+
+		struct Arena
+		{
+			size_t blockSize;
+			int blockCount;
+			ArenaBlock* blocks; // the first block is the one being carved
+		};
+
+		EXPORT Arena* create_arena(const size_t blockSize);
+		EXPORT void* arena_alloc(Arena* instance, const size_t size);
+		EXPORT void* arena_resize(Arena* instance, void* pointer, const size_t oldSize, const size_t newSize);
+		EXPORT bool arena_contains(const Arena* instance, const void* pointer);
+		EXPORT void destroy_arena(Arena* instance);
+
+		/****************************************************************
+		* Every create_* function allocates through models_* below, which
+		* carve from the arena of the model bound to the current thread,
+		* or fall back to the heap when there is no arena.
+		* Each allocation records the arena it came from, so it can be
+		* resized or freed later whichever model is bound.
+		* Mutators pass the object they change as owner, new blocks then
+		* come from the arena the owner was carved from, so a model can be
+		* edited without being bound. A Model owner uses its own arena,
+		* a nullptr owner falls back to the bound model.
+		* Arrays always go through models_resize so they can grow in place.
+		* Strings are interned into the string pool of the bound model
+		* when it owns the arena, models_free leaves them to the pool.
+		* ***************************************************************/
+
+		EXPORT Model* model_bind(Model* model); // returns the previously bound model
+		EXPORT Model* model_bound();
+
+		EXPORT Arena* models_arena_of(const void* owner); // the arena owner was allocated from, nullptr for the heap, see Model.hpp for a Model owner
+
+		EXPORT void* models_alloc(const size_t size);
+		EXPORT void* models_resize(void* pointer, const size_t oldSize, const size_t newSize);
+		EXPORT void* models_resize_in(Arena* arena, void* pointer, const size_t oldSize, const size_t newSize); // a new block comes from arena, the heap for nullptr
+		EXPORT void models_free(void* pointer);
+		EXPORT char* models_copy_string(const char* value);
+		EXPORT char* models_copy_string_in(Arena* arena, const char* value);
+
+		template <typename T> inline T* models_alloc_struct()
+		{
+			return static_cast<T*>(models_alloc(sizeof(T)));
+		}
+
+		template <typename T, typename Owner> inline T* models_alloc_struct(const Owner* owner)
+		{
+			return static_cast<T*>(models_resize_in(models_arena_of(owner), nullptr, 0, sizeof(T)));
+		}
+
+		template <typename T> inline void models_resize_array(T** array, int* count, const int newCount)
+		{
+			*array = static_cast<T*>(models_resize(*array, sizeof(T) * *count, sizeof(T) * newCount));
+			*count = newCount;
+		}
+
+		template <typename Owner, typename T> inline void models_resize_array(const Owner* owner, T** array, int* count, const int newCount)
+		{
+			*array = static_cast<T*>(models_resize_in(models_arena_of(owner), *array, sizeof(T) * *count, sizeof(T) * newCount));
+			*count = newCount;
+		}
+
+		template <typename T> inline T* models_copy_array(const T* source, const size_t count)
+		{
+			T* array = static_cast<T*>(models_resize(nullptr, 0, sizeof(T) * count));
+			if (array && source) memcpy(array, source, sizeof(T) * count);
+			return array;
+		}
+
+		template <typename T, typename Owner> inline T* models_copy_array(const Owner* owner, const T* source, const size_t count)
+		{
+			T* array = static_cast<T*>(models_resize_in(models_arena_of(owner), nullptr, 0, sizeof(T) * count));
+			if (array && source) memcpy(array, source, sizeof(T) * count);
+			return array;
+		}
+
+		inline void models_set_string(char** target, const char* value)
+		{
+			if (*target) models_free(*target);
+			*target = models_copy_string(value);
+		}
+
+		template <typename Owner> inline void models_set_string(const Owner* owner, char** target, const char* value)
+		{
+			if (*target) models_free(*target);
+			*target = models_copy_string_in(models_arena_of(owner), value);
+		}
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_ARENA_HPP
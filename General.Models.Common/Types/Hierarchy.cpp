@@ -0,0 +1,173 @@
+﻿#include "pch.h"
+#include "Hierarchy.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+#define NODE_TRANSFORM_ARRAY_COUNT 10
+
+		static int count_nodes(const Node* node)
+		{
+			int count = 1;
+			for (int i = 0; i < node->childCount; ++i)
+			{
+				count += count_nodes(node->children[i]);
+			}
+			return count;
+		}
+
+		static void flatten_nodes(NodeTable* instance, Node* node, const int parent, int& cursor)
+		{
+			const int index = cursor++;
+			node->index = index;
+			instance->nodes[index] = node;
+			instance->parents[index] = parent;
+			for (int i = 0; i < node->childCount; ++i)
+			{
+				flatten_nodes(instance, node->children[i], index, cursor);
+			}
+			instance->ends[index] = cursor;
+		}
+
+		NodeTable* create_node_table(Node* root, const Model* owner)
+		{
+			CHECK(root, nullptr);
+
+			NodeTable* instance = models_alloc_struct<NodeTable>(owner);
+			const int count = instance->count = count_nodes(root);
+			instance->nodes = models_copy_array<Node*>(instance, nullptr, count);
+			instance->parents = models_copy_array<int>(instance, nullptr, count);
+			instance->ends = models_copy_array<int>(instance, nullptr, count);
+
+			int cursor = 0;
+			flatten_nodes(instance, root, -1, cursor);
+
+			NodeTransforms& transforms = instance->transforms;
+			const int stride = transforms.stride = (count + 7) & ~7;
+			float* block = models_copy_array<float>(instance, nullptr, static_cast<size_t>(stride) * NODE_TRANSFORM_ARRAY_COUNT);
+			float** arrays[NODE_TRANSFORM_ARRAY_COUNT] = {
+				&transforms.positionX, &transforms.positionY, &transforms.positionZ,
+				&transforms.rotationX, &transforms.rotationY, &transforms.rotationZ, &transforms.rotationW,
+				&transforms.scalingX, &transforms.scalingY, &transforms.scalingZ,
+			};
+			for (int i = 0; i < NODE_TRANSFORM_ARRAY_COUNT; ++i)
+			{
+				*arrays[i] = block + stride * i;
+			}
+
+			node_table_read_nodes(instance);
+			return instance;
+		}
+
+		void node_table_read_nodes(NodeTable* instance)
+		{
+			CHECK(instance, );
+
+			NodeTransforms& transforms = instance->transforms;
+			for (int i = 0; i < instance->count; ++i)
+			{
+				const Node* node = instance->nodes[i];
+				transforms.positionX[i] = node->localPosition.x;
+				transforms.positionY[i] = node->localPosition.y;
+				transforms.positionZ[i] = node->localPosition.z;
+				transforms.rotationX[i] = node->localQuaternion.x;
+				transforms.rotationY[i] = node->localQuaternion.y;
+				transforms.rotationZ[i] = node->localQuaternion.z;
+				transforms.rotationW[i] = node->localQuaternion.w;
+				transforms.scalingX[i] = node->localScaling.x;
+				transforms.scalingY[i] = node->localScaling.y;
+				transforms.scalingZ[i] = node->localScaling.z;
+			}
+		}
+
+		void node_table_write_nodes(const NodeTable* instance)
+		{
+			CHECK(instance, );
+
+			const NodeTransforms& transforms = instance->transforms;
+			for (int i = 0; i < instance->count; ++i)
+			{
+				Node* node = instance->nodes[i];
+				node->localPosition = { transforms.positionX[i], transforms.positionY[i], transforms.positionZ[i] };
+				node_set_quaternion(node, { transforms.rotationX[i], transforms.rotationY[i], transforms.rotationZ[i], transforms.rotationW[i] });
+				node->localScaling = { transforms.scalingX[i], transforms.scalingY[i], transforms.scalingZ[i] };
+			}
+		}
+
+		void destroy_node_table(NodeTable* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->nodes) models_free(instance->nodes);
+			if (instance->parents) models_free(instance->parents);
+			if (instance->ends) models_free(instance->ends);
+			if (instance->transforms.positionX) models_free(instance->transforms.positionX); // start of the transform block
+			models_free(instance);
+		}
+
+		NodeTable* model_build_node_table(Model* instance)
+		{
+			CHECK(instance, nullptr);
+
+			if (instance->nodeTable)
+			{
+				destroy_node_table(instance->nodeTable);
+				instance->nodeTable = nullptr;
+			}
+			return instance->root ? instance->nodeTable = create_node_table(instance->root, instance) : nullptr;
+		}
+
+#define NODE_TABLE_BATCH_SIZE 64
+
+		void node_table_compute_matrices(const NodeTable* instance, Matrix* locals, Matrix* worlds, const Matrix* parent)
+		{
+			CHECK(instance && worlds, );
+
+			// one linear pass through the math kernels, each batch computes its local matrices and then their world matrices, parents always come first
+			const NodeTransforms& transforms = instance->transforms;
+			Vector3 translations[NODE_TABLE_BATCH_SIZE];
+			Vector4 rotations[NODE_TABLE_BATCH_SIZE];
+			Vector3 scalings[NODE_TABLE_BATCH_SIZE];
+			Matrix batch[NODE_TABLE_BATCH_SIZE];
+			Matrix parents[NODE_TABLE_BATCH_SIZE];
+			Matrix identity = { };
+			identity.row0[0] = identity.row1[1] = identity.row2[2] = identity.row3[3] = 1.0f;
+			for (int offset = 0; offset < instance->count; offset += NODE_TABLE_BATCH_SIZE)
+			{
+				const int count = instance->count - offset < NODE_TABLE_BATCH_SIZE ? instance->count - offset : NODE_TABLE_BATCH_SIZE;
+				for (int i = 0; i < count; ++i)
+				{
+					const int index = offset + i;
+					translations[i] = { transforms.positionX[index], transforms.positionY[index], transforms.positionZ[index] };
+					rotations[i] = { transforms.rotationX[index], transforms.rotationY[index], transforms.rotationZ[index], transforms.rotationW[index] };
+					scalings[i] = { transforms.scalingX[index], transforms.scalingY[index], transforms.scalingZ[index] };
+				}
+				Matrix* local = locals ? locals + offset : batch;
+				math_compose_matrices(translations, rotations, scalings, local, count);
+
+				// nodes whose parents are done multiply in one call, the others follow their parents within the batch
+				for (int i = 0; i < count; ++i)
+				{
+					const int parentIndex = instance->parents[offset + i];
+					parents[i] = parentIndex >= 0 && parentIndex < offset ? worlds[parentIndex] : (parentIndex < 0 && parent ? *parent : identity);
+				}
+				math_multiply_matrices(local, parents, worlds + offset, count);
+				for (int i = 0; i < count; ++i)
+				{
+					const int parentIndex = instance->parents[offset + i];
+					if (parentIndex >= offset)
+					{
+						math_multiply_matrices(local + i, worlds + parentIndex, worlds + offset + i, 1);
+					}
+				}
+			}
+		}
+
+		void model_compute_matrices(const Model* instance, Matrix* locals, Matrix* worlds)
+		{
+			CHECK(instance && instance->nodeTable, );
+			node_table_compute_matrices(instance->nodeTable, locals, worlds, nullptr);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+﻿#ifndef GENERAL_MODELS_COMMON_HIERARCHY_HPP
+#define GENERAL_MODELS_COMMON_HIERARCHY_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct NodeTransforms // structure of arrays, item i belongs to NodeTable::nodes[i]
+		{
+			int stride; // floats between two arrays, the node count rounded up to 8
+
+			float* positionX;
+			float* positionY;
+			float* positionZ;
+
+			float* rotationX; // normalized quaternion, see Node::localQuaternion
+			float* rotationY;
+			float* rotationZ;
+			float* rotationW;
+
+			float* scalingX;
+			float* scalingY;
+			float* scalingZ;
+		};
+
+		/****************************************************************
+		* Flattened view of a node tree in depth-first order, so every
+		* parent comes before its children and every subtree is a range.
+		* Only the transforms are copied, everything else stays on Node.
+		* ***************************************************************/
+
+		struct NodeTable
+		{
+			int count;
+			Node** nodes;
+			int* parents; // -1 for the root, always less than the index of the child
+			int* ends; // one past the last descendant, [i, ends[i]) is the subtree of node i
+			NodeTransforms transforms;
+		};
+
+		EXPORT NodeTable* create_node_table(Node* root, const Model* owner = nullptr); // also sets Node::index, carved in the arena of owner
+		EXPORT void node_table_read_nodes(NodeTable* instance); // copies the local transforms of the nodes into the table
+		EXPORT void node_table_write_nodes(const NodeTable* instance); // copies the transforms of the table back to the nodes
+		EXPORT void destroy_node_table(NodeTable* instance);
+
+		EXPORT NodeTable* model_build_node_table(Model* instance); // rebuilds Model::nodeTable after the tree changed
+
+		/****************************************************************
+		* Matrices are row matrices: local = scaling * rotation * translation,
+		* world = local * parent world. Rotations come from the quaternions,
+		* so evaluating the hierarchy needs no trigonometry.
+		* ***************************************************************/
+
+		/// <param name="locals">nodeTable->count matrices, or nullptr if only worlds are needed</param>
+		/// <param name="worlds">nodeTable->count matrices</param>
+		/// <param name="parent">world matrix of the parent of the root, nullptr for identity</param>
+		EXPORT void node_table_compute_matrices(const NodeTable* instance, Matrix* locals, Matrix* worlds, const Matrix* parent);
+		EXPORT void model_compute_matrices(const Model* instance, Matrix* locals, Matrix* worlds); // uses the table as it is, see node_table_read_nodes
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_HIERARCHY_HPP
@@ -0,0 +1,30 @@
+﻿#include "pch.h"
+#include "Meshlet.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+		MeshletTable* create_meshlet_table(const int meshletCount, const int vertexCount, const int triangleCount, const Mesh* owner)
+		{
+			CHECK(meshletCount >= 0 && vertexCount >= 0 && triangleCount >= 0, nullptr);
+
+			MeshletTable* instance = models_alloc_struct<MeshletTable>(owner);
+			models_resize_array(instance, &instance->meshlets, &instance->meshletCount, meshletCount);
+			models_resize_array(instance, &instance->vertices, &instance->vertexCount, vertexCount);
+			instance->triangles = models_copy_array<unsigned char>(instance, nullptr, static_cast<size_t>(triangleCount) * 3);
+			instance->triangleCount = triangleCount;
+			return instance;
+		}
+
+		void destroy_meshlet_table(MeshletTable* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->meshlets) models_free(instance->meshlets);
+			if (instance->vertices) models_free(instance->vertices);
+			if (instance->triangles) models_free(instance->triangles);
+			models_free(instance);
+		}
+	}
+}
@@ -0,0 +1,42 @@
+﻿#ifndef GENERAL_MODELS_COMMON_MESHLET_HPP
+#define GENERAL_MODELS_COMMON_MESHLET_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct Meshlet
+		{
+			int vertexOffset; // into MeshletTable::vertices
+			int vertexCount;
+			int triangleOffset; // into MeshletTable::triangles, in triangles
+			int triangleCount;
+			int submesh; // index into Mesh::submeshes, a meshlet never spans two
+
+			Vector3 center; // bounding sphere
+			float radius;
+
+			// the meshlet faces away from a camera at position p if dot(normalize(coneApex - p), coneAxis) >= coneCutoff
+			Vector3 coneApex;
+			Vector3 coneAxis;
+			float coneCutoff; // 1 if the normals spread too much to ever cull
+		};
+
+		struct MeshletTable // clusters of Mesh::triangles with bounded vertex and triangle counts
+		{
+			int meshletCount;
+			Meshlet* meshlets;
+
+			int vertexCount;
+			int* vertices; // indices into the vertices of the mesh
+
+			int triangleCount;
+			unsigned char* triangles; // 3 bytes per triangle, indices into the vertex range of its meshlet
+		};
+
+		EXPORT MeshletTable* create_meshlet_table(const int meshletCount, const int vertexCount, const int triangleCount, const Mesh* owner = nullptr); // carved next to owner, see models_arena_of
+		EXPORT void destroy_meshlet_table(MeshletTable* instance);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_MESHLET_HPP
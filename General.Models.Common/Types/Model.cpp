@@ -14,17 +14,37 @@ namespace General
 			return r;
 		}
 
+		Vector4 quaternion_normalize(const Vector4 q)
+		{
+			Vector4 r;
+			math_normalize_quaternions(&q, &r, 1);
+			return r;
+		}
+
+		Vector4 quaternion_from_euler(const Vector3 degrees)
+		{
+			Vector4 q;
+			math_euler_to_quaternions(&degrees, &q, 1);
+			return q;
+		}
+
+		Vector3 quaternion_to_euler(const Vector4 q)
+		{
+			Vector3 v;
+			math_quaternions_to_euler(&q, &v, 1);
+			return v;
+		}
+
 		UVSet* create_uv_set(const char* name)
 		{
-			UVSet* set = (UVSet*)malloc(sizeof(UVSet));
-			memset(set, 0, sizeof(UVSet));
-			g_set_string(&set->name, name);
+			UVSet* set = models_alloc_struct<UVSet>();
+			models_set_string(set, &set->name, name);
 			return set;
 		}
 
 		void uv_set_set_uv_count(UVSet* set, const int count)
 		{
-			g_resize_array(&set->uvArray, &set->uvCount, count);
+			models_resize_array(set, &set->uvArray, &set->uvCount, count);
 		}
 
 		UVSet* find_uv_set(UVSet** sets, const int setCount, const char* setName)
@@ -44,17 +64,17 @@ namespace General
 
 		void destroy_uv_set(UVSet* set)
 		{
-			if (set->name) free(set->name);
-			if (set->uvArray) free(set->uvArray);
-			free(set);
+			if (set->name) models_free(set->name);
+			if (set->uvArray) models_free(set->uvArray);
+			models_free(set);
 		}
 
 		WeightCollection* create_weight_collection(Node* bone, Matrix boneTransform, const int weightCount)
 		{
-			WeightCollection* instance = g_alloc_struct<WeightCollection>();
+			WeightCollection* instance = models_alloc_struct<WeightCollection>();
 			instance->bone = bone;
 			instance->boneOffset = boneTransform;
-			g_resize_array(&instance->weights, &instance->weightCount, weightCount);
+			models_resize_array(instance, &instance->weights, &instance->weightCount, weightCount);
 			return instance;
 		}
 		
@@ -76,57 +96,521 @@ namespace General
 				return;
 			}
 
-			g_resize_array(&instance->weights, &instance->weightCount, count + 1);
+			models_resize_array(instance, &instance->weights, &instance->weightCount, count + 1);
 			memcpy(instance->weights + count, instance->weights + index, sizeof(WeightData));
 			(instance->weights + count)->index = newIndex;
 		}
 
 		void destroy_weight_collection(WeightCollection* instance)
 		{
-			if (instance->weights) free(instance->weights);
-			free(instance);
+			if (instance->weights) models_free(instance->weights);
+			models_free(instance);
 		}
 
 		Mesh* create_mesh(const char* name)
 		{
-			Mesh* instance = (Mesh*)malloc(sizeof(Mesh));
-			memset(instance, 0, sizeof(Mesh));
-			g_set_string(&instance->name, name);
+			Mesh* instance = models_alloc_struct<Mesh>();
+			models_set_string(instance, &instance->name, name);
+			instance->vertexAttributes = VERTEX_STREAM_ALL;
+			instance->referenceCount = 1;
 			return instance;
 		}
 
+		Mesh* mesh_retain(Mesh* instance)
+		{
+			CHECK(instance, nullptr);
+			++instance->referenceCount;
+			return instance;
+		}
+
+		void mesh_set_lod_count(Mesh* instance, const int count)
+		{
+			CHECK(instance && count >= 0, );
+
+			for (int i = count; i < instance->lodCount; ++i)
+			{
+				if (instance->lods[i].triangles) models_free(instance->lods[i].triangles);
+				if (instance->lods[i].submeshes) models_free(instance->lods[i].submeshes);
+			}
+			models_resize_array(instance, &instance->lods, &instance->lodCount, count);
+		}
+
+		void mesh_set_lod(Mesh* instance, const int level, const float error, const int triangleCount, const Triangle* triangles)
+		{
+			CHECK(instance && level >= 0 && level < instance->lodCount && triangleCount >= 0, );
+
+			MeshLod* lod = instance->lods + level;
+			if (lod->triangles) models_free(lod->triangles);
+			if (lod->submeshes) models_free(lod->submeshes);
+			lod->error = error;
+			lod->triangleCount = triangleCount;
+			lod->triangles = models_copy_array(instance, triangles, triangleCount);
+			lod->submeshes = nullptr;
+		}
+
+		void mesh_set_lod_submeshes(Mesh* instance, const int level, const Submesh* submeshes)
+		{
+			CHECK(instance && level >= 0 && level < instance->lodCount && instance->submeshCount && submeshes, );
+
+			MeshLod* lod = instance->lods + level;
+			int cursor = 0;
+			for (int i = 0; i < instance->submeshCount; ++i)
+			{
+				CHECK(submeshes[i].firstTriangle == cursor && submeshes[i].triangleCount >= 0, );
+				cursor += submeshes[i].triangleCount;
+			}
+			CHECK(cursor == lod->triangleCount, );
+
+			if (lod->submeshes) models_free(lod->submeshes);
+			lod->submeshes = models_copy_array(instance, submeshes, instance->submeshCount);
+		}
+
+		template <typename T> static void resize_vertex_stream(const Mesh* instance, T** stream, const int vertexCount, const int count)
+		{
+			int streamCount = vertexCount;
+			models_resize_array(instance, stream, &streamCount, count);
+		}
+
 		void mesh_set_vertex_count(Mesh* instance, const int count)
 		{
-			g_resize_array(&instance->vertices, &instance->vertexCount, count);
+			const int vertexCount = instance->vertexCount;
+			const unsigned int streamFlags = instance->streamFlags;
+			if (!streamFlags) resize_vertex_stream(instance, &instance->vertices, vertexCount, count);
+			if (streamFlags & VERTEX_STREAM_POSITION) resize_vertex_stream(instance, &instance->positions, vertexCount, count);
+			if (streamFlags & VERTEX_STREAM_NORMAL) resize_vertex_stream(instance, &instance->normals, vertexCount, count);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (streamFlags & VERTEX_STREAM_UV(i)) resize_vertex_stream(instance, instance->uvs + i, vertexCount, count);
+			}
+			instance->vertexCount = count;
+			instance->boundsValid = false;
+		}
+
+		static void release_vertex_streams(Mesh* instance)
+		{
+			if (instance->positions) models_free(instance->positions);
+			if (instance->normals) models_free(instance->normals);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (instance->uvs[i]) models_free(instance->uvs[i]);
+				instance->uvs[i] = nullptr;
+			}
+			instance->positions = nullptr;
+			instance->normals = nullptr;
+			instance->streamFlags = 0;
+		}
+
+		void mesh_set_vertex_streams(Mesh* instance, const int count, const unsigned int streamFlags)
+		{
+			CHECK(instance, );
+
+			if (instance->vertices)
+			{
+				models_free(instance->vertices);
+				instance->vertices = nullptr;
+			}
+			release_vertex_streams(instance);
+
+			instance->vertexCount = count;
+			instance->boundsValid = false;
+			instance->streamFlags = streamFlags | VERTEX_STREAM_POSITION;
+			instance->vertexAttributes = instance->streamFlags;
+			instance->positions = models_copy_array<Vector3>(instance, nullptr, count);
+			if (streamFlags & VERTEX_STREAM_NORMAL) instance->normals = models_copy_array<Vector3>(instance, nullptr, count);
+			for (int i = 0; i < 4; ++i)
+			{
+				if (streamFlags & VERTEX_STREAM_UV(i)) instance->uvs[i] = models_copy_array<Vector2>(instance, nullptr, count);
+			}
+		}
+
+		void mesh_split_vertices(Mesh* instance)
+		{
+			CHECK(instance, );
+			if (instance->streamFlags)
+			{
+				return;
+			}
+
+			// the importer knows which attributes it filled, an attribute that is zero everywhere still keeps its stream
+			const int vertexCount = instance->vertexCount;
+			Vertex* vertices = instance->vertices;
+			instance->vertices = nullptr;
+			mesh_set_vertex_streams(instance, vertexCount, instance->vertexAttributes);
+
+			const Vertex* vertex = vertices;
+			for (int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++vertex)
+			{
+				instance->positions[vertexIndex] = vertex->position;
+				if (instance->normals) instance->normals[vertexIndex] = vertex->normal;
+				for (int i = 0; i < 4; ++i)
+				{
+					if (instance->uvs[i]) instance->uvs[i][vertexIndex] = vertex->uv[i];
+				}
+			}
+			if (vertices) models_free(vertices);
+		}
+
+		void mesh_interleave_streams(Mesh* instance)
+		{
+			CHECK(instance, );
+			if (!instance->streamFlags)
+			{
+				return;
+			}
+
+			Vertex* vertices = models_copy_array<Vertex>(instance, nullptr, instance->vertexCount);
+			mesh_copy_vertices(instance, vertices);
+			release_vertex_streams(instance);
+			instance->vertices = vertices;
+		}
+
+		void mesh_copy_vertices(const Mesh* instance, Vertex* vertices)
+		{
+			CHECK(instance && vertices, );
+
+			const int vertexCount = instance->vertexCount;
+			if (!instance->streamFlags)
+			{
+				if (instance->vertices) memcpy(vertices, instance->vertices, sizeof(Vertex) * vertexCount);
+				return;
+			}
+
+			memset(vertices, 0, sizeof(Vertex) * vertexCount);
+			Vertex* vertex = vertices;
+			for (int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, ++vertex)
+			{
+				vertex->position = instance->positions[vertexIndex];
+				if (instance->normals) vertex->normal = instance->normals[vertexIndex];
+				for (int i = 0; i < 4; ++i)
+				{
+					if (instance->uvs[i]) vertex->uv[i] = instance->uvs[i][vertexIndex];
+				}
+			}
+		}
+
+		const Vector3* mesh_get_positions(const Mesh* instance, int* stride)
+		{
+			CHECK(instance, nullptr);
+
+			if (instance->positions)
+			{
+				if (stride) *stride = static_cast<int>(sizeof(Vector3));
+				return instance->positions;
+			}
+			if (stride) *stride = static_cast<int>(sizeof(Vertex));
+			return instance->vertices ? &instance->vertices->position : nullptr;
+		}
+
+		static void release_submeshes(Mesh* instance)
+		{
+			for (int i = 0; i < instance->lodCount; ++i)
+			{
+				if (instance->lods[i].submeshes) models_free(instance->lods[i].submeshes);
+				instance->lods[i].submeshes = nullptr;
+			}
+			if (instance->submeshes) models_free(instance->submeshes);
+			instance->submeshes = nullptr;
+			instance->submeshCount = 0;
 		}
 
 		void mesh_set_triangle_count(Mesh* instance, const int count)
 		{
-			g_resize_array(&instance->triangles, &instance->triangleCount, count);
+			if (count != instance->triangleCount && instance->submeshes)
+			{
+				release_submeshes(instance);
+			}
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				models_resize_array(instance, &instance->shortTriangles, &instance->triangleCount, count);
+				return;
+			}
+			models_resize_array(instance, &instance->triangles, &instance->triangleCount, count);
 		}
 		
 		void mesh_set_triangles(Mesh* instance, const int count, const Triangle* triangles)
 		{
+			mesh_set_index_format(instance, INDEX_FORMAT_32);
 			mesh_set_triangle_count(instance, count);
 			memcpy(instance->triangles, triangles, sizeof(Triangle) * count);
 		}
+
+		IndexFormat mesh_check_index_format(const Mesh* instance)
+		{
+			return instance->vertexCount <= 0x10000 ? INDEX_FORMAT_16 : INDEX_FORMAT_32;
+		}
+
+		void mesh_set_index_format(Mesh* instance, const IndexFormat format)
+		{
+			CHECK(instance, );
+			if (format == instance->indexFormat)
+			{
+				return;
+			}
+			CHECK(INDEX_FORMAT_32 == format || instance->vertexCount <= 0x10000, );
+
+			const int triangleCount = instance->triangleCount;
+			const int indexCount = triangleCount * 3;
+			if (INDEX_FORMAT_16 == format)
+			{
+				instance->shortTriangles = models_copy_array<ShortTriangle>(instance, nullptr, triangleCount);
+				const int* source = instance->triangles ? instance->triangles->indices : nullptr;
+				unsigned short* target = instance->shortTriangles ? instance->shortTriangles->indices : nullptr;
+				for (int i = 0; i < indexCount; ++i)
+				{
+					target[i] = static_cast<unsigned short>(source[i]);
+				}
+				if (instance->triangles) models_free(instance->triangles);
+				instance->triangles = nullptr;
+			}
+			else
+			{
+				instance->triangles = models_copy_array<Triangle>(instance, nullptr, triangleCount);
+				const unsigned short* source = instance->shortTriangles ? instance->shortTriangles->indices : nullptr;
+				int* target = instance->triangles ? instance->triangles->indices : nullptr;
+				for (int i = 0; i < indexCount; ++i)
+				{
+					target[i] = source[i];
+				}
+				if (instance->shortTriangles) models_free(instance->shortTriangles);
+				instance->shortTriangles = nullptr;
+			}
+			instance->indexFormat = format;
+		}
+
+		int mesh_get_index(const Mesh* instance, const int index)
+		{
+			return INDEX_FORMAT_16 == instance->indexFormat ? instance->shortTriangles->indices[index] : instance->triangles->indices[index];
+		}
+
+		void mesh_set_index(Mesh* instance, const int index, const int value)
+		{
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				if (value <= 0xffff)
+				{
+					instance->shortTriangles->indices[index] = static_cast<unsigned short>(value);
+					return;
+				}
+				mesh_set_index_format(instance, INDEX_FORMAT_32);
+			}
+			instance->triangles->indices[index] = value;
+		}
+
+		Triangle mesh_get_triangle(const Mesh* instance, const int triangleIndex)
+		{
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				const ShortTriangle* source = instance->shortTriangles + triangleIndex;
+				Triangle triangle = { };
+				triangle.index0 = source->index0;
+				triangle.index1 = source->index1;
+				triangle.index2 = source->index2;
+				return triangle;
+			}
+			return instance->triangles[triangleIndex];
+		}
+
+		void mesh_copy_indices(const Mesh* instance, int* indices)
+		{
+			CHECK(instance && indices, );
+
+			const int indexCount = instance->triangleCount * 3;
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				const unsigned short* source = instance->shortTriangles->indices;
+				for (int i = 0; i < indexCount; ++i)
+				{
+					indices[i] = source[i];
+				}
+				return;
+			}
+			if (indexCount) memcpy(indices, instance->triangles, sizeof(int) * indexCount);
+		}
+
+		void mesh_write_indices(Mesh* instance, const int* indices)
+		{
+			CHECK(instance && indices, );
+
+			const int indexCount = instance->triangleCount * 3;
+			if (INDEX_FORMAT_32 == instance->indexFormat)
+			{
+				if (indexCount) memcpy(instance->triangles, indices, sizeof(int) * indexCount);
+				return;
+			}
+			for (int i = 0; i < indexCount; ++i)
+			{
+				mesh_set_index(instance, i, indices[i]);
+			}
+		}
+
+		void mesh_set_indices(Mesh* instance, const int indexCount, const int* indices)
+		{
+			CHECK(instance && 0 == indexCount % 3, );
+
+			if (indexCount / 3 != instance->triangleCount && instance->submeshes)
+			{
+				release_submeshes(instance);
+			}
+			if (instance->triangles) models_free(instance->triangles);
+			if (instance->shortTriangles) models_free(instance->shortTriangles);
+			instance->triangles = nullptr;
+			instance->shortTriangles = nullptr;
+			instance->triangleCount = 0;
+
+			instance->indexFormat = mesh_check_index_format(instance);
+			mesh_set_triangle_count(instance, indexCount / 3);
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				unsigned short* target = instance->shortTriangles ? instance->shortTriangles->indices : nullptr;
+				for (int i = 0; i < indexCount; ++i)
+				{
+					target[i] = static_cast<unsigned short>(indices[i]);
+				}
+				return;
+			}
+			if (indexCount) memcpy(instance->triangles, indices, sizeof(int) * indexCount);
+		}
+
+		const void* mesh_get_index_buffer(const Mesh* instance, int* indexSize)
+		{
+			CHECK(instance, nullptr);
+
+			if (INDEX_FORMAT_16 == instance->indexFormat)
+			{
+				if (indexSize) *indexSize = static_cast<int>(sizeof(unsigned short));
+				return instance->shortTriangles;
+			}
+			if (indexSize) *indexSize = static_cast<int>(sizeof(int));
+			return instance->triangles;
+		}
 		
 		void mesh_add_material(Mesh* instance, Material* material)
 		{
 			int index = instance->materialCount;
-			g_resize_array(&instance->materials, &instance->materialCount, index + 1);
+			models_resize_array(instance, &instance->materials, &instance->materialCount, index + 1);
 			instance->materials[index] = material;
 		}
 
+		void mesh_sort_submeshes(Mesh* instance, const int* triangleMaterials)
+		{
+			CHECK(instance, );
+
+			const int triangleCount = instance->triangleCount;
+			std::vector<int> order(triangleCount);
+			std::vector<int> keys(triangleCount);
+			for (int i = 0; i < triangleCount; ++i)
+			{
+				order[i] = i;
+				keys[i] = triangleMaterials ? (triangleMaterials[i] >= 0 ? triangleMaterials[i] : -1) : 0;
+			}
+			// triangles without a material go last, the order inside a material is kept
+			std::stable_sort(order.begin(), order.end(), [&keys](const int a, const int b)
+			{
+				return static_cast<unsigned int>(keys[a]) < static_cast<unsigned int>(keys[b]);
+			});
+
+			std::vector<Submesh> submeshes;
+			bool sorted = true;
+			for (int i = 0; i < triangleCount; ++i)
+			{
+				sorted = sorted && order[i] == i;
+				const int material = keys[order[i]];
+				if (submeshes.empty() || submeshes.back().material != material)
+				{
+					Submesh submesh = { i, 0, material };
+					submeshes.push_back(submesh);
+				}
+				++submeshes.back().triangleCount;
+			}
+
+			if (!sorted)
+			{
+				std::vector<int> indices(triangleCount * 3);
+				std::vector<int> sortedIndices(triangleCount * 3);
+				mesh_copy_indices(instance, indices.data());
+				for (int i = 0; i < triangleCount; ++i)
+				{
+					memcpy(sortedIndices.data() + i * 3, indices.data() + order[i] * 3, sizeof(int) * 3);
+				}
+				mesh_write_indices(instance, sortedIndices.data());
+
+				// both were built against the old triangle order
+				mesh_set_lod_count(instance, 0);
+				if (instance->meshlets) destroy_meshlet_table(instance->meshlets);
+				instance->meshlets = nullptr;
+			}
+
+			// one range of the first material, or of none without materials, is what a mesh without submeshes means anyway
+			release_submeshes(instance);
+			if (submeshes.size() > 1 || (1 == submeshes.size() && 0 != submeshes[0].material && (-1 != submeshes[0].material || instance->materialCount)))
+			{
+				instance->submeshCount = static_cast<int>(submeshes.size());
+				instance->submeshes = models_copy_array(instance, submeshes.data(), instance->submeshCount);
+			}
+		}
+
+		void mesh_set_submeshes(Mesh* instance, const int count, const Submesh* submeshes)
+		{
+			CHECK(instance && count >= 0 && (submeshes || 0 == count), );
+
+			int cursor = 0;
+			for (int i = 0; i < count; ++i)
+			{
+				CHECK(submeshes[i].firstTriangle == cursor && submeshes[i].triangleCount >= 0, );
+				cursor += submeshes[i].triangleCount;
+			}
+			CHECK(0 == count || cursor == instance->triangleCount, );
+
+			release_submeshes(instance);
+			instance->submeshCount = count;
+			instance->submeshes = count ? models_copy_array(instance, submeshes, count) : nullptr;
+		}
+
+		int mesh_get_submesh_count(const Mesh* instance)
+		{
+			CHECK(instance, 0);
+			return instance->submeshCount ? instance->submeshCount : 1;
+		}
+
+		Submesh mesh_get_submesh(const Mesh* instance, const int index)
+		{
+			Submesh submesh = { 0, 0, -1 };
+			CHECK(instance && index >= 0 && index < mesh_get_submesh_count(instance), submesh);
+
+			if (instance->submeshCount)
+			{
+				return instance->submeshes[index];
+			}
+			submesh.triangleCount = instance->triangleCount;
+			submesh.material = instance->materialCount ? 0 : -1;
+			return submesh;
+		}
+
 		void mesh_add_weight_collection(Mesh* instance, WeightCollection* collection)
 		{
 			int index = instance->weightCollectionCount;
-			g_resize_array(&instance->weightCollections, &instance->weightCollectionCount, index + 1);
+			models_resize_array(instance, &instance->weightCollections, &instance->weightCollectionCount, index + 1);
 			instance->weightCollections[index] = collection;
+
+			// the skin indexes collections by position, it no longer covers every one of them
+			if (instance->skin)
+			{
+				mesh_sync_weights(instance);
+				destroy_skin_table(instance->skin);
+				instance->skin = nullptr;
+			}
 		}
 
 		void mesh_copy_weight(Mesh* instance, const int templateIndex, const int newIndex)
 		{
+			// the skin copies the influences of one vertex, the collections would each scan all their weights
+			if (instance->skin)
+			{
+				skin_table_copy_vertex(instance->skin, templateIndex, newIndex);
+				instance->weightsStale = true;
+				return;
+			}
+
 			WeightCollection** collections = instance->weightCollections;
 			for (int i = 0; i < instance->weightCollectionCount; ++i, ++collections)
 			{
@@ -138,52 +622,62 @@ namespace General
 		{
 			CHECK(instance, );
 
-			if (instance->vertices) free(instance->vertices);
-			if (instance->triangles) free(instance->triangles);
+			if (--instance->referenceCount > 0)
+			{
+				return;
+			}
+
+			if (instance->vertices) models_free(instance->vertices);
+			release_vertex_streams(instance);
+			if (instance->triangles) models_free(instance->triangles);
+			if (instance->shortTriangles) models_free(instance->shortTriangles);
 
 			for (int i = 0; i < instance->weightCollectionCount; ++i)
 			{
 				destroy_weight_collection(instance->weightCollections[i]);
 			}
-			free(instance->weightCollections);
+			models_free(instance->weightCollections);
+			if (instance->skin) destroy_skin_table(instance->skin);
+			if (instance->instances) models_free(instance->instances);
+			if (instance->lods) mesh_set_lod_count(instance, 0);
+			if (instance->submeshes) models_free(instance->submeshes);
+			if (instance->meshlets) destroy_meshlet_table(instance->meshlets);
 
 			for (int i = 0; i < instance->materialCount; ++i)
 			{
 				destroy_material(instance->materials[i]);
 			}
-			free(instance->materials);
+			models_free(instance->materials);
 
-			if (instance->name) free(const_cast<char*>(instance->name));
+			if (instance->name) models_free(const_cast<char*>(instance->name));
 
-			free(instance);
+			models_free(instance);
 		}
 
 		MaterialTexture* create_material_texture()
 		{
-			MaterialTexture* material = (MaterialTexture*)malloc(sizeof(MaterialTexture));
-			memset(material, 0, sizeof(MaterialTexture));
+			MaterialTexture* material = models_alloc_struct<MaterialTexture>();
 			return material;
 		}
 
 		void set_material_texture(MaterialTexture* material, const char* filename, const char* uvSet)
 		{
 			CHECK(material, );
-			g_set_string(&material->texture, filename);
-			g_set_string(&material->uvSet, uvSet);
+			models_set_string(material, &material->texture, filename);
+			models_set_string(material, &material->uvSet, uvSet);
 		}
 
 		void destroy_material_texture(MaterialTexture* material)
 		{
-			if (material->texture) free(material->texture);
-			if (material->uvSet) free(material->uvSet);
-			free(material);
+			if (material->texture) models_free(material->texture);
+			if (material->uvSet) models_free(material->uvSet);
+			models_free(material);
 		}
 
 		Material* create_material(const char* name)
 		{
-			Material* material = (Material*)malloc(sizeof(Material));
-			memset(material, 0, sizeof(Material));
-			g_set_string(&material->name, name);
+			Material* material = models_alloc_struct<Material>();
+			models_set_string(material, &material->name, name);
 			return material;
 		}
 		
@@ -191,7 +685,7 @@ namespace General
 		{
 			if (nullptr == instance->ambient)
 			{
-				instance->ambient = create_material_texture();
+				instance->ambient = models_alloc_struct<MaterialTexture>(instance);
 			}
 			set_material_texture(instance->ambient, filename, uvSet);
 		}
@@ -200,7 +694,7 @@ namespace General
 		{
 			if (nullptr == instance->diffuse)
 			{
-				instance->diffuse = create_material_texture();
+				instance->diffuse = models_alloc_struct<MaterialTexture>(instance);
 			}
 			set_material_texture(instance->diffuse, filename, uvSet);		
 		}
@@ -209,7 +703,7 @@ namespace General
 		{
 			if (nullptr == instance->emissive)
 			{
-				instance->emissive = create_material_texture();
+				instance->emissive = models_alloc_struct<MaterialTexture>(instance);
 			}
 			set_material_texture(instance->emissive, filename, uvSet);			
 		}
@@ -218,7 +712,7 @@ namespace General
 		{
 			if (nullptr == instance->specular)
 			{
-				instance->specular = create_material_texture();
+				instance->specular = models_alloc_struct<MaterialTexture>(instance);
 			}
 			set_material_texture(instance->specular, filename, uvSet);
 		}
@@ -248,23 +742,46 @@ namespace General
 			if (instance->emissive) destroy_material_texture(instance->emissive);
 			if (instance->specular) destroy_material_texture(instance->specular);
 
-			if (instance->name) free(const_cast<char*>(instance->name));
+			if (instance->name) models_free(const_cast<char*>(instance->name));
 
-			free(instance);
+			models_free(instance);
 		}
 
 		Node* create_node(const char* name)
 		{
-			Node* node = g_alloc_struct<Node>();
-			g_set_string(&node->name, name);
+			Node* node = models_alloc_struct<Node>();
+			models_set_string(node, &node->name, name);
 			node->visible = true;
+			node->index = -1;
+			node->localQuaternion.w = 1.0f;
 			return node;
 		}
 
+		void node_set_rotation(Node* instance, const Vector3 degrees)
+		{
+			instance->localRotation = degrees;
+			instance->localQuaternion = quaternion_from_euler(degrees);
+		}
+
+		void node_set_quaternion(Node* instance, const Vector4 q)
+		{
+			instance->localQuaternion = quaternion_normalize(q);
+			instance->localRotation = quaternion_to_euler(instance->localQuaternion);
+		}
+
+		void node_set_local_matrix(Node* instance, const Matrix matrix)
+		{
+			if (nullptr == instance->localMatrix)
+			{
+				instance->localMatrix = models_alloc_struct<Matrix>(instance);
+			}
+			*instance->localMatrix = matrix;
+		}
+
 		void node_add_child(Node* instance, Node* child)
 		{
 			int index = instance->childCount;
-			g_resize_array(&instance->children, &instance->childCount, index + 1);
+			models_resize_array(instance, &instance->children, &instance->childCount, index + 1);
 			instance->children[index] = child;
 			child->parent = instance;
 		}
@@ -285,48 +802,239 @@ namespace General
 			{
 				destroy_node(instance->children[i]);
 			}
-			free(instance->children);
+			models_free(instance->children);
 
-			if (instance->name) free(const_cast<char*>(instance->name));
-			free(instance);
+			if (instance->localMatrix) models_free(instance->localMatrix);
+			if (instance->name) models_free(const_cast<char*>(instance->name));
+			models_free(instance);
 		}
 
 		Model* create_model()
 		{
 			Model* instance = (Model*)malloc(sizeof(Model));
 			memset(instance, 0, sizeof(Model));
+			instance->names = create_string_pool();
+			return instance;
+		}
+
+		Model* create_model_with_arena(const size_t blockSize)
+		{
+			Arena* arena = create_arena(blockSize);
+			CHECK(arena, nullptr);
+
+			Model* instance = static_cast<Model*>(arena_alloc(arena, sizeof(Model))); // the model itself lives in its arena
+			instance->arena = arena;
+			instance->names = create_string_pool();
 			return instance;
 		}
 
 		void model_add_mesh(Model* instance, Mesh* mesh) 
 		{
 			int index = instance->meshCount;
-			g_resize_array(&instance->meshes, &instance->meshCount, index + 1);
+			models_resize_array(instance, &instance->meshes, &instance->meshCount, index + 1);
 			instance->meshes[index] = mesh;
 		}
 
 		void model_add_material(Model* instance, Material* material)
 		{
 			int index = instance->materialCount;
-			g_resize_array(&instance->materials, &instance->materialCount, index + 1);
+			models_resize_array(instance, &instance->materials, &instance->materialCount, index + 1);
 			instance->materials[index] = material;
+			model_index_material(instance, material);
+		}
+
+		void model_add_uv_set(Model* instance, UVSet* uvSet)
+		{
+			int index = instance->uvSetCount;
+			models_resize_array(instance, &instance->uvSets, &instance->uvSetCount, index + 1);
+			instance->uvSets[index] = uvSet;
+			model_index_uv_set(instance, uvSet);
 		}
 
 		void model_add_animation(Model* instance, Animation* animation)
 		{
 			int index = instance->animationCount;
-			g_resize_array(&instance->animations, &instance->animationCount, index + 1);
+			models_resize_array(instance, &instance->animations, &instance->animationCount, index + 1);
 			instance->animations[index] = animation;
 		}
 
+		void model_index_node(Model* instance, Node* node)
+		{
+			CHECK(instance && instance->names && node && node->name, );
+
+			if (nullptr == name_table_find(&instance->nodeNames, instance->names, node->name))
+			{
+				name_table_set(&instance->nodeNames, instance->names, node->name, node);
+			}
+		}
+
+		void model_index_material(Model* instance, Material* material)
+		{
+			CHECK(instance && instance->names && material && material->name, );
+
+			if (nullptr == name_table_find(&instance->materialNames, instance->names, material->name))
+			{
+				name_table_set(&instance->materialNames, instance->names, material->name, material);
+			}
+		}
+
+		void model_index_uv_set(Model* instance, UVSet* uvSet)
+		{
+			CHECK(instance && instance->names && uvSet && uvSet->name, );
+
+			if (nullptr == name_table_find(&instance->uvSetNames, instance->names, uvSet->name))
+			{
+				name_table_set(&instance->uvSetNames, instance->names, uvSet->name, uvSet);
+			}
+		}
+
+		static void index_node_tree(Model* instance, Node* node)
+		{
+			model_index_node(instance, node);
+			for (int i = 0; i < node->childCount; ++i)
+			{
+				index_node_tree(instance, node->children[i]);
+			}
+		}
+
+		void model_index_names(Model* instance)
+		{
+			CHECK(instance, );
+
+			if (nullptr == instance->names)
+			{
+				instance->names = create_string_pool();
+			}
+			name_table_clear(&instance->nodeNames);
+			name_table_clear(&instance->materialNames);
+			name_table_clear(&instance->uvSetNames);
+
+			if (instance->root) index_node_tree(instance, instance->root);
+			for (int i = 0; i < instance->materialCount; ++i)
+			{
+				model_index_material(instance, instance->materials[i]);
+			}
+			for (int i = 0; i < instance->uvSetCount; ++i)
+			{
+				model_index_uv_set(instance, instance->uvSets[i]);
+			}
+		}
+
+		static void count_mesh_instances(Node* node)
+		{
+			if (node->mesh) ++node->mesh->instanceCount;
+			for (int i = 0; i < node->childCount; ++i)
+			{
+				count_mesh_instances(node->children[i]);
+			}
+		}
+
+		static void collect_mesh_instances(Node* node)
+		{
+			if (node->mesh && node->mesh->instances) node->mesh->instances[node->mesh->instanceCount++] = node; // skips meshes missing from Model::meshes
+			for (int i = 0; i < node->childCount; ++i)
+			{
+				collect_mesh_instances(node->children[i]);
+			}
+		}
+
+		void model_build_mesh_instances(Model* instance)
+		{
+			CHECK(instance, );
+
+			for (int i = 0; i < instance->meshCount; ++i)
+			{
+				Mesh* mesh = instance->meshes[i];
+				if (mesh->instances) models_free(mesh->instances);
+				mesh->instances = nullptr;
+				mesh->instanceCount = 0;
+			}
+			if (nullptr == instance->root)
+			{
+				return;
+			}
+
+			// count first so every list is allocated once, then fill in preorder
+			count_mesh_instances(instance->root);
+			for (int i = 0; i < instance->meshCount; ++i)
+			{
+				Mesh* mesh = instance->meshes[i];
+				int count = 0;
+				models_resize_array(mesh, &mesh->instances, &count, mesh->instanceCount);
+				mesh->instanceCount = 0;
+			}
+			collect_mesh_instances(instance->root);
+		}
+
+		Node* model_find_node(const Model* instance, const char* name)
+		{
+			CHECK(instance && name, nullptr);
+			return static_cast<Node*>(name_table_find(&instance->nodeNames, instance->names, name));
+		}
+
+		Material* model_find_material(const Model* instance, const char* name)
+		{
+			CHECK(instance && name, nullptr);
+			return static_cast<Material*>(name_table_find(&instance->materialNames, instance->names, name));
+		}
+
+		UVSet* model_find_uv_set(const Model* instance, const char* name)
+		{
+			CHECK(instance && name, nullptr);
+			return static_cast<UVSet*>(name_table_find(&instance->uvSetNames, instance->names, name));
+		}
+
+		static void release_names(Model* instance)
+		{
+			name_table_clear(&instance->nodeNames);
+			name_table_clear(&instance->materialNames);
+			name_table_clear(&instance->uvSetNames);
+			if (instance->names) destroy_string_pool(instance->names);
+			instance->names = nullptr;
+		}
+
 		void destroy_model(Model* instance)
 		{
 			CHECK(instance, );
 
+			if (instance->file)
+			{
+				release_model_file(instance->file); // the model and everything it references are part of the block
+				return;
+			}
+
+			if (instance->payloads)
+			{
+				release_payload_source(instance->payloads);
+			}
+
+			if (instance->arena)
+			{
+				// every object of the model, including the model itself, is carved from its arena
+				if (model_bound() == instance) model_bind(nullptr);
+				release_names(instance);
+				destroy_arena(instance->arena);
+				return;
+			}
+
+			// interned names carry their pool's arena, so models_free leaves them to release_names
+			if (model_bound() == instance) model_bind(nullptr);
+			if (instance->nodeTable) destroy_node_table(instance->nodeTable);
+			if (instance->nodeBounds) models_free(instance->nodeBounds);
+			if (instance->batchRanges) models_free(instance->batchRanges);
 			if (instance->root) destroy_node(instance->root);
 
-			if (instance->meshes) free(instance->meshes);
-			if (instance->materials) free(instance->materials); // release items at destroy_mesh
+			if (instance->meshes) models_free(instance->meshes);
+			if (instance->materials) models_free(instance->materials); // release items at destroy_mesh
+
+			if (instance->uvSets)
+			{
+				for (int i = 0; i < instance->uvSetCount; ++i)
+				{
+					destroy_uv_set(instance->uvSets[i]);
+				}
+				models_free(instance->uvSets);
+			}
 
 			if (instance->animations)
 			{
@@ -334,9 +1042,10 @@ namespace General
 				{
 					destroy_animation(instance->animations[i]);
 				}
-				free(instance->animations);
+				models_free(instance->animations);
 			}
 
+			release_names(instance);
 			free(instance);
 		}
 	}
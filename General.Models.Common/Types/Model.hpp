@@ -1,6 +1,8 @@
 ﻿#ifndef GENERAL_MODELS_COMMON_MODEL_HPP
 #define GENERAL_MODELS_COMMON_MODEL_HPP
 
+#include "Vector.hpp"
+
 namespace General
 {
 	namespace Models
@@ -11,50 +13,18 @@ namespace General
 
 		struct Node;
 		struct Animation;
-
-		struct Vector2
-		{
-			union
-			{
-				struct
-				{
-					float x;
-					float y;
-				};
-				float values[2];
-			};
-		};
-
-		struct Vector3
-		{
-			union
-			{
-				struct
-				{
-					float x;
-					float y;
-					float z;
-				};
-				float values[3];
-			};
-		};
-
-		struct Vector4
-		{
-			union
-			{
-				struct
-				{
-					float x;
-					float y;
-					float z;
-					float w;
-				};
-				float values[4];
-			};
-		};
+		struct Arena;
+		struct SkinTable;
+		struct MeshletTable;
+		struct NodeTable;
+		struct BatchRange;
+		struct ModelFileHeader;
+		struct PayloadSource;
 
 		EXPORT Vector3 vector3_scale(const Vector3 v, const float scaling);
+		EXPORT Vector4 quaternion_normalize(const Vector4 q);
+		EXPORT Vector4 quaternion_from_euler(const Vector3 degrees); // rotates around x, y and then z
+		EXPORT Vector3 quaternion_to_euler(const Vector4 q); // in degrees
 
 		struct Transform
 		{
@@ -63,21 +33,6 @@ namespace General
 			Vector3 scaling;
 		};
 
-		struct Matrix // row matrix
-		{
-			union
-			{
-				struct
-				{
-					float row0[4];
-					float row1[4];
-					float row2[4];
-					float row3[4];
-				};
-				float values[16];
-			};
-		};
-
 		struct Vertex
 		{
 			Vector3 position;
@@ -99,6 +54,26 @@ namespace General
 			};
 		};
 
+		struct ShortTriangle
+		{
+			union
+			{
+				struct
+				{
+					unsigned short index0;
+					unsigned short index1;
+					unsigned short index2;
+				};
+				unsigned short indices[3];
+			};
+		};
+
+		enum IndexFormat
+		{
+			INDEX_FORMAT_32,
+			INDEX_FORMAT_16,
+		};
+
 		struct UV
 		{
 			int vertexIndex;
@@ -120,7 +95,7 @@ namespace General
 
 		EXPORT UVSet* create_uv_set(const char* name);
 		EXPORT void uv_set_set_uv_count(UVSet* set, const int count);
-		EXPORT UVSet* find_uv_set(UVSet** sets, const int setCount, const char* setName);
+		EXPORT UVSet* find_uv_set(UVSet** sets, const int setCount, const char* setName); // legacy linear scan, see model_find_uv_set
 		EXPORT void destroy_uv_set(UVSet* set);
 		
 		struct MaterialTexture
@@ -148,7 +123,7 @@ namespace General
 		EXPORT void material_set_diffuse(Material* instance, const char* filename, const char* uvSet);
 		EXPORT void material_set_emissive(Material* instance, const char* filename, const char* uvSet);
 		EXPORT void material_set_specular(Material* instance, const char* filename, const char* uvSet);
-		EXPORT Material* find_material(Material** instance, const int materialCount, const char* materialName);
+		EXPORT Material* find_material(Material** instance, const int materialCount, const char* materialName); // legacy linear scan, see model_find_material
 		EXPORT void destroy_material(Material* instance);
 
 		struct WeightData
@@ -170,30 +145,115 @@ namespace General
 		EXPORT void weight_collection_copy_weight(WeightCollection* instance, const int templateIndex, const int newIndex);
 		EXPORT void destroy_weight_collection(WeightCollection* instance);
 
+		enum VertexStream
+		{
+			VERTEX_STREAM_POSITION = 1 << 0,
+			VERTEX_STREAM_NORMAL = 1 << 1,
+			VERTEX_STREAM_UV0 = 1 << 2,
+			VERTEX_STREAM_UV1 = 1 << 3,
+			VERTEX_STREAM_UV2 = 1 << 4,
+			VERTEX_STREAM_UV3 = 1 << 5,
+		};
+
+#define VERTEX_STREAM_UV(index) (VERTEX_STREAM_UV0 << (index))
+#define VERTEX_STREAM_ALL (VERTEX_STREAM_POSITION | VERTEX_STREAM_NORMAL | VERTEX_STREAM_UV0 | VERTEX_STREAM_UV1 | VERTEX_STREAM_UV2 | VERTEX_STREAM_UV3)
+
+		struct Bounds
+		{
+			Vector3 minimum; // minimum > maximum if there is nothing to bound
+			Vector3 maximum;
+			Vector3 center; // bounding sphere around the center of the box
+			float radius;
+		};
+
+		struct Submesh // triangles drawn with one material
+		{
+			int firstTriangle;
+			int triangleCount;
+			int material; // index into Mesh::materials, -1 for none
+		};
+
+		struct MeshLod
+		{
+			float error; // deviation from the full mesh relative to its extent
+			int triangleCount;
+			Triangle* triangles; // always 32-bit, index the vertices of the owning mesh
+			Submesh* submeshes; // Mesh::submeshCount ranges of the triangles above, nullptr if the mesh has no submeshes
+		};
+
 		struct Mesh
 		{
 			char* name;
 
 			int vertexCount;
-			Vertex* vertices; 
+			Vertex* vertices; // interleaved layout, nullptr when the mesh is stored as streams
+
+			unsigned int streamFlags; // VertexStream bits of the streams below, 0 when the mesh is stored as vertices
+			unsigned int vertexAttributes; // VertexStream bits the importer filled in either layout, VERTEX_STREAM_ALL unless it says otherwise
+			Vector3* positions;
+			Vector3* normals;
+			Vector2* uvs[4];
 
 			int triangleCount;
-			Triangle* triangles;
+			IndexFormat indexFormat;
+			Triangle* triangles; // INDEX_FORMAT_32
+			ShortTriangle* shortTriangles; // INDEX_FORMAT_16
 
 			int materialCount;
 			Material** materials;
 
+			int submeshCount; // 0 if every triangle uses the first material, see mesh_get_submesh
+			Submesh* submeshes; // contiguous triangle ranges in material order, see mesh_sort_submeshes
+
 			int weightCollectionCount;
-			WeightCollection** weightCollections;
+			WeightCollection** weightCollections; // call mesh_sync_weights before reading them
+			SkinTable* skin; // vertex-major copy of weightCollections, see mesh_build_skin
+			bool weightsStale; // mesh_copy_weight went through the skin only, see mesh_sync_weights
+
+			int referenceCount; // nodes sharing this mesh, destroy_mesh releases it with the last one
+			int instanceCount;
+			Node** instances; // nodes drawing this mesh in preorder, see model_build_mesh_instances
+
+			int lodCount;
+			MeshLod* lods; // coarser levels sharing the vertices above, see mesh_generate_lods
+
+			MeshletTable* meshlets; // clusters of the triangles above, see mesh_build_meshlets
+
+			Bounds bounds; // of the vertices in mesh space, see mesh_compute_bounds
+			bool boundsValid; // cleared whenever the vertex count changes, call mesh_compute_bounds after moving vertices otherwise
 		};
 
 		EXPORT Mesh* create_mesh(const char* name);
+		EXPORT Mesh* mesh_retain(Mesh* instance); // call for every additional node referencing the mesh
+		EXPORT void mesh_set_lod_count(Mesh* instance, const int count);
+		EXPORT void mesh_set_lod(Mesh* instance, const int level, const float error, const int triangleCount, const Triangle* triangles);
+		EXPORT void mesh_set_lod_submeshes(Mesh* instance, const int level, const Submesh* submeshes); // Mesh::submeshCount ranges of the level
 		EXPORT void mesh_set_vertex_count(Mesh* instance, const int count);
+		EXPORT void mesh_set_vertex_streams(Mesh* instance, const int count, const unsigned int streamFlags);
+		EXPORT void mesh_split_vertices(Mesh* instance); // converts vertices into the streams of Mesh::vertexAttributes and releases them
+		EXPORT void mesh_interleave_streams(Mesh* instance); // converts streams into vertices and releases them
+		EXPORT void mesh_copy_vertices(const Mesh* instance, Vertex* vertices); // fills vertexCount interleaved vertices from either layout
+		EXPORT const Vector3* mesh_get_positions(const Mesh* instance, int* stride); // stride in bytes
 		EXPORT void mesh_set_triangle_count(Mesh* instance, const int count);
 		EXPORT void mesh_set_triangles(Mesh* instance, const int count, const Triangle* triangles);
+		EXPORT IndexFormat mesh_check_index_format(const Mesh* instance); // the narrowest format vertexCount allows
+		EXPORT void mesh_set_index_format(Mesh* instance, const IndexFormat format); // converts the triangles, nothing to do if the mesh already uses format
+		EXPORT int mesh_get_index(const Mesh* instance, const int index);
+		EXPORT void mesh_set_index(Mesh* instance, const int index, const int value); // widens the mesh if value does not fit
+		EXPORT Triangle mesh_get_triangle(const Mesh* instance, const int triangleIndex);
+		EXPORT void mesh_copy_indices(const Mesh* instance, int* indices); // triangleCount * 3 indices
+		EXPORT void mesh_write_indices(Mesh* instance, const int* indices); // overwrites triangleCount * 3 indices, keeps the index format unless a value needs 32 bits
+		EXPORT void mesh_set_indices(Mesh* instance, const int indexCount, const int* indices); // picks the index format from vertexCount
+		EXPORT const void* mesh_get_index_buffer(const Mesh* instance, int* indexSize); // indexSize in bytes
 		EXPORT void mesh_add_material(Mesh* instance, Material* material);
-		EXPORT void mesh_add_weight_collection(Mesh* instance, WeightCollection* collection);
-		EXPORT void mesh_copy_weight(Mesh* instance, const int templateIndex, const int newIndex);
+		/// <summary>stable sorts the triangles by material and rebuilds Mesh::submeshes, drops the lods and meshlets of the old order</summary>
+		/// <param name="triangleMaterials">index into Mesh::materials of every triangle, negative for none, nullptr if all use the first</param>
+		EXPORT void mesh_sort_submeshes(Mesh* instance, const int* triangleMaterials);
+		EXPORT void mesh_set_submeshes(Mesh* instance, const int count, const Submesh* submeshes); // the ranges must cover the triangles in order, replacing the index buffer with another triangle count clears them
+		EXPORT int mesh_get_submesh_count(const Mesh* instance); // at least 1
+		EXPORT Submesh mesh_get_submesh(const Mesh* instance, const int index); // one range over every triangle if the mesh has no submeshes
+		EXPORT void mesh_add_weight_collection(Mesh* instance, WeightCollection* collection); // releases Mesh::skin, build it again after the last collection
+		EXPORT void mesh_copy_weight(Mesh* instance, const int templateIndex, const int newIndex); // only copies in Mesh::skin if there is one and marks the weight collections stale
 		EXPORT void destroy_mesh(Mesh* instance);
 
 		struct Node
@@ -204,21 +264,42 @@ namespace General
 			Mesh* mesh;
 
 			Node* parent;
+			int index; // position in Model::nodeTable, -1 before the table is built
 
 			int childCount;
 			Node** children;
 
 			Vector3 localPosition;
 			Vector3 localRotation; // in degrees
+			Vector4 localQuaternion; // normalized, the same rotation as localRotation
 			Vector3 localScaling;
+
+			Matrix* localMatrix; // as read from the source file, nullptr unless ImportParams::localMatrices is set
 		};
 
 		EXPORT Node* create_node(const char* name);
+		EXPORT void node_set_rotation(Node* instance, const Vector3 degrees); // updates localRotation and localQuaternion
+		EXPORT void node_set_quaternion(Node* instance, const Vector4 q); // updates localRotation and localQuaternion
+		EXPORT void node_set_local_matrix(Node* instance, const Matrix matrix);
 		EXPORT void node_add_child(Node* instance, Node* child);
 		EXPORT void destroy_node(Node* instance);
 
 		struct Model
 		{
+			const ModelFileHeader* file; // the block a frozen model lives in, nullptr for models built in memory, see model_freeze
+			PayloadSource* payloads; // re-parses released mesh and animation payloads, nullptr unless imported with ImportParams::lazyPayloads
+			Arena* arena; // nullptr if every object is allocated separately
+			StringPool* names; // names are interned here while the model is bound
+			NameTable nodeNames;
+			NameTable materialNames;
+			NameTable uvSetNames;
+
+			NodeTable* nodeTable; // flattened Model::root, built at the end of an import
+			int nodeBoundsCount;
+			Bounds* nodeBounds; // subtree of every NodeTable item in model space, see model_update_bounds
+			int batchRangeCount;
+			BatchRange* batchRanges; // grouped by batch in triangle order, see model_batch_static_meshes
+
 			Node* root;
 
 			int meshCount;
@@ -227,14 +308,33 @@ namespace General
 			int materialCount;
 			Material** materials;
 
+			int uvSetCount;
+			UVSet** uvSets; // owned by the model, see model_add_uv_set
+
 			int animationCount;
 			Animation** animations;
 		};
 
+		inline Arena* models_arena_of(const Model* owner) // the model itself carries no allocation header
+		{
+			const Model* model = owner ? owner : model_bound();
+			return model ? model->arena : nullptr;
+		}
+
 		EXPORT Model* create_model();
+		EXPORT Model* create_model_with_arena(const size_t blockSize);
 		EXPORT void model_add_mesh(Model* instance, Mesh* mesh);
 		EXPORT void model_add_material(Model* instance, Material* material);
+		EXPORT void model_add_uv_set(Model* instance, UVSet* uvSet); // takes ownership
 		EXPORT void model_add_animation(Model* instance, Animation* animation);
+		EXPORT void model_index_node(Model* instance, Node* node); // the first node of a name wins
+		EXPORT void model_index_material(Model* instance, Material* material); // the first material of a name wins
+		EXPORT void model_index_uv_set(Model* instance, UVSet* uvSet); // the first uv set of a name wins
+		EXPORT void model_index_names(Model* instance); // rebuilds the name tables from the node tree, the materials and the uv sets
+		EXPORT void model_build_mesh_instances(Model* instance); // rebuilds Mesh::instances from the node tree
+		EXPORT Node* model_find_node(const Model* instance, const char* name);
+		EXPORT Material* model_find_material(const Model* instance, const char* name);
+		EXPORT UVSet* model_find_uv_set(const Model* instance, const char* name);
 		EXPORT void destroy_model(Model* instance);
 	}
 }
@@ -0,0 +1,204 @@
+﻿#include "pch.h"
+#include "Skin.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+		template <typename T> static void reserve_skin_array(const SkinTable* instance, T** array, int* capacity, const int count)
+		{
+			if (count <= *capacity)
+			{
+				return;
+			}
+
+			int newCapacity = *capacity > 16 ? *capacity : 16;
+			while (newCapacity < count)
+			{
+				newCapacity *= 2;
+			}
+			models_resize_array(instance, array, capacity, newCapacity);
+		}
+
+		SkinTable* create_skin_table(const int vertexCount, const int influenceCount, const Mesh* owner)
+		{
+			SkinTable* instance = models_alloc_struct<SkinTable>(owner);
+			reserve_skin_array(instance, &instance->offsets, &instance->vertexCapacity, vertexCount + 1);
+			reserve_skin_array(instance, &instance->influences, &instance->influenceCapacity, influenceCount);
+			instance->vertexCount = vertexCount;
+			instance->influenceCount = influenceCount;
+			return instance;
+		}
+
+		void skin_table_copy_vertex(SkinTable* instance, const int templateIndex, const int newIndex)
+		{
+			CHECK(instance && templateIndex >= 0 && templateIndex < instance->vertexCount && newIndex >= 0, );
+
+			const int begin = instance->offsets[templateIndex];
+			const int count = instance->offsets[templateIndex + 1] - begin;
+			if (newIndex >= instance->vertexCount)
+			{
+				// the usual case, duplicated vertices are appended to the mesh
+				reserve_skin_array(instance, &instance->offsets, &instance->vertexCapacity, newIndex + 2);
+				reserve_skin_array(instance, &instance->influences, &instance->influenceCapacity, instance->influenceCount + count);
+				for (int i = instance->vertexCount + 1; i <= newIndex; ++i)
+				{
+					instance->offsets[i] = instance->influenceCount;
+				}
+				memcpy(instance->influences + instance->influenceCount, instance->influences + begin, sizeof(SkinInfluence) * count);
+				instance->influenceCount += count;
+				instance->offsets[newIndex + 1] = instance->influenceCount;
+				instance->vertexCount = newIndex + 1;
+				return;
+			}
+
+			std::vector<SkinInfluence> influences(instance->influences + begin, instance->influences + begin + count);
+			const int targetBegin = instance->offsets[newIndex];
+			const int targetEnd = instance->offsets[newIndex + 1];
+			const int delta = count - (targetEnd - targetBegin);
+			reserve_skin_array(instance, &instance->influences, &instance->influenceCapacity, instance->influenceCount + delta);
+			memmove(instance->influences + targetEnd + delta, instance->influences + targetEnd, sizeof(SkinInfluence) * (instance->influenceCount - targetEnd));
+			memcpy(instance->influences + targetBegin, influences.data(), sizeof(SkinInfluence) * count);
+			for (int i = newIndex + 1; i <= instance->vertexCount; ++i)
+			{
+				instance->offsets[i] += delta;
+			}
+			instance->influenceCount += delta;
+		}
+
+		void destroy_skin_table(SkinTable* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->offsets) models_free(instance->offsets);
+			if (instance->influences) models_free(instance->influences);
+			models_free(instance);
+		}
+
+		SkinTable* mesh_build_skin(Mesh* instance)
+		{
+			CHECK(instance, nullptr);
+
+			mesh_sync_weights(instance);
+			if (instance->skin)
+			{
+				destroy_skin_table(instance->skin);
+				instance->skin = nullptr;
+			}
+
+			const int vertexCount = instance->vertexCount;
+			int influenceCount = 0;
+			for (int collectionIndex = 0; collectionIndex < instance->weightCollectionCount; ++collectionIndex)
+			{
+				influenceCount += instance->weightCollections[collectionIndex]->weightCount;
+			}
+
+			SkinTable* skin = create_skin_table(vertexCount, influenceCount, instance);
+			int* offsets = skin->offsets;
+			memset(offsets, 0, sizeof(int) * (vertexCount + 1));
+			skin->influenceCount = 0;
+			for (int collectionIndex = 0; collectionIndex < instance->weightCollectionCount; ++collectionIndex)
+			{
+				const WeightCollection* collection = instance->weightCollections[collectionIndex];
+				for (int weightIndex = 0; weightIndex < collection->weightCount; ++weightIndex)
+				{
+					const int vertexIndex = collection->weights[weightIndex].index;
+					if (vertexIndex >= 0 && vertexIndex < vertexCount)
+					{
+						++offsets[vertexIndex + 1];
+					}
+				}
+			}
+			for (int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex)
+			{
+				offsets[vertexIndex + 1] += offsets[vertexIndex];
+			}
+			skin->influenceCount = offsets[vertexCount];
+
+			std::vector<int> cursors(offsets, offsets + vertexCount);
+			for (int collectionIndex = 0; collectionIndex < instance->weightCollectionCount; ++collectionIndex)
+			{
+				const WeightCollection* collection = instance->weightCollections[collectionIndex];
+				const WeightData* weight = collection->weights;
+				for (int weightIndex = 0; weightIndex < collection->weightCount; ++weightIndex, ++weight)
+				{
+					if (weight->index < 0 || weight->index >= vertexCount)
+					{
+						continue;
+					}
+
+					SkinInfluence* influence = skin->influences + cursors[weight->index]++;
+					influence->collection = collectionIndex;
+					influence->weight = weight->weight;
+				}
+			}
+			return instance->skin = skin;
+		}
+
+		void mesh_write_skin(Mesh* instance)
+		{
+			CHECK(instance && instance->skin, );
+
+			const SkinTable* skin = instance->skin;
+			std::vector<int> counts(instance->weightCollectionCount);
+			for (int influenceIndex = 0; influenceIndex < skin->influenceCount; ++influenceIndex)
+			{
+				++counts[skin->influences[influenceIndex].collection];
+			}
+
+			for (int collectionIndex = 0; collectionIndex < instance->weightCollectionCount; ++collectionIndex)
+			{
+				WeightCollection* collection = instance->weightCollections[collectionIndex];
+				models_resize_array(collection, &collection->weights, &collection->weightCount, counts[collectionIndex]);
+				counts[collectionIndex] = 0;
+			}
+
+			for (int vertexIndex = 0; vertexIndex < skin->vertexCount; ++vertexIndex)
+			{
+				for (int influenceIndex = skin->offsets[vertexIndex]; influenceIndex < skin->offsets[vertexIndex + 1]; ++influenceIndex)
+				{
+					const SkinInfluence* influence = skin->influences + influenceIndex;
+					WeightData* weight = instance->weightCollections[influence->collection]->weights + counts[influence->collection]++;
+					weight->index = vertexIndex;
+					weight->weight = influence->weight;
+				}
+			}
+			instance->weightsStale = false;
+		}
+
+		void mesh_sync_weights(Mesh* instance)
+		{
+			CHECK(instance, );
+			if (instance->weightsStale)
+			{
+				// a dropped skin syncs first, so a stale mesh always has one
+				mesh_write_skin(instance);
+			}
+		}
+
+		void mesh_skin_positions(const Mesh* instance, const Matrix* boneMatrices, Vector3* positions)
+		{
+			CHECK(instance && instance->skin && boneMatrices && positions, );
+
+			int stride;
+			const char* source = reinterpret_cast<const char*>(mesh_get_positions(instance, &stride));
+			const SkinTable* skin = instance->skin;
+			const int vertexCount = instance->vertexCount < skin->vertexCount ? instance->vertexCount : skin->vertexCount;
+			for (int vertexIndex = 0; vertexIndex < vertexCount; ++vertexIndex, source += stride)
+			{
+				const Vector3 p = *reinterpret_cast<const Vector3*>(source);
+				Vector3 r = { };
+				for (int influenceIndex = skin->offsets[vertexIndex]; influenceIndex < skin->offsets[vertexIndex + 1]; ++influenceIndex)
+				{
+					const SkinInfluence* influence = skin->influences + influenceIndex;
+					const Matrix* m = boneMatrices + influence->collection;
+					const float w = influence->weight;
+					r.x += w * (p.x * m->row0[0] + p.y * m->row1[0] + p.z * m->row2[0] + m->row3[0]);
+					r.y += w * (p.x * m->row0[1] + p.y * m->row1[1] + p.z * m->row2[1] + m->row3[1]);
+					r.z += w * (p.x * m->row0[2] + p.y * m->row1[2] + p.z * m->row2[2] + m->row3[2]);
+				}
+				positions[vertexIndex] = r;
+			}
+		}
+	}
+}
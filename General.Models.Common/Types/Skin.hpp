@@ -0,0 +1,38 @@
+﻿#ifndef GENERAL_MODELS_COMMON_SKIN_HPP
+#define GENERAL_MODELS_COMMON_SKIN_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct SkinInfluence
+		{
+			int collection; // index into Mesh::weightCollections
+			float weight;
+		};
+
+		struct SkinTable // vertex-major view of Mesh::weightCollections
+		{
+			int vertexCount;
+			int* offsets; // vertexCount + 1 items, influences of vertex i are [offsets[i], offsets[i + 1])
+
+			int influenceCount;
+			SkinInfluence* influences;
+
+			int vertexCapacity;
+			int influenceCapacity;
+		};
+
+		EXPORT SkinTable* create_skin_table(const int vertexCount, const int influenceCount, const Mesh* owner = nullptr); // carved next to owner, see models_arena_of
+		EXPORT void skin_table_copy_vertex(SkinTable* instance, const int templateIndex, const int newIndex);
+		EXPORT void destroy_skin_table(SkinTable* instance);
+
+		EXPORT SkinTable* mesh_build_skin(Mesh* instance); // rebuilds Mesh::skin from the weight collections
+		EXPORT void mesh_write_skin(Mesh* instance); // rewrites the weight collections from Mesh::skin
+		EXPORT void mesh_sync_weights(Mesh* instance); // mesh_write_skin if Mesh::weightsStale
+		/// <param name="boneMatrices">one matrix per weight collection, usually boneOffset * bone world matrix</param>
+		EXPORT void mesh_skin_positions(const Mesh* instance, const Matrix* boneMatrices, Vector3* positions);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_SKIN_HPP
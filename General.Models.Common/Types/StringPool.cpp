@@ -0,0 +1,162 @@
+﻿#include "pch.h"
+#include "StringPool.hpp"
+
+namespace General
+{
+	namespace Models
+	{
+#ifndef STRING_POOL_BLOCK_SIZE
+#define STRING_POOL_BLOCK_SIZE (64llu << 10)
+#endif
+
+		unsigned int string_hash(const char* value)
+		{
+			unsigned int hash = 2166136261u;
+			for (const unsigned char* c = reinterpret_cast<const unsigned char*>(value); *c; ++c)
+			{
+				hash ^= *c;
+				hash *= 16777619u;
+			}
+			return hash;
+		}
+
+		static int find_slot(const StringPool* instance, const char* value, const unsigned int hash)
+		{
+			const int mask = instance->slotCount - 1;
+			for (int slot = static_cast<int>(hash) & mask; ; slot = (slot + 1) & mask)
+			{
+				const int id = instance->slots[slot] - 1;
+				if (id < 0 || (instance->hashes[id] == hash && 0 == strcmp(instance->strings[id], value)))
+				{
+					return slot;
+				}
+			}
+		}
+
+		static void rehash(StringPool* instance, const int slotCount)
+		{
+			free(instance->slots);
+			instance->slots = static_cast<int*>(calloc(slotCount, sizeof(int)));
+			instance->slotCount = slotCount;
+
+			const int mask = slotCount - 1;
+			for (int id = 0; id < instance->count; ++id)
+			{
+				int slot = static_cast<int>(instance->hashes[id]) & mask;
+				while (instance->slots[slot])
+				{
+					slot = (slot + 1) & mask;
+				}
+				instance->slots[slot] = id + 1;
+			}
+		}
+
+		StringPool* create_string_pool()
+		{
+			StringPool* instance = g_alloc_struct<StringPool>();
+			instance->arena = create_arena(STRING_POOL_BLOCK_SIZE);
+			rehash(instance, 64);
+			return instance;
+		}
+
+		int string_pool_intern(StringPool* instance, const char* value)
+		{
+			CHECK(instance && value, -1);
+
+			const unsigned int hash = string_hash(value);
+			int slot = find_slot(instance, value, hash);
+			if (instance->slots[slot])
+			{
+				return instance->slots[slot] - 1;
+			}
+
+			const int id = instance->count;
+			if ((id + 1) * 4 > instance->slotCount * 3)
+			{
+				rehash(instance, instance->slotCount * 2);
+				slot = find_slot(instance, value, hash);
+			}
+
+			if (id == instance->capacity)
+			{
+				instance->capacity = id ? id * 2 : 16;
+				instance->strings = static_cast<const char**>(realloc(instance->strings, sizeof(const char*) * instance->capacity));
+				instance->hashes = static_cast<unsigned int*>(realloc(instance->hashes, sizeof(unsigned int) * instance->capacity));
+			}
+
+			// resizable allocations record their arena, so models_free leaves pooled names to the pool whichever model is bound
+			const size_t size = strlen(value) + 1;
+			char* string = static_cast<char*>(arena_resize(instance->arena, nullptr, 0, size));
+			memcpy(string, value, size);
+			instance->strings[id] = string;
+			instance->hashes[id] = hash;
+			instance->slots[slot] = id + 1;
+			instance->count = id + 1;
+			return id;
+		}
+
+		int string_pool_find(const StringPool* instance, const char* value)
+		{
+			CHECK(instance && value, -1);
+			return instance->slots[find_slot(instance, value, string_hash(value))] - 1;
+		}
+
+		const char* string_pool_get(const StringPool* instance, const int id)
+		{
+			CHECK(instance && id >= 0 && id < instance->count, nullptr);
+			return instance->strings[id];
+		}
+
+		bool string_pool_contains(const StringPool* instance, const void* pointer)
+		{
+			return instance && arena_contains(instance->arena, pointer);
+		}
+
+		void destroy_string_pool(StringPool* instance)
+		{
+			CHECK(instance, );
+
+			destroy_arena(instance->arena);
+			free(instance->strings);
+			free(instance->hashes);
+			free(instance->slots);
+			g_free_struct(instance);
+		}
+
+		void name_table_set(NameTable* instance, StringPool* names, const char* name, void* item)
+		{
+			CHECK(instance && names && name, );
+
+			const int id = string_pool_intern(names, name);
+			if (id >= instance->count)
+			{
+				int capacity = instance->count > 16 ? instance->count : 16;
+				while (capacity <= id)
+				{
+					capacity *= 2;
+				}
+				instance->items = static_cast<void**>(realloc(instance->items, sizeof(void*) * capacity));
+				memset(instance->items + instance->count, 0, sizeof(void*) * (capacity - instance->count));
+				instance->count = capacity;
+			}
+			instance->items[id] = item;
+		}
+
+		void* name_table_find(const NameTable* instance, const StringPool* names, const char* name)
+		{
+			CHECK(instance && names && name, nullptr);
+
+			const int id = string_pool_find(names, name);
+			return id >= 0 && id < instance->count ? instance->items[id] : nullptr;
+		}
+
+		void name_table_clear(NameTable* instance)
+		{
+			CHECK(instance, );
+
+			if (instance->items) free(instance->items);
+			instance->items = nullptr;
+			instance->count = 0;
+		}
+	}
+}
@@ -0,0 +1,49 @@
+﻿#ifndef GENERAL_MODELS_COMMON_STRING_POOL_HPP
+#define GENERAL_MODELS_COMMON_STRING_POOL_HPP
+
+namespace General
+{
+	namespace Models
+	{
+		struct Arena;
+
+		/****************************************************************
+		* Every string is stored once and identified by its id, the
+		* position it was interned at. Ids never change, so tables can
+		* be indexed by them directly.
+		* ***************************************************************/
+
+		struct StringPool
+		{
+			Arena* arena; // characters of every string
+
+			int count;
+			int capacity;
+			const char** strings; // indexed by id
+			unsigned int* hashes; // indexed by id
+
+			int slotCount; // power of two
+			int* slots; // id + 1, 0 for an empty slot
+		};
+
+		EXPORT unsigned int string_hash(const char* value); // 32 bits FNV-1a
+		EXPORT StringPool* create_string_pool();
+		EXPORT int string_pool_intern(StringPool* instance, const char* value); // returns the id of value, adds it if missing
+		EXPORT int string_pool_find(const StringPool* instance, const char* value); // -1 if value was never interned
+		EXPORT const char* string_pool_get(const StringPool* instance, const int id);
+		EXPORT bool string_pool_contains(const StringPool* instance, const void* pointer); // whether pointer is owned by the pool
+		EXPORT void destroy_string_pool(StringPool* instance);
+
+		struct NameTable // items indexed by the string pool id of their names
+		{
+			int count;
+			void** items;
+		};
+
+		EXPORT void name_table_set(NameTable* instance, StringPool* names, const char* name, void* item);
+		EXPORT void* name_table_find(const NameTable* instance, const StringPool* names, const char* name);
+		EXPORT void name_table_clear(NameTable* instance);
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_STRING_POOL_HPP
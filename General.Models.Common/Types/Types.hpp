@@ -1,7 +1,12 @@
 ﻿#ifndef GENERAL_MODELS_COMMON_TYPES_HPP
 #define GENERAL_MODELS_COMMON_TYPES_HPP
 
+#include "Arena.hpp"
+#include "StringPool.hpp"
 #include "Model.hpp"
+#include "Skin.hpp"
+#include "Meshlet.hpp"
+#include "Hierarchy.hpp"
 #include "Animation.hpp"
 
 #endif // GENERAL_MODELS_COMMON_TYPES_HPP
\ No newline at end of file
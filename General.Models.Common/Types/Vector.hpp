@@ -0,0 +1,69 @@
+﻿#ifndef GENERAL_MODELS_COMMON_VECTOR_HPP
+#define GENERAL_MODELS_COMMON_VECTOR_HPP
+
+// plain data only, the math kernels built for other instruction sets include this without the precompiled header
+
+namespace General
+{
+	namespace Models
+	{
+		struct Vector2
+		{
+			union
+			{
+				struct
+				{
+					float x;
+					float y;
+				};
+				float values[2];
+			};
+		};
+
+		struct Vector3
+		{
+			union
+			{
+				struct
+				{
+					float x;
+					float y;
+					float z;
+				};
+				float values[3];
+			};
+		};
+
+		struct Vector4
+		{
+			union
+			{
+				struct
+				{
+					float x;
+					float y;
+					float z;
+					float w;
+				};
+				float values[4];
+			};
+		};
+
+		struct Matrix // row matrix
+		{
+			union
+			{
+				struct
+				{
+					float row0[4];
+					float row1[4];
+					float row2[4];
+					float row3[4];
+				};
+				float values[16];
+			};
+		};
+	}
+}
+
+#endif // GENERAL_MODELS_COMMON_VECTOR_HPP
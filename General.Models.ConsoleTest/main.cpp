@@ -3,9 +3,9 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <General.Cpp/General.hpp>
+#include <General.Models.Common/Common.hpp> // before the importers, they use its types
 //#include <General.Models.Fbx/Fbx.hpp>
 #include <General.Models.Assimp/Assimp.hpp>
-#include <General.Models.Common/Common.hpp>
 using namespace General::Models;
 
 void printHierarchy(Node* node, int level)
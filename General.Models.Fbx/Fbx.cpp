@@ -13,5 +13,12 @@ namespace General
 			FbxModelImporter importer(*params);
 			return importer.Import();
 		};
+
+		ImportTask* load_model_from_fbx_async(const ImportParams* params, const ImportProgressCallback callback, void* userData)
+		{
+			CHECK(params && params->filename && strlen(params->filename), nullptr);
+
+			return start_import_task(new FbxModelImporter(*params), callback, userData);
+		}
 	}
 }
\ No newline at end of file
@@ -7,8 +7,10 @@ namespace General
 	{
 		struct Model;
 		struct ImportParams;
+		struct ImportTask;
 
 		EXPORT const Model* load_model_from_fbx(const ImportParams* params);
+		EXPORT ImportTask* load_model_from_fbx_async(const ImportParams* params, const ImportProgressCallback callback, void* userData); // see start_import_task
 	}
 }
 
@@ -1,6 +1,7 @@
 ﻿#include "pch.h"
 #include "Importer.hpp"
 #include <fbxsdk.h>
+#include <mutex>
 using namespace General;
 using namespace fbxsdk;
 
@@ -136,15 +137,19 @@ namespace General
 			return translation * rotationOffset * rotationPivot * preRotation * rotation * postRotationInverse * rotationPivotInverse * scalingOffset * scalingPivot * scaling * scalingPivotInverse;
 		}
 
-		Vector3 rotation_from_fbx(const FbxLimits& limits, const FbxDouble3& preProperty, const FbxDouble3& property, const FbxDouble3& postProperty)
+		FbxVector4 euler_from_fbx(const FbxLimits& limits, const FbxDouble3& preProperty, const FbxDouble3& property, const FbxDouble3& postProperty)
 		{
-			Vector3 v = { };
 			FbxDouble3 minLimit = limits.GetMin();
 			FbxDouble3 maxLimit = limits.GetMax();
-			v.x = static_cast<float>(limit(preProperty.mData[0] + property.mData[0] + postProperty.mData[0], limits.GetMinXActive(), minLimit[0], limits.GetMaxXActive(), maxLimit[0]));
-			v.y = static_cast<float>(limit(preProperty.mData[1] + property.mData[1] + postProperty.mData[1], limits.GetMinYActive(), minLimit[1], limits.GetMaxYActive(), maxLimit[1]));
-			v.z = static_cast<float>(limit(preProperty.mData[2] + property.mData[2] + postProperty.mData[2], limits.GetMinZActive(), minLimit[2], limits.GetMaxZActive(), maxLimit[2]));
-			return v;
+			return FbxVector4(
+				limit(preProperty.mData[0] + property.mData[0] + postProperty.mData[0], limits.GetMinXActive(), minLimit[0], limits.GetMaxXActive(), maxLimit[0]),
+				limit(preProperty.mData[1] + property.mData[1] + postProperty.mData[1], limits.GetMinYActive(), minLimit[1], limits.GetMaxYActive(), maxLimit[1]),
+				limit(preProperty.mData[2] + property.mData[2] + postProperty.mData[2], limits.GetMinZActive(), minLimit[2], limits.GetMaxZActive(), maxLimit[2]));
+		}
+
+		Vector3 rotation_from_fbx(const FbxLimits& limits, const FbxDouble3& preProperty, const FbxDouble3& property, const FbxDouble3& postProperty)
+		{
+			return vector3_from_fbx(euler_from_fbx(limits, preProperty, property, postProperty));
 		}
 
 		Vector3 vector3_from_fbx(const FbxLimits& limits, const FbxDouble3& property)
@@ -204,7 +209,7 @@ namespace General
 			return result;
 		}
 
-		Node* create_node_from_fbx(FbxNode* fbxNode, const float& scaleFactor)
+		Node* create_node_from_fbx(FbxNode* fbxNode, const float& scaleFactor, const bool keepMatrix)
 		{
 			Node* node = create_node(fbxNode->GetName());
 			//FbxDouble3 rotation1 = fbxNode->PreRotation.Get();
@@ -217,8 +222,18 @@ namespace General
 			//FbxDouble3 rotation7 = transform.GetR();
 			//FbxDouble3 rotation8 = fbxNode->EvaluateLocalRotation();
 			node->localPosition = vector3_from_fbx(fbxNode->GetTranslationLimits(), fbxNode->LclTranslation, scaleFactor);
-			node->localRotation = rotation_from_fbx(fbxNode->GetRotationLimits(), fbxNode->PreRotation, fbxNode->LclRotation, fbxNode->RotationActive ? fbxNode->PostRotation.Get() : FbxDouble3());
+			const FbxVector4 euler = euler_from_fbx(fbxNode->GetRotationLimits(), fbxNode->PreRotation, fbxNode->LclRotation, fbxNode->RotationActive ? fbxNode->PostRotation.Get() : FbxDouble3());
+			FbxAMatrix rotation; rotation.SetIdentity(); rotation.SetR(euler); // quaternion from the double precision angles
+			node->localRotation = vector3_from_fbx(euler);
+			node->localQuaternion = quaternion_normalize(vector4_from_fbx_quaternion(rotation.GetQ()));
 			node->localScaling = vector3_from_fbx(fbxNode->GetScalingLimits(), fbxNode->LclScaling);
+			if (keepMatrix)
+			{
+				FbxAMatrix local = fbxNode->EvaluateLocalTransform();
+				const FbxVector4 translation = local.GetT();
+				local.SetT(FbxVector4(translation[0] * scaleFactor, translation[1] * scaleFactor, translation[2] * scaleFactor));
+				node_set_local_matrix(node, matrix_from_fbx(local));
+			}
 			//node->localPosition = vector3_from_fbx(fbxNode->GetTranslationLimits(), fbxNode->GeometricTranslation, context->scaleFactor);
 			//node->localRotation = vector3_from_fbx(fbxNode->GetRotationLimits(), fbxNode->GeometricRotation);
 			//node->localScaling = vector3_from_fbx(fbxNode->GetScalingLimits(), fbxNode->GeometricScaling);
@@ -421,20 +436,12 @@ namespace General
 			return parentMatrix * localMatrix;
 		}
 
-		FbxModelImporter::FbxModelImporter(const ImportParams& params) : Importer(params), mManager(), mImporter() { }
+		FbxModelImporter::FbxModelImporter(const ImportParams& params) : Importer(params), mManager(), mImporter(), mNodeCount(), mCheckedNodeCount(), mFbxUVSets() { }
 
 		FbxModelImporter::~FbxModelImporter()
 		{
-			if (mImporter)
-			{
-				mImporter->Destroy();
-				mImporter = nullptr;
-			}
-			if (mManager)
-			{
-				mManager->Destroy();
-				mManager = nullptr;
-			}
+			// the manager is shared by every importer and mImporter is destroyed by internalImport, see sdk_mutex
+			name_table_clear(&mFbxUVSets);
 		}
 
 		bool FbxModelImporter::checkImportStatus()
@@ -467,22 +474,43 @@ namespace General
 			return true;
 		}
 
+		bool FbxModelImporter::onParseProgress(void* importer, float percentage, const char* status)
+		{
+			// returning false makes the FBX SDK abort the read
+			return static_cast<FbxModelImporter*>(importer)->reportProgress(IMPORT_PHASE_PARSE, percentage * 0.01f);
+		}
+
 		bool FbxModelImporter::internalImport(Model* model)
 		{
+			// the SDK manager is shared by every importer and the FBX SDK is not thread-safe, so imports on the worker pool run one at a time
+			static std::mutex sdk_mutex;
+			std::lock_guard<std::mutex> lock(sdk_mutex);
+
 			FbxManager* manager = mManager = check_manager();
 			FbxImporter* importer = mImporter = FbxImporter::Create(manager, "Importer");
 
 			const std::string& filename = this->GetFilename();
-			bool status = importer->Initialize(filename.c_str(), -1, manager->GetIOSettings());
-			if (!status)
+			bool imported = importer->Initialize(filename.c_str(), -1, manager->GetIOSettings());
+			if (imported)
+			{
+				importer->SetProgressCallback(&FbxModelImporter::onParseProgress, this);
+				fbxsdk::FbxScene* scene = FbxScene::Create(mManager, "ImportScene");
+				imported = this->import(scene);
+				scene->Destroy();
+			}
+			else
 			{
 				this->checkImportStatus();
-				return false;
 			}
 
-			fbxsdk::FbxScene* scene = FbxScene::Create(mManager, "ImportScene");
-			this->import(scene);
-			scene->Destroy();
+			// importers are deleted on any thread, so nothing of the SDK outlives the lock
+			importer->Destroy();
+			mImporter = nullptr;
+			mManager = nullptr;
+			if (!imported)
+			{
+				return false;
+			}
 
 			/*const Mesh* mesh = mModel->meshes[0];
 
@@ -496,7 +524,17 @@ namespace General
 			return true;
 		}
 
-		void FbxModelImporter::import(FbxScene* scene)
+		std::string FbxModelImporter::getVersion() const
+		{
+			return std::string("FBX SDK ") + FbxManager::GetVersion();
+		}
+
+		Importer* FbxModelImporter::createImporter(const ImportParams& params) const
+		{
+			return new FbxModelImporter(params);
+		}
+
+		bool FbxModelImporter::import(FbxScene* scene)
 		{
 			Model* model = mModel;
 			FbxManager* manager = mManager;
@@ -504,9 +542,9 @@ namespace General
 
 			if (!importer->Import(scene))
 			{
-				if (!this->checkImportStatus())
+				if (this->isCancelled() || !this->checkImportStatus())
 				{
-					return;
+					return false;
 				}
 				assert(!"unexpected condition");
 			}
@@ -532,7 +570,7 @@ namespace General
 			if (nullptr == root)
 			{
 				TRACE_ERROR("no root node");
-				return;
+				return false;
 			}
 
 			/*int poseCount = scene->GetPoseCount();
@@ -557,36 +595,88 @@ namespace General
 				}
 			}*/
 
-			this->checkAnimations(scene);
-
-			this->checkNode(model->root = create_node_from_fbx(root, mScaleFactor), root);
-			g_set_string(&model->root->name, std::filesystem::path(this->GetFilename()).replace_extension().filename().string().c_str());
+			mBuilder->ReserveNodes(scene->GetNodeCount());
+			mBuilder->ReserveMeshes(scene->GetGeometryCount());
+			mBuilder->ReserveMaterials(scene->GetMaterialCount());
 
-			this->checkSkinWeights();
+			this->checkAnimations(scene);
+			mBuilder->ReserveCurveNodes(mAnimations.size() * scene->GetNodeCount() * 3llu);
+
+			// the frames of every animation are sampled node by node, so the animations are complete with the hierarchy and its bone weights
+			mNodeCount = scene->GetNodeCount();
+			mCheckedNodeCount = 0;
+			const bool checked = this->checkNode(model->root = create_node_from_fbx(root, mScaleFactor, this->GetParams().localMatrices), root);
+			models_set_string(&model->root->name, std::filesystem::path(this->GetFilename()).replace_extension().filename().string().c_str());
+			if (!checked || !this->checkSkinWeights() || !this->reportProgress(IMPORT_PHASE_ANIMATIONS, 1.0f))
+			{
+				return false;
+			}
 
-			this->postProcess();
+			mBuilder->Freeze(); // post processing reads the model arrays
+			return this->postProcess();
 		}
 
-		void FbxModelImporter::checkNode(Node* node, FbxNode* fbxNode)
+		bool FbxModelImporter::checkNode(Node* node, FbxNode* fbxNode)
 		{
+			if (!this->reportProgress(IMPORT_PHASE_NODES, static_cast<float>(mCheckedNodeCount++) / std::max(mNodeCount, 1)))
+			{
+				return false;
+			}
+
 			node->visible = fbxNode->GetVisibility();
 
 			FbxMesh* fbxMesh = fbxNode->GetMesh();
 			if (nullptr != fbxMesh)
 			{
-				Mesh* mesh = node->mesh = this->checkMesh(fbxMesh);
-				assert(mesh);
-
-				model_add_mesh(mModel, mesh);
-
+				// materials belong to the node, so only nodes resolving to the same materials share a mesh
 				int materialCount = fbxNode->GetMaterialCount();
+				std::vector<Material*> materials;
+				std::vector<int> meshMaterials(materialCount, -1); // node material to index into Mesh::materials
 				for (int i = 0; i < materialCount; ++i)
 				{
 					FbxSurfaceMaterial* fbxMaterial = fbxNode->GetMaterial(i);
 					Material* material = this->checkMaterial(fbxMaterial);
 					if (nullptr != material)
 					{
-						mesh_add_material(mesh, material);
+						meshMaterials[i] = static_cast<int>(materials.size());
+						materials.push_back(material);
+					}
+				}
+				const int meshMaterialCount = static_cast<int>(materials.size());
+
+				const MeshKey key(fbxMesh, materials);
+				auto meshFinder = mFbx2MeshMap.find(key);
+				if (mFbx2MeshMap.end() != meshFinder)
+				{
+					// instanced by another node with the same materials, the polygon materials match too
+					node->mesh = mesh_retain(meshFinder->second);
+				}
+				else
+				{
+					Mesh* mesh = node->mesh = this->checkMesh(fbxMesh);
+					assert(mesh);
+					mFbx2MeshMap[key] = mesh;
+
+					mBuilder->AddMesh(mesh);
+					for (Material* material : materials)
+					{
+						mBuilder->AddMeshMaterial(mesh, material);
+					}
+
+					// the first material layer decides which node material every polygon uses
+					const FbxGeometryElementMaterial* elementMaterial = fbxMesh->GetElementMaterial(0);
+					if (nullptr != elementMaterial && meshMaterialCount > 1)
+					{
+						const FbxLayerElementArrayTemplate<int>& materialIndices = elementMaterial->GetIndexArray();
+						const bool allSame = FbxGeometryElement::eAllSame == elementMaterial->GetMappingMode();
+						std::vector<int>& polygonMaterials = mMeshMaterialIndices[mesh];
+						polygonMaterials.resize(mesh->triangleCount);
+						for (int polygonIndex = 0; polygonIndex < mesh->triangleCount; ++polygonIndex)
+						{
+							const int arrayIndex = allSame ? 0 : polygonIndex;
+							const int materialIndex = arrayIndex < materialIndices.GetCount() ? materialIndices.GetAt(arrayIndex) : -1;
+							polygonMaterials[polygonIndex] = materialIndex >= 0 && materialIndex < materialCount ? meshMaterials[materialIndex] : -1;
+						}
 					}
 				}
 			}
@@ -597,22 +687,17 @@ namespace General
 			for (int i = 0; i < childCount; ++i)
 			{
 				FbxNode* fbxChildNode = fbxNode->GetChild(i);
-				Node* childNode = create_node_from_fbx(fbxChildNode, mScaleFactor);
-				this->checkNode(childNode, fbxChildNode);
-				node_add_child(node, childNode);
+				Node* childNode = create_node_from_fbx(fbxChildNode, mScaleFactor, this->GetParams().localMatrices);
+				const bool checked = this->checkNode(childNode, fbxChildNode);
+				mBuilder->AddChild(node, childNode);
+				if (!checked)
+				{
+					return false;
+				}
 			}
 
 			mFbx2NodeMap[fbxNode] = node;
-		}
-
-		static bool check_uv_different(const Vertex* vertex, const Vector2& uv)
-		{
-			return .0f != vertex->uv[0].x && vertex->uv[0].x != uv.x && .0f != vertex->uv[0].y && vertex->uv[0].y != uv.y;
-		}
-
-		static bool check_normal_different(const Vertex* vertex, const Normal* normal)
-		{
-			return .0f != vertex->normal.x && vertex->normal.x != normal->normal.x && .0f != vertex->normal.y && vertex->normal.y != normal->normal.y && .0f != vertex->normal.z && vertex->normal.z != normal->normal.z;
+			return true;
 		}
 
 		Mesh* FbxModelImporter::checkMesh(FbxMesh* fbxMesh)
@@ -631,6 +716,7 @@ namespace General
 			}
 
 			Mesh* mesh = create_mesh(meshName);
+			mesh->vertexAttributes = VERTEX_STREAM_POSITION; // postProcess adds the per corner attributes
 			this->checkMeshVertices(fbxMesh, mesh);
 			this->checkMeshIndices(fbxMesh, mesh);
 			this->checkMeshUVs(fbxMesh, mesh);
@@ -719,7 +805,7 @@ namespace General
 					continue;
 				}
 
-				mFbxUVSets[uvSetName] = elementUV;
+				name_table_set(&mFbxUVSets, mModel->names, uvSetName, const_cast<FbxGeometryElementUV*>(elementUV));
 			}
 		}
 
@@ -732,11 +818,11 @@ namespace General
 			}
 
 			const char* materialName = fbxMaterial->GetName();
-			Material* material = find_material(model->materials, model->materialCount, materialName);
+			Material* material = mBuilder->FindMaterial(materialName);
 			if (nullptr == material)
 			{
 				material = create_material(materialName);
-				model_add_material(model, material);
+				mBuilder->AddMaterial(material);
 
 				FbxSurfaceLambert* lambert = FbxCast<FbxSurfaceLambert>(fbxMaterial);
 				if (nullptr == lambert)
@@ -875,7 +961,7 @@ namespace General
 						const char* layerName = layer->GetName();
 						Animation* animation = create_animation(layerName);
 						mAnimations.push_back(animation);
-						model_add_animation(model, animation);
+						mBuilder->AddAnimation(animation);
 
 						/*const int nodeCount = layer->GetMemberCount<FbxAnimCurveNode>();
 						for (int nodeIndex = 0; nodeIndex < nodeCount; ++nodeIndex)
@@ -1073,7 +1159,7 @@ namespace General
 				AnimationCurveNode* curveNode = analyze_animation_node_frames(fbxNode->LclTranslation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_X, false), fbxNode->LclTranslation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Y, false), fbxNode->LclTranslation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Z, false), fbxNode, node, AnimationCurveNodeTranslation, mScaleFactor);
 				if (curveNode)
 				{
-					animation_curve_add_node(curve, curveNode);
+					mBuilder->AddCurveNode(curve, curveNode);
 				}
 				curveNode = analyze_animation_node_frames(fbxNode->LclRotation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_X, false), fbxNode->LclRotation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Y, false), fbxNode->LclRotation.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Z, false), fbxNode, node, AnimationCurveNodeRotation, 1.0f);
 				if (curveNode)
@@ -1105,26 +1191,33 @@ namespace General
 							int n = 0;
 						}
 					}*/
-					animation_curve_add_node(curve, curveNode);
+					mBuilder->AddCurveNode(curve, curveNode);
 				}
 				curveNode = analyze_animation_node_frames(fbxNode->LclScaling.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_X, false), fbxNode->LclScaling.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Y, false), fbxNode->LclScaling.GetCurve(layer, FBXSDK_CURVENODE_COMPONENT_Z, false), fbxNode, node, AnimationCurveNodeScaling, 1.0f);
 				if (curveNode)
 				{
-					animation_curve_add_node(curve, curveNode);
+					mBuilder->AddCurveNode(curve, curveNode);
 				}
 			}
 		}
 
-		void FbxModelImporter::checkSkinWeights()
+		bool FbxModelImporter::checkSkinWeights()
 		{
 			for (const auto& pair : mMesh2FbxMap)
 			{
+				// part of the nodes phase, see ImportPhase
+				if (this->isCancelled())
+				{
+					return false;
+				}
+
 				Mesh* mesh = pair.first;
 				FbxMesh* fbxMesh = pair.second;
 
 				//std::vector<FbxAMatrix> transformMatrices(mesh->vertexCount);
 				//memset(transformMatrices.data(), 0, sizeof(FbxAMatrix) * transformMatrices.size());
 
+				std::vector<const WeightCollection*> collections;
 				int deformerCount = fbxMesh->GetDeformerCount(FbxDeformer::eSkin);
 				for (int deformerIndex = 0; deformerIndex < deformerCount; ++deformerIndex)
 				{
@@ -1190,7 +1283,8 @@ namespace General
 						//std::vector<WeightData> weightReferences(weightCollection->weightCount);
 						//memcpy(weightReferences.data(), weightCollection->weights, sizeof(WeightData) * weightReferences.size());
 
-						mesh_add_weight_collection(mesh, weightCollection);
+						collections.push_back(weightCollection);
+						mBuilder->AddMeshWeightCollection(mesh, weightCollection);
 					}
 				}
 
@@ -1203,9 +1297,8 @@ namespace General
 
 				// check total weight is 1.0f
 				std::vector<float> totalWeights(mesh->vertexCount);
-				for (int collectionIndex = 0; collectionIndex < mesh->weightCollectionCount; ++collectionIndex)
+				for (const WeightCollection* collection : collections)
 				{
-					const WeightCollection* collection = mesh->weightCollections[collectionIndex];
 					for (int weightIndex = 0; weightIndex < collection->weightCount; ++weightIndex)
 					{
 						const WeightData* weightData = collection->weights + weightIndex;
@@ -1221,14 +1314,20 @@ namespace General
 					}
 				}
 			}
+			return true;
 		}
 
-		void FbxModelImporter::postProcess()
+		bool FbxModelImporter::postProcess()
 		{
-			CHECK_INSTANCE(Model*, model, mModel, );
+			CHECK_INSTANCE(Model*, model, mModel, false);
 
 			for (int meshIndex = 0; meshIndex < model->meshCount; ++meshIndex)
 			{
+				if (this->isCancelled())
+				{
+					return false;
+				}
+
 				Mesh* mesh = model->meshes[meshIndex];
 
 				const auto meshFinder = mMesh2FbxMap.find(mesh);
@@ -1244,6 +1343,7 @@ namespace General
 				}
 
 				const FbxMesh* fbxMesh = meshFinder->second;
+				UVSet* uvSet = nullptr; // uv[0] takes the set of the last textured material
 				for (int materialIndex = 0; materialIndex < mesh->materialCount; ++materialIndex)
 				{
 					Material* material = mesh->materials[materialIndex];
@@ -1257,47 +1357,46 @@ namespace General
 						}
 						else
 						{
-							const auto fbxFinder = mFbxUVSets.find(material->diffuse->uvSet);
-							if (mFbxUVSets.end() != fbxFinder)
-							{
-								elementUV = fbxFinder->second;
-							}
+							elementUV = static_cast<const FbxGeometryElementUV*>(name_table_find(&mFbxUVSets, mModel->names, material->diffuse->uvSet));
 						}
 						if (!elementUV)
 						{
 							continue;
 						}
 
-						UVSet* uvSet = uvset_from_fbx(fbxMesh, elementUV);
-						if (!uvSet)
+						UVSet* materialUVSet = uvset_from_fbx(fbxMesh, elementUV);
+						if (!materialUVSet)
 						{
 							continue;
 						}
+						if (uvSet) destroy_uv_set(uvSet);
+						uvSet = materialUVSet;
+					}
+				}
 
-						std::vector<Triangle> triangles(mesh->triangleCount);
-						memcpy(triangles.data(), mesh->triangles, sizeof(Triangle) * triangles.size());
-
-						std::vector<Vertex> vertices(mesh->vertexCount);
-						memcpy(vertices.data(), mesh->vertices, sizeof(Vertex) * mesh->vertexCount);
-
-						//this->checkVerticesWithPose(mesh, vertices);
-
-						//this->checkVerticesWithUVAndNormals(mesh, setFinder->second, triangles, vertices);
-						//this->checkVerticesWithUVAndNormals(mesh, normalFinder->second, triangles, vertices);
-						this->checkVerticesWithUVAndNormals(mesh, uvSet, normalFinder->second, triangles, vertices);
-
-						// 一定要更新顶点，因为在checkVerticesWithUVAndNormals中会更新UV和法线
-						free(mesh->vertices);
-						mesh->vertexCount = static_cast<int>(vertices.size());
-						mesh->vertices = g_copy_array(vertices.data(), vertices.size());
+				// give every polygon corner its own vertex with the normal and uv of that corner, then merge the equal ones again
+				const std::vector<Normal>& normals = normalFinder->second;
+				const int cornerCount = mesh->triangleCount * 3;
+				assert(cornerCount == static_cast<int>(normals.size()) && (!uvSet || cornerCount == uvSet->uvCount));
+				unweld_mesh(mesh);
+				Vertex* vertex = mesh->vertices;
+				for (int cornerIndex = 0; cornerIndex < cornerCount; ++cornerIndex, ++vertex)
+				{
+					vertex->normal = normals[cornerIndex].normal;
+					if (uvSet) vertex->uv[0] = uvSet->uvArray[cornerIndex].uv;
+				}
+				mesh->vertexAttributes |= VERTEX_STREAM_NORMAL | (uvSet ? VERTEX_STREAM_UV0 : 0);
+				weld_mesh(mesh, .0f); // exact duplicates only, finalizeModel welds within weldEpsilon if weldVertices asks for it
 
-						free(mesh->triangles);
-						mesh->triangles = g_copy_array(triangles.data(), triangles.size());
+				if (uvSet) destroy_uv_set(uvSet);
+			}
 
-						destroy_uv_set(uvSet);
-					}
-				}
+			// after the per corner attributes, those follow the polygon order
+			for (const auto& pair : mMeshMaterialIndices)
+			{
+				mesh_sort_submeshes(pair.first, pair.second.data());
 			}
+			return true;
 		}
 
 		void FbxModelImporter::checkVerticesWithPose(Mesh* mesh, std::vector<Vertex>& vertices)
@@ -1345,186 +1444,5 @@ namespace General
 				vertex->position = vector3_from_fbx(currentMatrix->MultT(FbxVector4(vertex->position.x, vertex->position.y, vertex->position.z, 1.0)));
 			}
 		}
-
-		static Vertex* copy_new_vertex(std::vector<Vertex>& vertices, const size_t& sourceIndex)
-		{
-			vertices.push_back(vertices[sourceIndex]);
-			return vertices.data() + (vertices.size() - 1llu);
-		}
-
-		template <typename VertexReference> static Vertex* copy_new_vertex(Mesh* mesh, std::vector<VertexReference>& references, VertexReference*& vertexReference, int& referenceIndex, const int& triangleIndex, std::vector<Vertex>& vertices)
-		{
-			references.push_back(*vertexReference);
-			vertexReference = references.data() + referenceIndex; // push_back in previous step might cause memory reallocation
-			referenceIndex = static_cast<int>(references.size() - 1);
-			VertexReference* newReference = references.data() + referenceIndex;
-			newReference->vertexIndex = referenceIndex;
-			vertexReference->nextIndex = referenceIndex;
-			vertexReference = newReference;
-
-			Vertex* vertex = copy_new_vertex(vertices, triangleIndex);
-			mesh_copy_weight(mesh, triangleIndex, referenceIndex);
-			return vertex;
-		}
-
-		void FbxModelImporter::checkVerticesWithUVAndNormals(Mesh* mesh, const UVSet* uvSet, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices)
-		{
-			struct VertexReference
-			{
-				int vertexIndex;
-				int nextIndex; // 当前顶点的下一个复制品
-			};
-			VertexReference defaultReference = { };
-			defaultReference.vertexIndex = -1;
-			std::vector<VertexReference> references(vertices.size(), defaultReference);
-
-			// TODO: handle multiple uv sets
-			int index = 0;
-			UV* uv = nullptr;
-			Vertex* vertex = nullptr;
-			Triangle* triangle = triangles.data();
-			for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex, ++triangle)
-			{
-				for (int i = 0, vertexIndex, referenceIndex; i < 3; ++i, ++index)
-				{
-					referenceIndex = vertexIndex = triangle->indices[i];
-					uv = uvSet->uvArray + index;
-					assert(uv->vertexIndex == vertexIndex);
-
-					vertex = vertices.data() + uv->vertexIndex;
-
-					VertexReference* vertexReference = references.data() + referenceIndex;
-					if (-1 == vertexReference->vertexIndex) // index为-1的是原始顶点，从未被赋值过，因此仅赋值
-					{
-						vertexReference->vertexIndex = vertexIndex;
-						memcpy(vertex->uv[0].values, uv->uv.values, sizeof(Vector2));
-						continue;
-					}
-
-					while (check_uv_different(vertex, uv->uv)) // 如果UV或法线与记录值不一样（可能是同一个顶点在不同的三角面上的状态），创建一个新的顶点，并且更新索引
-					{
-						if (vertexReference->nextIndex)
-						{
-							vertexReference = references.data() + vertexReference->nextIndex;
-							vertex = vertices.data() + vertexReference->vertexIndex;
-							continue;
-						}
-
-						vertex = copy_new_vertex(mesh, references, vertexReference, referenceIndex, triangle->indices[i], vertices);
-						memcpy(vertex->uv[0].values, uv->uv.values, sizeof(Vector2));
-					}
-					triangle->indices[i] = static_cast<int>(vertex - vertices.data()); // 因为可能在上面的while中被更新过，所以最后一定要更新顶点索引
-				}
-			}
-		}
-
-		void FbxModelImporter::checkVerticesWithUVAndNormals(Mesh* mesh, const std::vector<Normal> normals, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices)
-		{
-			assert(normals.size() == triangles.size() * 3);
-
-			struct VertexReference
-			{
-				int vertexIndex;
-				int nextIndex; // 当前顶点的下一个复制品
-			};
-			VertexReference defaultReference = { };
-			defaultReference.vertexIndex = -1;
-			std::vector<VertexReference> references(vertices.size(), defaultReference);
-
-			// TODO: handle multiple uv sets
-			int index = 0;
-			Vertex* vertex = nullptr;
-			const Normal* normal = nullptr;
-			Triangle* triangle = triangles.data();
-			for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex, ++triangle)
-			{
-				for (int i = 0, vertexIndex, referenceIndex; i < 3; ++i, ++index)
-				{
-					referenceIndex = vertexIndex = triangle->indices[i];
-
-					normal = normals.data() + index;
-					vertex = vertices.data() + vertexIndex;
-
-					VertexReference* vertexReference = references.data() + referenceIndex;
-					if (-1 == vertexReference->vertexIndex) // index为-1的是原始顶点，从未被赋值过，因此仅赋值
-					{
-						vertexReference->vertexIndex = vertexIndex;
-						memcpy(vertex->normal.values, normal->normal.values, sizeof(Vector3));
-						continue;
-					}
-
-					while (check_normal_different(vertex, normal)) // 如果UV或法线与记录值不一样（可能是同一个顶点在不同的三角面上的状态），创建一个新的顶点，并且更新索引
-					{
-						if (vertexReference->nextIndex)
-						{
-							vertexReference = references.data() + vertexReference->nextIndex;
-							vertex = vertices.data() + vertexReference->vertexIndex;
-							continue;
-						}
-
-						vertex = copy_new_vertex(mesh, references, vertexReference, referenceIndex, triangle->indices[i], vertices);
-						memcpy(vertex->normal.values, normal->normal.values, sizeof(Vector3));
-					}
-					triangle->indices[i] = static_cast<int>(vertex - vertices.data()); // 因为可能在上面的while中被更新过，所以最后一定要更新顶点索引
-				}
-			}
-		}
-
-		void FbxModelImporter::checkVerticesWithUVAndNormals(Mesh* mesh, const UVSet* uvSet, const std::vector<Normal> normals, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices)
-		{
-			assert(uvSet->uvCount == triangles.size() * 3 && uvSet->uvCount == normals.size());
-
-			struct VertexReference
-			{
-				int vertexIndex;
-				int nextIndex; // 当前顶点的下一个复制品
-			};
-			VertexReference defaultReference = { };
-			defaultReference.vertexIndex = -1;
-			std::vector<VertexReference> references(vertices.size(), defaultReference);
-
-			// TODO: handle multiple uv sets
-			int index = 0;
-			UV* uv = nullptr;
-			Vertex* vertex = nullptr;
-			const Normal* normal = nullptr;
-			Triangle* triangle = triangles.data();
-			for (size_t triangleIndex = 0; triangleIndex < triangles.size(); ++triangleIndex, ++triangle)
-			{
-				for (int i = 0, vertexIndex, referenceIndex; i < 3; ++i, ++index)
-				{
-					referenceIndex = vertexIndex = triangle->indices[i];
-					uv = uvSet->uvArray + index;
-					assert(uv->vertexIndex == vertexIndex);
-
-					normal = normals.data() + index;
-					vertex = vertices.data() + uv->vertexIndex;
-
-					VertexReference* vertexReference = references.data() + referenceIndex;
-					if (-1 == vertexReference->vertexIndex) // index为-1的是原始顶点，从未被赋值过，因此仅赋值
-					{
-						vertexReference->vertexIndex = vertexIndex;
-						memcpy(vertex->normal.values, normal->normal.values, sizeof(Vector3));
-						memcpy(vertex->uv[0].values, uv->uv.values, sizeof(Vector2));
-						continue;
-					}
-
-					while (check_uv_different(vertex, uv->uv) || check_normal_different(vertex, normal)) // 如果UV或法线与记录值不一样（可能是同一个顶点在不同的三角面上的状态），创建一个新的顶点，并且更新索引
-					{
-						if (vertexReference->nextIndex)
-						{
-							vertexReference = references.data() + vertexReference->nextIndex;
-							vertex = vertices.data() + vertexReference->vertexIndex;
-							continue;
-						}
-
-						vertex = copy_new_vertex(mesh, references, vertexReference, referenceIndex, triangle->indices[i], vertices);
-						memcpy(vertex->normal.values, normal->normal.values, sizeof(Vector3));
-						memcpy(vertex->uv[0].values, uv->uv.values, sizeof(Vector2));
-					}
-					triangle->indices[i] = static_cast<int>(vertex - vertices.data()); // 因为可能在上面的while中被更新过，所以最后一定要更新顶点索引
-				}
-			}
-		}
 	}
 }
\ No newline at end of file
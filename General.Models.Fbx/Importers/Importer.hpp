@@ -1,6 +1,8 @@
 ﻿#ifndef GENERAL_MODELS_FBX_IMPORTER_HPP
 #define GENERAL_MODELS_FBX_IMPORTER_HPP
 
+#include <map>
+
 namespace fbxsdk
 {
 	class FbxManager;
@@ -36,11 +38,17 @@ namespace General
 			FbxManager* mManager;
 			FbxImporter* mImporter;
 
+			int mNodeCount;
+			int mCheckedNodeCount;
+
 			std::unordered_map<Mesh*, std::vector<Normal>> mMeshNormals;
+			std::unordered_map<Mesh*, std::vector<int>> mMeshMaterialIndices; // index into Mesh::materials of every polygon, -1 for none
 
-			std::unordered_map<std::string, const FbxGeometryElementUV*> mFbxUVSets;
+			NameTable mFbxUVSets; // const FbxGeometryElementUV* by the interned name of the uv set
 
 			std::unordered_map<Mesh*, FbxMesh*> mMesh2FbxMap;
+			typedef std::pair<const FbxMesh*, std::vector<Material*>> MeshKey; // a source mesh and the materials its node resolved to
+			std::map<MeshKey, Mesh*> mFbx2MeshMap;
 			std::unordered_map<FbxNode*, Node*> mFbx2NodeMap;
 
 			FbxPose* mPose;
@@ -54,12 +62,16 @@ namespace General
 			~FbxModelImporter();
 		private:
 			bool checkImportStatus();
+			static bool onParseProgress(void* importer, float percentage, const char* status); // FbxProgressCallback
 		protected:
 			virtual bool internalImport(Model* model) override;
+			virtual std::string getVersion() const override;
+		public:
+			virtual Importer* createImporter(const ImportParams& params) const override;
 		private:
-			void import(FbxScene* scene);
+			bool import(FbxScene* scene); // false if failed or cancelled
 
-			void checkNode(Node* node, FbxNode* fbxNode);
+			bool checkNode(Node* node, FbxNode* fbxNode); // false if cancelled
 
 			Mesh* checkMesh(FbxMesh* fbxMesh);
 			int checkMeshVertices(const FbxMesh* fbxMesh, Mesh* mesh);
@@ -74,13 +86,10 @@ namespace General
 			void checkAnimations(FbxScene* scene);
 			void checkAnimationNodeFrames(FbxNode* fbxNode, Node* node);
 
-			void checkSkinWeights();
+			bool checkSkinWeights(); // false if cancelled
 
-			void postProcess();
+			bool postProcess(); // false if cancelled
 			void checkVerticesWithPose(Mesh* mesh, std::vector<Vertex>& vertices);
-			void checkVerticesWithUVAndNormals(Mesh* mesh, const UVSet* uvSet, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices);
-			void checkVerticesWithUVAndNormals(Mesh* mesh, const std::vector<Normal> normals, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices);
-			void checkVerticesWithUVAndNormals(Mesh* mesh, const UVSet* uvSet, const std::vector<Normal> normals, std::vector<Triangle>& triangles, std::vector<Vertex>& vertices);
 		};
 	}
 }